@@ -109,6 +109,28 @@ static struct Image MidiInimage=
   0x3,0x0,NULL
 };
 
+/* multi input routing: the first track with a CAMD In tool for each
+   channel and status class. an empty entry means no track. cleared
+   whenever tools or the track list change. track settings like the input
+   channel change without notice, so the tracks are compared with a
+   snapshot taken at build time at most once a second. */
+#define ROUTE_SNAP_SIZE 64
+
+struct RouteSnap
+{
+  struct Track *track;
+  unsigned char channel;
+  unsigned short status;
+};
+
+static struct Track *routetable[16][8];
+static struct Track *routesysex;
+static struct Track *routetracklist;
+static volatile char routevalid;
+static struct RouteSnap routesnap[ROUTE_SNAP_SIZE];
+static short routesnapcount;   /* -1 if there were too many tracks */
+static ULONG routechecksecs;
+
 SAVEDS struct Tool *createtoolcode(struct MIDITool *copy)
 {
   struct MIDITool *tool;
@@ -129,6 +151,7 @@ SAVEDS struct Tool *createtoolcode(struct MIDITool *copy)
       tool->status=0x7F;
       tool->tool.touched=TOUCH_INIT;
     }
+    routevalid=0;
     tool->midilink=AddMidiLink(functions->CAMD_Node,MLTYPE_Receiver,
                                MLINK_Comment,"B&P Pro CAMD In Link",
                                MLINK_Location,tool->location,
@@ -153,20 +176,32 @@ SAVEDS static struct Tool *loadtool(long file,long size)
                              MLINK_UserData,tool,
                              TAG_END);
   functions->fastseek(file,size,0);
+  routevalid=0;
   return (struct Tool *)tool;
 }
 
 SAVEDS void deletetoolcode(struct MIDITool *tool)
 {
+  routevalid=0;
   if(tool->midilink)
       RemoveMidiLink(tool->midilink);
   functions->myfree((char *)tool,sizeof(struct MIDITool));
 }
 
+/* events lost in the receive hook since the tool master was loaded */
+static volatile unsigned long eventoverflows;
+static volatile unsigned long sysexoverflows;
+
 static struct Menu TitleMenu = {
     NULL,0,0,0,0,MENUENABLED,0,NULL
 };
 
+/* RawDoFmt() output: append to the buffer in a3 */
+static void ASMCALL stuffchar(REG(d0, char ch),REG(a3, char **buf))
+{
+  *(*buf)++=ch;
+}
+
 SAVEDS void edittoolcode(struct MIDITool *tool)
 {
   register struct IntuiMessage *message;
@@ -208,7 +243,17 @@ SAVEDS void edittoolcode(struct MIDITool *tool)
   functions->SelectEmbossed(window,5,tool->status & 32);
   functions->SelectEmbossed(window,6,tool->status & 64);
   functions->SelectEmbossed(window,7,tool->status & 128);
-  strcpy(menuname,"CAMD In v1.0 � 1993 The Blue Ribbon SoundWorks");
+  if(eventoverflows || sysexoverflows)
+  {
+      unsigned long args[2];
+      char *put=menuname;
+      args[0]=eventoverflows;
+      args[1]=sysexoverflows;
+      RawDoFmt("CAMD In v1.0 - lost %lu events, %lu sysex",args,
+               (void (*)())stuffchar,&put);
+  }
+  else
+      strcpy(menuname,"CAMD In v1.0 � 1993 The Blue Ribbon SoundWorks");
   TitleMenu.MenuName = menuname;
   SetMenuStrip(window,&TitleMenu);
   for (;;) {
@@ -224,6 +269,7 @@ SAVEDS void edittoolcode(struct MIDITool *tool)
           switch (class) {
               case 1 :
                   tool->status ^= 3;
+                  routevalid=0;
                   (*functions->SelectEmbossed)(window,1,tool->status & 1);
                   break;
               case 2 :
@@ -234,6 +280,7 @@ SAVEDS void edittoolcode(struct MIDITool *tool)
               case 7 :
                   class = 1 << (class);
                   tool->status ^= class;
+                  routevalid=0;
                   (*functions->SelectEmbossed)
                       (window,gadget->GadgetID,tool->status & class);
                   break;
@@ -263,37 +310,229 @@ struct Event *processeventcode(struct Event *event)
   return event;
 }
 
-static struct Event eventarray[32];
-static unsigned short eventindex;
+/* Incoming events are passed from the CAMD receive hook to the event
+   task through a single producer/single consumer ring. The hook only
+   writes eventput, the task only writes eventget. SysEx is copied in the
+   hook into a preallocated byte ring. */
+
+#define EVENT_RING_SIZE 256
+#define EVENT_RING_MASK (EVENT_RING_SIZE-1)
+
+struct InEvent
+{
+  long time;
+  unsigned char status,byte1,byte2,pad;
+  unsigned long sysexoffset;
+  unsigned long sysexlength;
+};
+
+static struct InEvent eventring[EVENT_RING_SIZE];
+static volatile unsigned short eventput;
+static volatile unsigned short eventget;
+static volatile unsigned char eventsignalled;
+
+static unsigned char *sysexring;
+static volatile unsigned long sysexput;
+static volatile unsigned long sysexget;
+
 struct Task *eventtask;
 long eventsignal;
 
+/* reserve length bytes in the sysex ring. blocks are never split: if
+   the tail is too small the block starts at the beginning again.
+   returns the offset or -1 if the ring is full. */
+static long sysexalloc(unsigned long length)
+{
+  unsigned long put=sysexput;
+  unsigned long get=sysexget;
+  unsigned long size=sysexbufsize;
+
+  /* an empty ring starts over, so the whole buffer is free again. the
+     task only moves sysexget when it releases a block, and there is none */
+  if(put==get)
+  {
+    put=get=0;
+    sysexput=sysexget=0;
+  }
+
+  if(put>=get)
+  {
+    if((put+length<size) || ((put+length==size) && (get>0)))
+        return (long)put;
+    if(length<get)
+        return 0;
+  }
+  else
+  {
+    if(put+length<get)
+        return (long)put;
+  }
+  return -1;
+}
+
+static void nextevent(unsigned short *index)
+{
+  *index=(*index+1)&EVENT_RING_MASK;
+  eventget=*index;
+}
+
+static void buildroutes(void)
+{
+  struct Track *track;
+  struct MIDITool *tool;
+  unsigned char channel;
+  short kind;
+  short num=0;
+
+  memset(routetable,0,sizeof(routetable));
+  routesysex=NULL;
+  for(track=functions->tracklist ; track!=NULL ; track=track->next)
+  {
+    tool=(struct MIDITool *)track->toollist;
+    if(!tool || (tool->tool.toolid!=ID_CAMI))
+        continue;
+    if(num>=0)
+    {
+      if(num<ROUTE_SNAP_SIZE)
+      {
+        routesnap[num].track=track;
+        routesnap[num].channel=track->channelin;
+        routesnap[num].status=tool->status;
+        num++;
+      }
+      else
+          num=-1;
+    }
+    if((tool->status&128) && !routesysex)
+        routesysex=track;
+    channel=track->channelin;
+    if(channel>15)
+        continue;
+    for(kind=0 ; kind<8 ; kind++)
+    {
+      if((tool->status&(1<<kind)) && !routetable[channel][kind])
+          routetable[channel][kind]=track;
+    }
+  }
+  routetracklist=functions->tracklist;
+  routesnapcount=num;
+  routevalid=1;
+}
+
+/* rebuild the table if any CAMD In track changed since it was built */
+static void checkroutes(void)
+{
+  struct Track *track;
+  struct MIDITool *tool;
+  struct RouteSnap *snap=routesnap;
+  short num=0;
+  ULONG secs,micros;
+
+  if(!routevalid || (routetracklist!=functions->tracklist))
+  {
+    buildroutes();
+    return;
+  }
+
+  /* the full compare walks all tracks: not for every batch */
+  CurrentTime(&secs,&micros);
+  if(secs==routechecksecs)
+      return;
+  routechecksecs=secs;
+
+  if(routesnapcount<0)
+  {
+    buildroutes();
+    return;
+  }
+  for(track=functions->tracklist ; track!=NULL ; track=track->next)
+  {
+    tool=(struct MIDITool *)track->toollist;
+    if(!tool || (tool->tool.toolid!=ID_CAMI))
+        continue;
+    if((num==routesnapcount) || (snap->track!=track) ||
+       (snap->channel!=track->channelin) || (snap->status!=tool->status))
+    {
+      buildroutes();
+      return;
+    }
+    snap++;
+    num++;
+  }
+  if(num!=routesnapcount)
+      buildroutes();
+}
+
+/* kind is the status class 0-7 (note off .. system) */
+static struct Track *findtrack(unsigned char channel,short kind)
+{
+  return (kind==7) ? routesysex : routetable[channel][kind];
+}
+
+static void queuesysex(struct InEvent *event)
+{
+  struct Track *track;
+  struct MIDITool *tool;
+  struct StringEvent *stringevent;
+  unsigned long length=event->sysexlength;
+
+  if(functions->multiin)
+      track=findtrack(0,7);
+  else
+      track=master.intrack;
+  if(track)
+  {
+    tool=(struct MIDITool *)track->toollist;
+    stringevent=(struct StringEvent *)functions->fastallocevent();
+    if(stringevent)
+    {
+      stringevent->type=EVENT_SYSX;
+      stringevent->tool=tool->tool.next;
+      stringevent->time=event->time;
+      stringevent->string=(struct String *)functions->myalloc(length+3,0);
+      if(stringevent->string)
+      {
+        stringevent->string->length=length;
+        memcpy(stringevent->string->string,sysexring+event->sysexoffset,length);
+      }
+      stringevent->status=MIDI_SYSX;
+      functions->qevent((struct Event *)stringevent);
+    }
+  }
+
+  /* release the block. an empty one reserved nothing and may lie
+     before a reset of the ring */
+  if(length)
+      sysexget=(event->sysexoffset+length)%sysexbufsize;
+}
+
 SAVEDS static void eventcode(void)
 {
-  struct Event *event;
+  struct InEvent *event;
   unsigned short index;
   struct Track *track;
   struct Event *copy;
   struct MIDITool *tool;
-  char channel;
   unsigned char status;
-  struct StringEvent *stringevent;
 
   eventsignal=1<<AllocSignal(-1);
-  index=0;
+  index=eventget;
   for(;;)
   {
     Wait(eventsignal);
-    while(index!=eventindex)
+    /* clear before draining: events put after this signal again */
+    eventsignalled=0;
+    if(functions->multiin)
+        checkroutes();
+    while(index!=eventput)
     {
-      event=&eventarray[index];
+      event=&eventring[index];
       status=1<<((event->status >> 4)-8);
       if(status==2)
       {
         if(!event->byte1)
         {
-          ++index;
-          index&=0x1F;
+          nextevent(&index);
           continue;
         }
         if(event->byte2 && functions->remotecontrol[event->byte1])
@@ -301,67 +540,20 @@ SAVEDS static void eventcode(void)
           if(functions->processinputevent)
           {
             functions->processinputevent(functions->remotecontrol[event->byte1]);
-            ++index;
-            index&=0x1F;
+            nextevent(&index);
             continue;
           }
         }
       }
       if(status==128)
       {
-        if(functions->multiin)
-        {
-          for(track=functions->tracklist ; track!=NULL ; track=track->next)
-          {
-            tool=(struct MIDITool *)track->toollist;
-            if(tool->tool.toolid==ID_CAMI && (tool->status&128))
-                break;
-          }
-        }
-        else
-            track=master.intrack;
-        if(track)
-        {
-          tool=(struct MIDITool *)track->toollist;
-          stringevent=(struct StringEvent *)functions->fastallocevent();
-          if(stringevent)
-          {
-            stringevent->type=EVENT_SYSX;
-            stringevent->tool=tool->tool.next;
-            stringevent->time=event->time;
-            if(!event->tool)
-            {
-              ++index;
-              index&=0x1F;
-              continue;
-            }
-            stringevent->string=(struct String *)functions->myalloc(event->data+3,0);
-            if(stringevent->string)
-            {
-              stringevent->string->length=event->data+2;
-              memcpy(stringevent->string->string,event->tool,event->data);
-            }
-            stringevent->status=MIDI_SYSX;
-            functions->qevent((struct Event *)stringevent);
-          }
-        }
-        ++index;
-        index&=0x1F;
+        if(event->status==MIDI_SYSX)
+            queuesysex(event);
+        nextevent(&index);
         continue;
       }
       if(functions->multiin)
-      {
-        channel=event->status & 15;
-        for(track=functions->tracklist ; track!=NULL ; track=track->next)
-        {
-          tool=(struct MIDITool *)track->toollist;
-          if(tool && (tool->tool.toolid==ID_CAMI) && (tool->status&status))
-          {
-            if(track->channelin==channel)
-                break;
-          }
-        }
-      }
+          track=findtrack(event->status & 15,(event->status >> 4)-8);
       else
           track = master.intrack;
       if(track)
@@ -384,22 +576,22 @@ SAVEDS static void eventcode(void)
           }
         }
       }
-      ++index;
-      index&=0x1F;
+      nextevent(&index);
     }
   }
 }
 
 static ULONG ASMCALL SAVEDS midiinhook(REG(a0, struct Hook *hook),
                                        REG(a2, struct MidiLink *link),
-                                       REG(a1, MidiMsg *msg),
-                                       REG(d0, long sysexlen),
-                                       REG(a3, void *sysexdata))
+                                       REG(a1, MidiMsg *msg))
 {
-  struct Event *event;
+  struct InEvent *event;
   struct MIDITool *tool;
+  unsigned short put,next;
+  unsigned long length;
+  long offset;
 
-  if(msg->mm_Status>=0xf0)
+  if(msg->mm_Status>=0xf0 && msg->mm_Status!=MIDI_SYSX)
       return 0;
 
   if(master.intrack==NULL)
@@ -410,14 +602,46 @@ static ULONG ASMCALL SAVEDS midiinhook(REG(a0, struct Hook *hook),
   if(link!=tool->midilink)
       return 0;
 
-  event=&eventarray[eventindex];
+  put=eventput;
+  next=(put+1)&EVENT_RING_MASK;
+  if(next==eventget)
+  {
+    ++eventoverflows;
+    if(msg->mm_Status==MIDI_SYSX)
+        SkipSysEx(functions->CAMD_Node);
+    return 0;
+  }
+
+  event=&eventring[put];
   event->status=msg->mm_Status;
   event->byte1=msg->mm_Data1;
   event->byte2=msg->mm_Data2;
-  ++eventindex;
-  eventindex&=0x1F;
   event->time=functions->timenow;
-  Signal(eventtask,eventsignal);
+
+  /* copy sysex now. the node's buffer is reused for the next one */
+  if(msg->mm_Status==MIDI_SYSX)
+  {
+    length=QuerySysEx(functions->CAMD_Node);
+    offset=(length>0 && sysexring) ? sysexalloc(length) : -1;
+    if(offset<0)
+    {
+      ++sysexoverflows;
+      SkipSysEx(functions->CAMD_Node);
+      return 0;
+    }
+    event->sysexoffset=offset;
+    event->sysexlength=GetSysEx(functions->CAMD_Node,sysexring+offset,length);
+    sysexput=(offset+event->sysexlength)%sysexbufsize;
+  }
+
+  eventput=next;
+
+  /* only wake the task once until it drains the ring */
+  if(!eventsignalled)
+  {
+    eventsignalled=1;
+    Signal(eventtask,eventsignal);
+  }
   return 0;
 }
 
@@ -429,8 +653,15 @@ SAVEDS void removetoolcode(void)
     DeleteMidi(functions->CAMD_Node);
     functions->CAMD_Node=NULL;
   }
+  else
+      SetMidiAttrs(functions->CAMD_Node,MIDI_RecvHook,NULL,TAG_END);
   CloseLibrary(CamdBase);
   DeleteTask(eventtask);
+  if(sysexring)
+  {
+    functions->myfree((char *)sysexring,sysexbufsize);
+    sysexring=NULL;
+  }
 }
 
 struct ToolMaster *inittoolmaster(void)
@@ -468,6 +699,9 @@ struct ToolMaster *inittoolmaster(void)
     SetMidiAttrs(functions->CAMD_Node,MIDI_RecvHook,&hook,TAG_END);
   }
   ++functions->CAMD_count;
+  /* without it incoming sysex is dropped and counted */
+  sysexput=sysexget=0;
+  sysexring=(unsigned char *)functions->myalloc(sysexbufsize,MEMF_PUBLIC);
   eventtask=CreateTask("camd in",40,(APTR)eventcode,4000);
   memset((char *)&master,0,sizeof(struct ToolMaster));
   master.toolid =ID_CAMI;
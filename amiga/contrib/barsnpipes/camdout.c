@@ -138,6 +138,7 @@ SAVEDS struct Tool *createtoolcode(struct MIDITool *copy)
                                MLINK_Comment,"B&P Pro CAMD Out Link",
                                MLINK_Location,tool->location,
                                MLINK_UserData,tool,
+                               MLINK_Parse,TRUE,
                                TAG_END);
   }
   return (struct Tool *)tool;
@@ -156,6 +157,7 @@ SAVEDS static struct Tool *loadtool(long file,long size)
                              MLINK_Comment,"B&P Pro CAMD Out Link",
                              MLINK_Location,tool->location,
                              MLINK_UserData,tool,
+                             MLINK_Parse,TRUE,
                              TAG_END);
   functions->fastseek(file,size,0);
   return (struct Tool *)tool;
@@ -266,49 +268,169 @@ SAVEDS static void edittoolcode(struct MIDITool *tool)
     functions->DeleteNewWindow(newwindow);
 }
 
-SAVEDS static struct Event *processeventcode(struct Event *event)
+/* status filter: what to do for each status nibble. it depends only on
+   the status bits of the tool and is rebuilt when they differ from the
+   ones of the last event. */
+#define FILTER_DROP     0
+#define FILTER_PASS     1
+#define FILTER_MODE     2               /* channel mode controllers only */
+#define FILTER_SYSTEM   3
+
+/* messages of one time slice are collected per link and passed to CAMD
+   in a single ParseMidi() call. a single message takes PutMidi() */
+#define BATCH_SIZE      256
+
+/* the playback and the input task may output at the same time, so the
+   state lives on the stack of each call */
+struct Output
 {
-  struct MIDITool *tool=(struct MIDITool *)event->tool;
-  struct String *string;
+  unsigned char filtertab[16];
+  unsigned short filterstatus;
+  struct MidiLink *batchlink;
+  unsigned short batchlength;
+  unsigned short batchcount;
+  unsigned char batch[BATCH_SIZE];
+};
+
+/* message length for each status nibble. 0xF1-0xF3 are longer */
+static const unsigned char msglength[16]={
+  0,0,0,0,0,0,0,0,3,3,3,3,2,2,3,1
+};
+
+static void initoutput(struct Output *out)
+{
+  out->filterstatus=0xFFFF;
+  out->batchlink=NULL;
+  out->batchlength=0;
+  out->batchcount=0;
+}
+
+static void buildfilter(struct Output *out,unsigned short status)
+{
+  unsigned char *filtertab=out->filtertab;
+  short i;
 
-  union
+  for(i=0 ; i<8 ; i++)
+      filtertab[i]=FILTER_DROP;
+  for(i=8 ; i<15 ; i++)
   {
-    char buf[4];
-    unsigned long l;
-  } un={{0}};
+    if(status & (1<<(i-8)))
+        filtertab[i]=FILTER_PASS;
+    else if(i==(MIDI_CCHANGE>>4))
+        filtertab[i]=FILTER_MODE;
+    else
+        filtertab[i]=FILTER_DROP;
+  }
+  filtertab[15]=FILTER_SYSTEM;
+  out->filterstatus=status;
+}
 
-  unsigned char status=event->status;
+static void flushbatch(struct Output *out)
+{
+  union {
+    long l;
+    unsigned char buf[4];
+  } un;
+  short i;
 
-  event->tool=NULL;
-  if(status<MIDI_SYSX)
+  if(out->batchlength && out->batchlink)
   {
-    if(!(tool->status & (1<<((event->status>>4)-8))))
+    if(out->batchcount==1)
     {
-      if(!((event->status==MIDI_CCHANGE) && (event->byte1 > 119)))
-          return event;
+      un.l=0;
+      for(i=0 ; i<out->batchlength ; i++)
+          un.buf[i]=out->batch[i];
+      PutMidi(out->batchlink,un.l);
     }
+    else
+        ParseMidi(out->batchlink,out->batch,out->batchlength);
   }
-  else if(event->status==MIDI_SYSX)
+  out->batchlength=0;
+  out->batchcount=0;
+}
+
+static void outputevent(struct Output *out,struct Event *event)
+{
+  struct MIDITool *tool=(struct MIDITool *)event->tool;
+  struct String *string;
+  unsigned char status=event->status;
+  unsigned char length;
+
+  event->tool=NULL;
+  if(tool==NULL || tool->midilink==NULL)
+      return;
+  if(tool->status!=out->filterstatus)
+      buildfilter(out,tool->status);
+
+  switch(out->filtertab[status>>4])
   {
-    if(tool->status&128)
-    {
-      string=((struct StringEvent *)event)->string;
-      if(string && string->length>2 && tool->midilink)
-          PutSysEx(tool->midilink,string->string);
-    }
-    return event;
+    case FILTER_DROP :
+        return;
+    case FILTER_MODE :
+        if(event->byte1 <= 119)
+            return;
+        break;
+    case FILTER_SYSTEM :
+        if(status==MIDI_SYSX)
+        {
+          if(tool->status&128)
+          {
+            string=((struct StringEvent *)event)->string;
+            if(string && string->length>2)
+            {
+              flushbatch(out);
+              PutSysEx(tool->midilink,string->string);
+            }
+          }
+          return;
+        }
+        break;
   }
-  if(tool->tool.track)
+
+  if(out->batchlink!=tool->midilink || out->batchlength+3>BATCH_SIZE)
+  {
+    flushbatch(out);
+    out->batchlink=tool->midilink;
+  }
+  /* system messages have no channel */
+  if(status<MIDI_SYSX && tool->tool.track)
       status|=tool->tool.track->channelout;
-  un.buf[0]=status;
-  un.buf[1]=event->byte1;
-  un.buf[2]=event->byte2;
-  un.buf[3]=0;
-  if(tool->midilink)
-      PutMidi(tool->midilink,un.l);
+  length=msglength[event->status>>4];
+  if(event->status==0xF2)
+      length=3;
+  else if(event->status==0xF1 || event->status==0xF3)
+      length=2;
+  out->batchcount++;
+  out->batch[out->batchlength++]=status;
+  if(length>1)
+      out->batch[out->batchlength++]=event->byte1;
+  if(length>2)
+      out->batch[out->batchlength++]=event->byte2;
+}
+
+SAVEDS static struct Event *processeventcode(struct Event *event)
+{
+  struct Output out;
+
+  initoutput(&out);
+  outputevent(&out,event);
+  flushbatch(&out);
   return event;
 }
 
+/* all events of a time slice at once */
+SAVEDS static struct Event *processlistcode(struct Event *list)
+{
+  struct Output out;
+  struct Event *event;
+
+  initoutput(&out);
+  for(event=list ; event!=NULL ; event=event->next)
+      outputevent(&out,event);
+  flushbatch(&out);
+  return list;
+}
+
 static struct ToolMaster master;
 
 struct ToolMaster *inittoolmaster(void)
@@ -338,6 +460,7 @@ struct ToolMaster *inittoolmaster(void)
   master.createtool = createtoolcode;
   master.edittool = edittoolcode;
   master.processevent = processeventcode;
+  master.processlist = processlistcode;
   master.deletetool=deletetool;
   master.loadtool=loadtool;
   master.removetool = removetool;
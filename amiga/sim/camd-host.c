@@ -0,0 +1,274 @@
+/*
+ * camd-host.c - drive a midi driver like camd.library does
+ *
+ * The driver is linked in and opened directly. A byte stream is passed to
+ * the driver's transmitter via tx_func/ActivateXmit and all received
+ * bytes are counted (and verified for the echo driver) in rx_func.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <midi/camddevices.h>
+#include <midi/mididefs.h>
+
+#include "compiler.h"
+#include "midi-msg.h"
+#include "midi-drv.h"
+
+#include "sim.h"
+
+static const char *TEMPLATE =
+    "P=PORT/K/N,"
+    "N=NUM/K/N,"
+    "S=SYSEX/K/N,"
+    "C=CHUNK/K/N,"
+    "F=FILE/K,"
+    "W=WAIT/K/N,"
+    "D=DELAY/K/N,"
+    "R=RXONLY/S,"
+    "V=VERIFY/S";
+typedef struct {
+    ULONG *port;
+    ULONG *num;
+    ULONG *sysex;
+    ULONG *chunk;
+    char *file;
+    ULONG *wait;
+    ULONG *delay;
+    LONG *rx_only;
+    LONG *verify;
+} params_t;
+static params_t params;
+
+struct host_port {
+    /* tx stream: written by host, read by driver worker */
+    UBYTE          *tx_buf;
+    ULONG           tx_size;
+    volatile ULONG  tx_avail;
+    ULONG           tx_pos;
+    ULONG           tx_calls;
+
+    /* rx stream */
+    volatile ULONG  rx_bytes;
+    ULONG           rx_errors;
+    ULONG           rx_expect;
+
+    struct Task    *host_task;
+    ULONG           done_mask;
+};
+
+static struct host_port hp;
+
+static ASM ULONG host_tx_func(REG(a2, APTR userdata))
+{
+    struct host_port *p = (struct host_port *)userdata;
+    p->tx_calls++;
+    if(p->tx_pos == __atomic_load_n(&p->tx_avail, __ATOMIC_ACQUIRE)) {
+        return 0x100;
+    }
+    return p->tx_buf[p->tx_pos++];
+}
+
+static ASM void host_rx_func(REG(d0, UWORD input), REG(a2, APTR userdata))
+{
+    struct host_port *p = (struct host_port *)userdata;
+    ULONG pos = p->rx_bytes;
+    if(params.verify && ((pos >= p->tx_size) || (p->tx_buf[pos] != (UBYTE)input))) {
+        p->rx_errors++;
+    }
+    pos++;
+    __atomic_store_n(&p->rx_bytes, pos, __ATOMIC_RELEASE);
+    if(pos == p->rx_expect) {
+        Signal(p->host_task, p->done_mask);
+    }
+}
+
+/* note on/off pairs or sysex blocks. returns message count */
+static ULONG gen_stream(ULONG num, ULONG sysex_size)
+{
+    ULONG msg_size = (sysex_size > 0) ? sysex_size : 3;
+    hp.tx_size = num * msg_size;
+    hp.tx_buf = malloc(hp.tx_size);
+    if(hp.tx_buf == NULL) {
+        return 0;
+    }
+    UBYTE *ptr = hp.tx_buf;
+    for(ULONG i=0;i<num;i++) {
+        if(sysex_size > 0) {
+            *ptr++ = MS_SysEx;
+            for(ULONG j=0;j<sysex_size-2;j++) {
+                *ptr++ = (UBYTE)((i + j) & 0x7f);
+            }
+            *ptr++ = MS_EOX;
+        } else {
+            *ptr++ = (i & 1) ? MS_NoteOff : MS_NoteOn;
+            *ptr++ = (UBYTE)((i >> 1) & 0x7f);
+            *ptr++ = 0x40;
+        }
+    }
+    return num;
+}
+
+static int load_stream(const char *name)
+{
+    FILE *fh = fopen(name, "rb");
+    if(fh == NULL) {
+        printf("can't open '%s'\n", name);
+        return 1;
+    }
+    fseek(fh, 0, SEEK_END);
+    long size = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    hp.tx_buf = malloc(size > 0 ? size : 1);
+    hp.tx_size = fread(hp.tx_buf, 1, size, fh);
+    fclose(fh);
+    return 0;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void report(const char *what, ULONG bytes, ULONG msgs, double us)
+{
+    double secs = us / 1e6;
+    printf("%s: %lu bytes, %lu msgs in %.0f us: %.0f bytes/s, %.0f msgs/s\n",
+           what, (unsigned long)bytes, (unsigned long)msgs, us,
+           secs > 0 ? bytes / secs : 0.0, secs > 0 ? msgs / secs : 0.0);
+}
+
+static int run(struct MidiPortData *port_data, ULONG num_msgs, ULONG chunk, ULONG wait_s)
+{
+    ULONG wait_mask = hp.done_mask | SIGBREAKF_CTRL_C;
+
+    /* receive only: count until Ctrl-C */
+    if(params.rx_only) {
+        printf("receiving. press Ctrl-C to stop.\n");
+        double start = now_us();
+        Wait(SIGBREAKF_CTRL_C);
+        report("rx", hp.rx_bytes, 0, now_us() - start);
+        return 0;
+    }
+
+    hp.rx_expect = hp.tx_size;
+
+    /* give a network peer time to connect */
+    if(params.delay) {
+        ULONG mask = SIGBREAKF_CTRL_C;
+        sim_wait_fds(NULL, 0, *params.delay * 1000, &mask);
+        if(mask & SIGBREAKF_CTRL_C) {
+            return 0;
+        }
+    }
+
+    /* feed the stream in chunks like a busy application */
+    ULONG chunk_bytes = (num_msgs > 0) ? (hp.tx_size / num_msgs) * chunk : hp.tx_size;
+    if(chunk_bytes == 0) {
+        chunk_bytes = hp.tx_size;
+    }
+    double start = now_us();
+    ULONG pos = 0;
+    while(pos < hp.tx_size) {
+        pos += chunk_bytes;
+        if(pos > hp.tx_size) {
+            pos = hp.tx_size;
+        }
+        __atomic_store_n(&hp.tx_avail, pos, __ATOMIC_RELEASE);
+        port_data->ActivateXmit();
+        if(SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C) {
+            break;
+        }
+    }
+    double tx_end = now_us();
+
+    /* wait for the driver to deliver all bytes back */
+    double deadline = tx_end + wait_s * 1e6;
+    while((hp.rx_bytes < hp.rx_expect) && (now_us() < deadline)) {
+        ULONG mask = wait_mask;
+        sim_wait_fds(NULL, 0, 10, &mask);
+        if(mask & SIGBREAKF_CTRL_C) {
+            break;
+        }
+    }
+    double rx_end = now_us();
+
+    report("tx", hp.tx_pos, num_msgs, tx_end - start);
+    printf("tx: %lu tx_func calls\n", (unsigned long)hp.tx_calls);
+    report("rx", hp.rx_bytes, (hp.rx_bytes == hp.tx_size) ? num_msgs : 0, rx_end - start);
+    if(params.verify) {
+        printf("rx: %lu bytes differ\n", (unsigned long)hp.rx_errors);
+    }
+    return (hp.rx_errors > 0) ? RETURN_WARN : 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+
+    sim_set_args(argc, argv);
+    args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+    if(args == NULL) {
+        printf("usage: %s %s\n", argv[0], TEMPLATE);
+        return RETURN_ERROR;
+    }
+
+    ULONG port = params.port ? *params.port : 0;
+    ULONG num = params.num ? *params.num : 10000;
+    ULONG sysex = params.sysex ? *params.sysex : 0;
+    ULONG chunk = params.chunk ? *params.chunk : 1;
+    ULONG wait_s = params.wait ? *params.wait : 2;
+    if((sysex > 0) && (sysex < 3)) {
+        sysex = 3;
+    }
+
+    if(params.file != NULL) {
+        if(load_stream(params.file) != 0) {
+            return RETURN_ERROR;
+        }
+        num = 0;
+    } else if(!params.rx_only) {
+        if(gen_stream(num, sysex) == 0) {
+            printf("no memory for stream\n");
+            return RETURN_ERROR;
+        }
+    }
+
+    hp.host_task = FindTask(NULL);
+    BYTE done_sig = AllocSignal(-1);
+    hp.done_mask = 1UL << done_sig;
+    sim_break_init(hp.host_task);
+
+    if(!midi_drv_init()) {
+        printf("driver init failed!\n");
+        return RETURN_FAIL;
+    }
+
+    struct MidiPortData *port_data = midi_drv_open_port(NULL, port,
+                                                        host_tx_func,
+                                                        host_rx_func,
+                                                        &hp);
+    if(port_data == NULL) {
+        printf("driver open port %lu failed!\n", (unsigned long)port);
+        midi_drv_expunge();
+        return RETURN_FAIL;
+    }
+
+    int res = run(port_data, num, chunk, wait_s);
+
+    midi_drv_close_port(NULL, port);
+    midi_drv_expunge();
+
+    FreeSignal(done_sig);
+    free(hp.tx_buf);
+    FreeArgs(args);
+    return res;
+}
@@ -0,0 +1,17 @@
+#ifndef CLIB_ALIB_PROTOS_H
+#define CLIB_ALIB_PROTOS_H
+
+#include <exec/exec.h>
+
+void NewList(struct List *list);
+
+struct MsgPort *CreatePort(CONST_STRPTR name, LONG pri);
+void DeletePort(struct MsgPort *port);
+
+struct IORequest *CreateExtIO(struct MsgPort *port, LONG ioSize);
+void DeleteExtIO(struct IORequest *ioReq);
+
+struct Task *CreateTask(CONST_STRPTR name, LONG pri, APTR initPC, ULONG stackSize);
+void DeleteTask(struct Task *task);
+
+#endif
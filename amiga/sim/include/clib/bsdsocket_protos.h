@@ -0,0 +1,11 @@
+#ifndef CLIB_BSDSOCKET_PROTOS_H
+#define CLIB_BSDSOCKET_PROTOS_H
+
+#include <libraries/bsdsocket.h>
+
+LONG WaitSelect(LONG nfds, fd_set *readfds, fd_set *writefds, fd_set *exeptfds,
+                struct timeval *timeout, ULONG *maskp);
+LONG CloseSocket(LONG sock);
+LONG Errno(void);
+
+#endif
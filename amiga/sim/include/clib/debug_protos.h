@@ -0,0 +1,8 @@
+#ifndef CLIB_DEBUG_PROTOS_H
+#define CLIB_DEBUG_PROTOS_H
+
+/* debug output goes to stderr */
+void KPrintF(const char *fmt, ...);
+void KPutCh(int ch);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CLIB_DOS_PROTOS_H
+#define CLIB_DOS_PROTOS_H
+
+#include <dos/dos.h>
+#include <dos/rdargs.h>
+#include <utility/tagitem.h>
+
+BPTR Open(CONST_STRPTR name, LONG accessMode);
+LONG Close(BPTR file);
+LONG Read(BPTR file, APTR buffer, LONG length);
+LONG Write(BPTR file, const void *buffer, LONG length);
+LONG Seek(BPTR file, LONG position, LONG offset);
+LONG FRead(BPTR fh, APTR block, ULONG blocklen, ULONG number);
+LONG FWrite(BPTR fh, const void *block, ULONG blocklen, ULONG number);
+LONG Flush(BPTR fh);
+LONG DeleteFile(CONST_STRPTR name);
+BPTR Input(void);
+BPTR Output(void);
+BPTR SelectInput(BPTR fh);
+BPTR SelectOutput(BPTR fh);
+LONG IoErr(void);
+LONG SetIoErr(LONG result);
+
+BPTR Lock(CONST_STRPTR name, LONG type);
+void UnLock(BPTR lock);
+LONG Examine(BPTR lock, struct FileInfoBlock *fileInfoBlock);
+APTR AllocDosObject(ULONG type, const struct TagItem *tags);
+void FreeDosObject(ULONG type, APTR ptr);
+LONG CompareDates(const struct DateStamp *date1, const struct DateStamp *date2);
+
+/* output. Amiga formats: %l is a 32 bit value */
+LONG PutStr(CONST_STRPTR str);
+LONG Printf(CONST_STRPTR format, ...);
+LONG VPrintf(CONST_STRPTR format, const void *argarray);
+LONG FPrintf(BPTR fh, CONST_STRPTR format, ...);
+LONG PrintFault(LONG code, CONST_STRPTR header);
+
+struct RDArgs *ReadArgs(CONST_STRPTR arg_template, LONG *array, struct RDArgs *args);
+void FreeArgs(struct RDArgs *args);
+
+#endif
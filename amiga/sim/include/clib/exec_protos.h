@@ -0,0 +1,68 @@
+#ifndef CLIB_EXEC_PROTOS_H
+#define CLIB_EXEC_PROTOS_H
+
+#include <exec/exec.h>
+
+/* tasks and signals */
+struct Task *FindTask(CONST_STRPTR name);
+BYTE SetTaskPri(struct Task *task, LONG priority);
+BYTE AllocSignal(LONG signalNum);
+void FreeSignal(LONG signalNum);
+ULONG SetSignal(ULONG newSignals, ULONG signalSet);
+ULONG Wait(ULONG signalSet);
+void Signal(struct Task *task, ULONG signalSet);
+void Forbid(void);
+void Permit(void);
+
+/* lists */
+void AddHead(struct List *list, struct Node *node);
+void AddTail(struct List *list, struct Node *node);
+void Remove(struct Node *node);
+struct Node *RemHead(struct List *list);
+struct Node *RemTail(struct List *list);
+
+/* messages */
+void PutMsg(struct MsgPort *port, struct Message *message);
+struct Message *GetMsg(struct MsgPort *port);
+void ReplyMsg(struct Message *message);
+struct Message *WaitPort(struct MsgPort *port);
+struct MsgPort *CreateMsgPort(void);
+void DeleteMsgPort(struct MsgPort *port);
+void AddPort(struct MsgPort *port);
+void RemPort(struct MsgPort *port);
+struct MsgPort *FindPort(CONST_STRPTR name);
+
+/* semaphores */
+void InitSemaphore(struct SignalSemaphore *sigSem);
+void ObtainSemaphore(struct SignalSemaphore *sigSem);
+ULONG AttemptSemaphore(struct SignalSemaphore *sigSem);
+void ReleaseSemaphore(struct SignalSemaphore *sigSem);
+
+/* memory */
+APTR AllocVec(ULONG byteSize, ULONG requirements);
+void FreeVec(APTR memoryBlock);
+APTR AllocMem(ULONG byteSize, ULONG requirements);
+void FreeMem(APTR memoryBlock, ULONG byteSize);
+void CopyMem(const void *source, APTR dest, ULONG size);
+
+/* formatting. the data stream is the va_list of the caller on the host */
+APTR RawDoFmt(CONST_STRPTR formatString, APTR dataStream, void (*putChProc)(char, APTR), APTR putChData);
+
+/* libraries */
+struct Library *OpenLibrary(CONST_STRPTR libName, ULONG version);
+void CloseLibrary(struct Library *library);
+
+/* devices */
+BYTE OpenDevice(CONST_STRPTR devName, ULONG unit, struct IORequest *ioRequest, ULONG flags);
+void CloseDevice(struct IORequest *ioRequest);
+BYTE DoIO(struct IORequest *ioRequest);
+void SendIO(struct IORequest *ioRequest);
+struct IORequest *CheckIO(struct IORequest *ioRequest);
+BYTE WaitIO(struct IORequest *ioRequest);
+void AbortIO(struct IORequest *ioRequest);
+
+/* host only: replaces the exec base at address 4 */
+struct ExecBase *sim_exec_base(void);
+
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CLIB_TIMER_PROTOS_H
+#define CLIB_TIMER_PROTOS_H
+
+#include <devices/timer.h>
+
+void GetSysTime(struct timeval *dest);
+ULONG ReadEClock(struct EClockVal *dest);
+void AddTime(struct timeval *dest, struct timeval *src);
+void SubTime(struct timeval *dest, struct timeval *src);
+LONG CmpTime(struct timeval *dest, struct timeval *src);
+
+#endif
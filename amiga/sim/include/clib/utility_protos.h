@@ -0,0 +1,11 @@
+#ifndef CLIB_UTILITY_PROTOS_H
+#define CLIB_UTILITY_PROTOS_H
+
+#include <exec/types.h>
+
+LONG Stricmp(CONST_STRPTR string1, CONST_STRPTR string2);
+LONG Strnicmp(CONST_STRPTR string1, CONST_STRPTR string2, LONG length);
+UBYTE ToUpper(ULONG character);
+UBYTE ToLower(ULONG character);
+
+#endif
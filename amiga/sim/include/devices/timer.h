@@ -0,0 +1,49 @@
+#ifndef DEVICES_TIMER_H
+#define DEVICES_TIMER_H
+
+#include <exec/io.h>
+
+/* the host headers declaring struct timeval are pulled in first. from
+   here on the name refers to the Amiga layout with two 32 bit fields,
+   like the one used in the network protocol. */
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#define timeval amiga_timeval
+
+struct timeval {
+    ULONG tv_secs;
+    ULONG tv_micro;
+};
+
+/* BSD names as used with WaitSelect() */
+#define tv_sec  tv_secs
+#define tv_usec tv_micro
+
+struct EClockVal {
+    ULONG ev_hi;
+    ULONG ev_lo;
+};
+
+struct timerequest {
+    struct IORequest tr_node;
+    struct timeval   tr_time;
+};
+
+#define UNIT_MICROHZ    0
+#define UNIT_VBLANK     1
+#define UNIT_ECLOCK     2
+#define UNIT_WAITUNTIL  3
+#define UNIT_WAITECLOCK 4
+
+#define TIMERNAME       "timer.device"
+
+#define TR_ADDREQUEST   (CMD_NONSTD)
+#define TR_GETSYSTIME   (CMD_NONSTD+1)
+#define TR_SETSYSTIME   (CMD_NONSTD+2)
+
+#endif
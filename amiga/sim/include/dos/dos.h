@@ -0,0 +1,76 @@
+#ifndef DOS_DOS_H
+#define DOS_DOS_H
+
+#include <exec/types.h>
+#include <exec/libraries.h>
+
+/* file handles are host FILE pointers */
+typedef void *BPTR;
+
+#define DOSTRUE         (-1L)
+#define DOSFALSE        (0L)
+
+#define MODE_OLDFILE    1005
+#define MODE_NEWFILE    1006
+#define MODE_READWRITE  1004
+
+#define SIGBREAKB_CTRL_C    12
+#define SIGBREAKB_CTRL_D    13
+#define SIGBREAKB_CTRL_E    14
+#define SIGBREAKB_CTRL_F    15
+
+#define SIGBREAKF_CTRL_C    (1L<<SIGBREAKB_CTRL_C)
+#define SIGBREAKF_CTRL_D    (1L<<SIGBREAKB_CTRL_D)
+#define SIGBREAKF_CTRL_E    (1L<<SIGBREAKB_CTRL_E)
+#define SIGBREAKF_CTRL_F    (1L<<SIGBREAKB_CTRL_F)
+
+#define OFFSET_BEGINNING    -1
+#define OFFSET_CURRENT      0
+#define OFFSET_END          1
+
+#define SHARED_LOCK     -2
+#define ACCESS_READ     SHARED_LOCK
+#define EXCLUSIVE_LOCK  -1
+#define ACCESS_WRITE    EXCLUSIVE_LOCK
+
+#define DOS_FILEHANDLE  0
+#define DOS_FIB         2
+
+#define TICKS_PER_SECOND    50
+
+#define RETURN_OK       0
+#define RETURN_WARN     5
+#define RETURN_ERROR    10
+#define RETURN_FAIL     20
+
+#define ERROR_NO_FREE_STORE         103
+#define ERROR_REQUIRED_ARG_MISSING  116
+#define ERROR_TOO_MANY_ARGS         118
+#define ERROR_BAD_NUMBER            115
+#define ERROR_OBJECT_NOT_FOUND      205
+#define ERROR_LINE_TOO_LONG         120
+#define ERROR_KEY_NEEDS_ARG         122
+
+struct DateStamp {
+    LONG ds_Days;
+    LONG ds_Minute;
+    LONG ds_Tick;
+};
+
+struct FileInfoBlock {
+    LONG             fib_DiskKey;
+    LONG             fib_DirEntryType;
+    char             fib_FileName[108];
+    LONG             fib_Protection;
+    LONG             fib_EntryType;
+    LONG             fib_Size;
+    LONG             fib_NumBlocks;
+    struct DateStamp fib_Date;
+    char             fib_Comment[80];
+};
+
+struct DosLibrary {
+    struct Library dl_lib;
+};
+
+#endif
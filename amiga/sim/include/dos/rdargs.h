@@ -0,0 +1,22 @@
+#ifndef DOS_RDARGS_H
+#define DOS_RDARGS_H
+
+#include <exec/types.h>
+
+struct CSource {
+    UBYTE  *CS_Buffer;
+    LONG    CS_Length;
+    LONG    CS_CurChr;
+};
+
+/* parsed strings and numbers are kept in RDA_Buffer until FreeArgs() */
+struct RDArgs {
+    struct CSource  RDA_Source;
+    LONG            RDA_DAList;
+    UBYTE          *RDA_Buffer;
+    LONG            RDA_BufSiz;
+    UBYTE          *RDA_ExtHelp;
+    LONG            RDA_Flags;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef EXEC_EXECBASE_H
+#define EXEC_EXECBASE_H
+
+#include <exec/libraries.h>
+#include <exec/lists.h>
+
+struct ExecBase {
+    struct Library LibNode;
+    struct List    PortList;
+};
+
+#endif
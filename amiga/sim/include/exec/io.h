@@ -0,0 +1,36 @@
+#ifndef EXEC_IO_H
+#define EXEC_IO_H
+
+#include <exec/ports.h>
+#include <exec/libraries.h>
+
+struct Device {
+    struct Library dd_Library;
+};
+
+struct Unit {
+    struct MsgPort unit_MsgPort;
+};
+
+struct IORequest {
+    struct Message  io_Message;
+    struct Device  *io_Device;
+    struct Unit    *io_Unit;
+    UWORD           io_Command;
+    UBYTE           io_Flags;
+    BYTE            io_Error;
+};
+
+#define IOF_QUICK       (1<<0)
+
+#define CMD_INVALID     0
+#define CMD_RESET       1
+#define CMD_READ        2
+#define CMD_WRITE       3
+#define CMD_NONSTD      9
+
+#define IOERR_OPENFAIL  (-1)
+#define IOERR_ABORTED   (-2)
+#define IOERR_NOCMD     (-3)
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef EXEC_LIBRARIES_H
+#define EXEC_LIBRARIES_H
+
+#include <exec/nodes.h>
+
+struct Library {
+    struct Node lib_Node;
+    UWORD       lib_Version;
+    UWORD       lib_Revision;
+    APTR        lib_IdString;
+    UWORD       lib_OpenCnt;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef EXEC_PORTS_H
+#define EXEC_PORTS_H
+
+#include <exec/lists.h>
+
+struct Task;
+
+struct MsgPort {
+    struct Node     mp_Node;
+    UBYTE           mp_Flags;
+    UBYTE           mp_SigBit;
+    void           *mp_SigTask;
+    struct List     mp_MsgList;
+};
+
+#define PA_SIGNAL       0
+#define PA_SOFTINT      1
+#define PA_IGNORE       2
+
+struct Message {
+    struct Node     mn_Node;
+    struct MsgPort *mn_ReplyPort;
+    UWORD           mn_Length;
+};
+
+#endif
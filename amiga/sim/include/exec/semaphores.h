@@ -0,0 +1,13 @@
+#ifndef EXEC_SEMAPHORES_H
+#define EXEC_SEMAPHORES_H
+
+#include <pthread.h>
+#include <exec/nodes.h>
+
+/* nests like the exec semaphore */
+struct SignalSemaphore {
+    struct Node     ss_Link;
+    pthread_mutex_t ss_Mutex;
+};
+
+#endif
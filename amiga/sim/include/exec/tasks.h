@@ -0,0 +1,26 @@
+#ifndef EXEC_TASKS_H
+#define EXEC_TASKS_H
+
+#include <exec/nodes.h>
+
+/* the state of the thread running the task is kept in tc_SimData */
+struct Task {
+    struct Node tc_Node;
+    ULONG       tc_SigAlloc;
+    APTR        tc_UserData;
+    APTR        tc_SimData;
+};
+
+#define SIGB_ABORT      0
+#define SIGB_CHILD      1
+#define SIGB_SINGLE     4
+#define SIGB_INTUITION  5
+#define SIGB_DOS        8
+
+#define SIGF_ABORT      (1L<<0)
+#define SIGF_CHILD      (1L<<1)
+#define SIGF_SINGLE     (1L<<4)
+#define SIGF_INTUITION  (1L<<5)
+#define SIGF_DOS        (1L<<8)
+
+#endif
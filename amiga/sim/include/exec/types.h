@@ -0,0 +1,31 @@
+#ifndef EXEC_TYPES_H
+#define EXEC_TYPES_H
+
+/* Amiga base types for the native host build. sizes match the Amiga */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VOID        void
+#define CONST       const
+
+typedef void           *APTR;
+typedef int32_t         LONG;
+typedef uint32_t        ULONG;
+typedef int16_t         WORD;
+typedef uint16_t        UWORD;
+typedef int8_t          BYTE;
+typedef uint8_t         UBYTE;
+typedef int16_t         BOOL;
+typedef char           *STRPTR;
+typedef const char     *CONST_STRPTR;
+typedef uintptr_t       IPTR;
+
+#ifndef TRUE
+#define TRUE            1
+#endif
+#ifndef FALSE
+#define FALSE           0
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef LIBRARIES_BSDSOCKET_H
+#define LIBRARIES_BSDSOCKET_H
+
+/* bsdsocket.library maps to the host sockets */
+#include <exec/types.h>
+#include <devices/timer.h>
+#include <errno.h>
+#include <string.h>
+
+#endif
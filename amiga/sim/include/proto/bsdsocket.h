@@ -0,0 +1,6 @@
+#ifndef PROTO_BSDSOCKET_H
+#define PROTO_BSDSOCKET_H
+
+#include <clib/bsdsocket_protos.h>
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef PROTO_CAMD_H
+#define PROTO_CAMD_H
+
+/* camd.library is emulated in-process on the host (sim-camd.c) */
+
+#ifndef __NOLIBBASE__
+extern struct Library *CamdBase;
+#endif
+
+#include <clib/camd_protos.h>
+
+/* the varargs stubs are always real functions here */
+struct MidiNode *CreateMidi(Tag tag, ...);
+BOOL SetMidiAttrs(struct MidiNode *mn, Tag tag, ...);
+ULONG GetMidiAttrs(struct MidiNode *mn, Tag tag, ...);
+struct MidiLink *AddMidiLink(struct MidiNode *mn, LONG type, Tag tag, ...);
+BOOL SetMidiLinkAttrs(struct MidiLink *ml, Tag tag, ...);
+ULONG GetMidiLinkAttrs(struct MidiLink *ml, Tag tag, ...);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef PROTO_DOS_H
+#define PROTO_DOS_H
+
+#include <clib/dos_protos.h>
+
+#ifndef __NOLIBBASE__
+extern struct DosLibrary *DOSBase;
+#endif
+
+#endif
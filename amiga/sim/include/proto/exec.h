@@ -0,0 +1,11 @@
+#ifndef PROTO_EXEC_H
+#define PROTO_EXEC_H
+
+#include <clib/exec_protos.h>
+#include <string.h>
+
+#ifndef __NOLIBBASE__
+extern struct ExecBase *SysBase;
+#endif
+
+#endif
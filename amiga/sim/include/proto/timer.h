@@ -0,0 +1,6 @@
+#ifndef PROTO_TIMER_H
+#define PROTO_TIMER_H
+
+#include <clib/timer_protos.h>
+
+#endif
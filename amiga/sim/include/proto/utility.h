@@ -0,0 +1,10 @@
+#ifndef PROTO_UTILITY_H
+#define PROTO_UTILITY_H
+
+#include <clib/utility_protos.h>
+
+#ifndef __NOLIBBASE__
+extern struct UtilityBase *UtilityBase;
+#endif
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef UTILITY_HOOKS_H
+#define UTILITY_HOOKS_H
+
+#include <exec/nodes.h>
+
+typedef IPTR (*HOOKFUNC)();
+
+struct Hook {
+    struct MinNode  h_MinNode;
+    HOOKFUNC        h_Entry;
+    HOOKFUNC        h_SubEntry;
+    APTR            h_Data;
+};
+
+#endif
@@ -0,0 +1,1316 @@
+/*
+ * sim-camd.c - camd.library emulated in-process
+ *
+ * Clusters, nodes and links work like in camd.library: all messages a
+ * sender link puts into a cluster are queued in the nodes of all receiver
+ * links of the cluster.
+ *
+ * Drivers are loaded from DEVS:midi/ like camd.library does with
+ * LoadSeg(): each file is a shared object exporting midi_drv_device.
+ * Port n of driver "name" shows up as the clusters name.out.n and
+ * name.in.n and is opened while links use one of them.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <dlfcn.h>
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/camd.h>
+#include <clib/alib_protos.h>
+#include <midi/camddevices.h>
+#include <midi/mididefs.h>
+#include <utility/hooks.h>
+
+#include "compiler.h"
+#include "midi-msg.h"
+#include "midi-parser.h"
+
+#include "sim.h"
+
+#define MAX_TAGS                32
+#define DEFAULT_MSG_QUEUE       128
+#define DEFAULT_SYSEX_SIZE      4096
+#define PARSER_SYSEX_SIZE       65536
+
+/* transmit buffer of a driver port */
+#define TX_BUF_SIZE             4096
+#define TX_BUF_MASK             (TX_BUF_SIZE - 1)
+/* a full buffer is retried this often before bytes are dropped */
+#define TX_FULL_RETRIES         10000
+
+#define DEVICE_SYMBOL           "midi_drv_device"
+
+struct sim_device;
+struct dev_port;
+
+struct sim_cluster {
+    struct MidiCluster  mc;
+    struct dev_port    *dev_port;   /* driver port behind the cluster */
+    BOOL                dev_out;    /* cluster feeds the port transmitter */
+};
+
+struct sim_node {
+    struct MidiNode     mn;
+    MidiMsg            *msgs;
+    ULONG               msg_put;
+    ULONG               msg_get;
+    /* sysex records: ULONG size + data */
+    UBYTE              *sysex;
+    ULONG               sysex_put;
+    ULONG               sysex_get;
+    ULONG               sysex_left;     /* of the current record */
+    UBYTE               err;
+};
+
+struct sim_link {
+    struct MidiLink             ml;
+    BOOL                        parse;
+    BOOL                        parser_init;
+    struct midi_parser_handle   parser;
+};
+
+struct dev_port {
+    struct sim_device          *dev;
+    LONG                        num;
+    struct MidiPortData        *port_data;
+    struct sim_cluster         *out_cluster;
+    struct sim_cluster         *in_cluster;
+    struct midi_parser_handle   rx_parser;
+    UBYTE                       tx_buf[TX_BUF_SIZE];
+    volatile ULONG              tx_put;
+    volatile ULONG              tx_get;
+    ULONG                       tx_drops;
+};
+
+struct sim_device {
+    struct sim_device      *next;
+    void                   *handle;
+    struct MidiDeviceData  *mdd;
+    ULONG                   open_cnt;
+    struct dev_port        *ports;
+};
+
+typedef ULONG (*tx_func_t)(APTR userdata);
+typedef void (*rx_func_t)(UWORD input, APTR userdata);
+typedef struct MidiPortData *(*open_port_t)(struct MidiDeviceData *data, LONG portnum,
+                                            tx_func_t tx_func, rx_func_t rx_func,
+                                            APTR userdata);
+typedef void (*close_port_t)(struct MidiDeviceData *data, LONG portnum);
+
+static pthread_mutex_t camd_lock;
+static pthread_once_t camd_once = PTHREAD_ONCE_INIT;
+static struct List clusters;
+static struct List nodes;
+static struct sim_device *devices;
+
+/* pointer values in varargs tags. all other values are passed as ints */
+static const Tag node_ptr_tags[] = {
+    MIDI_Name, MIDI_SignalTask, MIDI_RecvHook, MIDI_PartHook,
+    MIDI_TimeStamp, MIDI_Image, MIDI_ErrorCode, TAG_END
+};
+static const Tag link_ptr_tags[] = {
+    MLINK_Location, MLINK_UserData, MLINK_Comment, MLINK_Name,
+    MLINK_ErrorCode, TAG_END
+};
+
+static void camd_expunge(void);
+static struct sim_device *load_device(const char *path);
+
+/* ----- setup ----- */
+
+static void lock_camd(void)
+{
+    pthread_mutex_lock(&camd_lock);
+}
+
+static void unlock_camd(void)
+{
+    pthread_mutex_unlock(&camd_lock);
+}
+
+static void camd_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&camd_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    NewList(&clusters);
+    NewList(&nodes);
+
+    /* load all drivers in name order */
+    char buf[512];
+    const char *dir_name = sim_host_path("DEVS:midi", buf, sizeof(buf));
+    struct dirent **entries;
+    int num = scandir(dir_name, &entries, NULL, alphasort);
+    struct sim_device **tail = &devices;
+    for(int i=0;i<num;i++) {
+        if(entries[i]->d_name[0] != '.') {
+            char path[768];
+            snprintf(path, sizeof(path), "%s/%s", dir_name, entries[i]->d_name);
+            struct sim_device *dev = load_device(path);
+            if(dev != NULL) {
+                *tail = dev;
+                tail = &dev->next;
+            }
+        }
+        free(entries[i]);
+    }
+    if(num >= 0) {
+        free(entries);
+    }
+
+    atexit(camd_expunge);
+}
+
+static void init_once(void)
+{
+    pthread_once(&camd_once, camd_init);
+}
+
+static BOOL is_ptr_tag(Tag tag, const Tag *ptr_tags)
+{
+    while(*ptr_tags != TAG_END) {
+        if(*ptr_tags++ == tag) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void collect_tags(struct TagItem *tags, const Tag *ptr_tags, Tag tag, va_list ap)
+{
+    int num = 0;
+    while((tag != TAG_END) && (num < MAX_TAGS - 1)) {
+        tags[num].ti_Tag = tag;
+        if(is_ptr_tag(tag, ptr_tags)) {
+            tags[num].ti_Data = (IPTR)va_arg(ap, void *);
+        } else {
+            tags[num].ti_Data = (IPTR)va_arg(ap, ULONG);
+        }
+        num++;
+        tag = va_arg(ap, ULONG);
+    }
+    tags[num].ti_Tag = TAG_END;
+    tags[num].ti_Data = 0;
+}
+
+static void set_error_code(const struct TagItem *tags, Tag code_tag, ULONG code)
+{
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        if((t->ti_Tag == code_tag) && (t->ti_Data != 0)) {
+            *(ULONG *)t->ti_Data = code;
+        }
+    }
+}
+
+static char *copy_name(const char *name)
+{
+    return (name != NULL) ? strdup(name) : NULL;
+}
+
+/* ----- clusters ----- */
+
+static struct sim_cluster *find_cluster(const char *name)
+{
+    struct Node *n;
+    for(n=clusters.lh_Head;n->ln_Succ!=NULL;n=n->ln_Succ) {
+        if(strcmp(n->ln_Name, name) == 0) {
+            return (struct sim_cluster *)n;
+        }
+    }
+    return NULL;
+}
+
+static struct sim_cluster *add_cluster(const char *name)
+{
+    struct sim_cluster *cl = calloc(1, sizeof(struct sim_cluster));
+    if(cl == NULL) {
+        return NULL;
+    }
+    cl->mc.mcl_Node.ln_Name = copy_name(name);
+    NewList(&cl->mc.mcl_Receivers);
+    NewList(&cl->mc.mcl_Senders);
+    AddTail(&clusters, &cl->mc.mcl_Node);
+    return cl;
+}
+
+/* clusters of drivers stay. others go with their last link */
+static void check_cluster(struct sim_cluster *cl)
+{
+    if((cl->mc.mcl_Participants == 0) && (cl->dev_port == NULL)) {
+        Remove(&cl->mc.mcl_Node);
+        free(cl->mc.mcl_Node.ln_Name);
+        free(cl);
+    }
+}
+
+/* ----- message classes ----- */
+
+static WORD msg_type(UBYTE status, UBYTE data1)
+{
+    switch(status & MS_StatBits) {
+        case MS_NoteOff:
+        case MS_NoteOn:
+            return CMB_Note;
+        case MS_PolyPress:
+            return CMB_PolyPress;
+        case MS_Ctrl:
+            if(data1 < 0x20) {
+                return CMB_CtrlMSB;
+            } else if(data1 < 0x40) {
+                return CMB_CtrlLSB;
+            } else if(data1 < 0x46) {
+                return CMB_CtrlSwitch;
+            } else if(data1 < MC_DataIncr) {
+                return CMB_CtrlByte;
+            } else if(data1 <= MC_RPNH) {
+                return CMB_CtrlParam;
+            } else if(data1 < MM_Min) {
+                return CMB_CtrlUndef;
+            }
+            return CMB_Mode;
+        case MS_Prog:
+            return CMB_Prog;
+        case MS_ChanPress:
+            return CMB_ChanPress;
+        case MS_PitchBend:
+            return CMB_PitchBend;
+        default:
+            if(status == MS_SysEx) {
+                return CMB_SysEx;
+            } else if(status >= MS_RealTime) {
+                return CMB_RealTime;
+            }
+            return CMB_SysCom;
+    }
+}
+
+static WORD msg_len(UBYTE status)
+{
+    if(status < MS_System) {
+        UBYTE cmd = status & MS_StatBits;
+        return ((cmd == MS_Prog) || (cmd == MS_ChanPress)) ? 2 : 3;
+    }
+    switch(status) {
+        case MS_QtrFrame:
+        case MS_SongSelect:
+            return 2;
+        case MS_SongPos:
+            return 3;
+        case MS_SysEx:
+        case MS_EOX:
+        case 0xf4:
+        case 0xf5:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+static BOOL link_accepts(struct MidiLink *ml, UBYTE status, UBYTE data1)
+{
+    if((ml->ml_EventTypeMask & (1L << msg_type(status, data1))) == 0) {
+        return FALSE;
+    }
+    if((status < MS_System) && ((ml->ml_ChannelMask & (1 << (status & MS_ChanBits))) == 0)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* ----- node queues ----- */
+
+static void node_error(struct sim_node *sn, UBYTE err)
+{
+    sn->err |= err;
+    struct MidiNode *mn = &sn->mn;
+    if((mn->mi_ErrFilter & err) && (mn->mi_ReceiveSigBit != -1) && (mn->mi_SigTask != NULL)) {
+        Signal(mn->mi_SigTask, 1L << mn->mi_ReceiveSigBit);
+    }
+}
+
+static void node_notify(struct sim_node *sn, struct MidiLink *ml, MidiMsg *msg)
+{
+    struct MidiNode *mn = &sn->mn;
+    struct Hook *hook = mn->mi_ReceiveHook;
+    if(hook != NULL) {
+        hook->h_Entry(hook, ml, msg);
+    }
+    if((mn->mi_ReceiveSigBit != -1) && (mn->mi_SigTask != NULL)) {
+        Signal(mn->mi_SigTask, 1L << mn->mi_ReceiveSigBit);
+    }
+}
+
+/* stamp the message for the node. the hook sees it even if the queue is full */
+static void node_stamp_msg(struct sim_node *sn, struct MidiLink *ml, MidiMsg *msg)
+{
+    struct MidiNode *mn = &sn->mn;
+    msg->mm_Port = ml->ml_PortID;
+    msg->mm_Time = (mn->mi_TimeStamp != NULL) ? *mn->mi_TimeStamp : 0;
+}
+
+static BOOL node_put_msg(struct sim_node *sn, const MidiMsg *msg)
+{
+    struct MidiNode *mn = &sn->mn;
+    if(sn->msg_put - sn->msg_get == mn->mi_MsgQueueSize) {
+        node_error(sn, CMEF_BufferFull);
+        return FALSE;
+    }
+    sn->msgs[sn->msg_put % mn->mi_MsgQueueSize] = *msg;
+    sn->msg_put++;
+    return TRUE;
+}
+
+static void sysex_write(struct sim_node *sn, const void *data, ULONG size)
+{
+    const UBYTE *ptr = data;
+    ULONG ring = sn->mn.mi_SysExQueueSize;
+    for(ULONG i=0;i<size;i++) {
+        sn->sysex[sn->sysex_put++ % ring] = *ptr++;
+    }
+}
+
+static void sysex_read(struct sim_node *sn, void *data, ULONG size)
+{
+    UBYTE *ptr = data;
+    ULONG ring = sn->mn.mi_SysExQueueSize;
+    for(ULONG i=0;i<size;i++) {
+        *ptr++ = sn->sysex[sn->sysex_get++ % ring];
+    }
+}
+
+/* the data is only queued with its message. the hook is called anyway */
+static void node_put_sysex(struct sim_node *sn, struct MidiLink *ml,
+                           const UBYTE *data, ULONG size)
+{
+    ULONG ring = sn->mn.mi_SysExQueueSize;
+    ULONG need = size + sizeof(ULONG);
+    MidiMsg msg;
+    msg.l[0] = 0;
+    msg.mm_Status = MS_SysEx;
+    node_stamp_msg(sn, ml, &msg);
+
+    if(need > ring) {
+        node_error(sn, CMEF_SysExTooBig);
+    }
+    else if(need > ring - (sn->sysex_put - sn->sysex_get)) {
+        node_error(sn, CMEF_SysExFull);
+    }
+    else if(node_put_msg(sn, &msg)) {
+        sysex_write(sn, &size, sizeof(ULONG));
+        sysex_write(sn, data, size);
+    }
+    node_notify(sn, ml, &msg);
+}
+
+/* ----- delivery ----- */
+
+static void dev_put_bytes(struct dev_port *dp, const UBYTE *data, ULONG size);
+
+static void deliver_msg(struct sim_cluster *cl, MidiMsg *msg)
+{
+    UBYTE status = msg->mm_Status;
+    struct Node *n;
+    for(n=cl->mc.mcl_Receivers.lh_Head;n->ln_Succ!=NULL;n=n->ln_Succ) {
+        struct MidiLink *ml = (struct MidiLink *)n;
+        if(link_accepts(ml, status, msg->mm_Data1)) {
+            struct sim_node *sn = (struct sim_node *)ml->ml_MidiNode;
+            MidiMsg m = *msg;
+            node_stamp_msg(sn, ml, &m);
+            node_put_msg(sn, &m);
+            node_notify(sn, ml, &m);
+        }
+    }
+    if(cl->dev_out && (cl->dev_port != NULL)) {
+        dev_put_bytes(cl->dev_port, msg->mm_Data, msg_len(status));
+    }
+}
+
+static void deliver_sysex(struct sim_cluster *cl, const UBYTE *data, ULONG size)
+{
+    struct Node *n;
+    for(n=cl->mc.mcl_Receivers.lh_Head;n->ln_Succ!=NULL;n=n->ln_Succ) {
+        struct MidiLink *ml = (struct MidiLink *)n;
+        if(ml->ml_EventTypeMask & CMF_SysEx) {
+            node_put_sysex((struct sim_node *)ml->ml_MidiNode, ml, data, size);
+        }
+    }
+    if(cl->dev_out && (cl->dev_port != NULL)) {
+        dev_put_bytes(cl->dev_port, data, size);
+    }
+}
+
+static void deliver_error(struct sim_cluster *cl, UBYTE err)
+{
+    struct Node *n;
+    for(n=cl->mc.mcl_Receivers.lh_Head;n->ln_Succ!=NULL;n=n->ln_Succ) {
+        struct MidiLink *ml = (struct MidiLink *)n;
+        node_error((struct sim_node *)ml->ml_MidiNode, err);
+    }
+}
+
+/* feed a byte stream through a parser into a cluster */
+static void parse_byte(struct midi_parser_handle *ph, struct sim_cluster *cl, UBYTE data)
+{
+    int res = midi_parser_feed(ph, data);
+    if(res == MIDI_PARSER_RET_MSG) {
+        MidiMsg msg;
+        UBYTE status = ph->msg.b[MIDI_MSG_STATUS];
+        WORD len = msg_len(status);
+        msg.l[0] = 0;
+        msg.mm_Status = status;
+        if(len > 1) {
+            msg.mm_Data1 = ph->msg.b[MIDI_MSG_DATA1];
+        }
+        if(len > 2) {
+            msg.mm_Data2 = ph->msg.b[MIDI_MSG_DATA2];
+        }
+        deliver_msg(cl, &msg);
+    }
+    else if(res == MIDI_PARSER_RET_SYSEX_OK) {
+        deliver_sysex(cl, ph->sysex_buf, ph->sysex_bytes);
+    }
+    else if(res == MIDI_PARSER_RET_SYSEX_TOO_LARGE) {
+        deliver_error(cl, CMEF_SysExTooBig);
+    }
+    else if(res == MIDI_PARSER_RET_ERROR) {
+        deliver_error(cl, CMEF_MsgErr);
+    }
+}
+
+/* ----- drivers ----- */
+
+/* called by the driver worker to fetch the next byte to transmit */
+static ASM ULONG dev_tx_func(REG(a2, APTR userdata))
+{
+    struct dev_port *dp = (struct dev_port *)userdata;
+    ULONG get = dp->tx_get;
+    if(get == __atomic_load_n(&dp->tx_put, __ATOMIC_ACQUIRE)) {
+        return 0x100;
+    }
+    UBYTE data = dp->tx_buf[get & TX_BUF_MASK];
+    __atomic_store_n(&dp->tx_get, get + 1, __ATOMIC_RELEASE);
+    return data;
+}
+
+/* called by the driver worker for each received byte */
+static ASM void dev_rx_func(REG(d0, UWORD input), REG(a2, APTR userdata))
+{
+    struct dev_port *dp = (struct dev_port *)userdata;
+    lock_camd();
+    parse_byte(&dp->rx_parser, dp->in_cluster, (UBYTE)input);
+    unlock_camd();
+}
+
+/* senders are serialized by the camd lock. the driver may be busy with
+   receiving and wait for the lock, so a full buffer is not waited for
+   forever */
+static void dev_put_bytes(struct dev_port *dp, const UBYTE *data, ULONG size)
+{
+    if(dp->port_data == NULL) {
+        return;
+    }
+    ULONG put = dp->tx_put;
+    for(ULONG i=0;i<size;i++) {
+        int retries = 0;
+        while(put - __atomic_load_n(&dp->tx_get, __ATOMIC_ACQUIRE) == TX_BUF_SIZE) {
+            __atomic_store_n(&dp->tx_put, put, __ATOMIC_RELEASE);
+            dp->port_data->ActivateXmit();
+            if(++retries == TX_FULL_RETRIES) {
+                dp->tx_drops += size - i;
+                return;
+            }
+            sched_yield();
+        }
+        dp->tx_buf[put & TX_BUF_MASK] = data[i];
+        put++;
+    }
+    __atomic_store_n(&dp->tx_put, put, __ATOMIC_RELEASE);
+    dp->port_data->ActivateXmit();
+}
+
+static void open_port(struct dev_port *dp)
+{
+    if(dp->port_data != NULL) {
+        return;
+    }
+    midi_parser_init(&dp->rx_parser, sim_exec_base(), (UBYTE)dp->num, PARSER_SYSEX_SIZE);
+    dp->tx_put = 0;
+    dp->tx_get = 0;
+    struct MidiDeviceData *mdd = dp->dev->mdd;
+    open_port_t open_func = (open_port_t)mdd->OpenPort;
+    dp->port_data = open_func(mdd, dp->num, dev_tx_func, dev_rx_func, dp);
+}
+
+/* a port is closed when both of its clusters are unused */
+static void check_port(struct dev_port *dp)
+{
+    if((dp->port_data == NULL) ||
+       (dp->in_cluster->mc.mcl_Participants > 0) ||
+       (dp->out_cluster->mc.mcl_Participants > 0)) {
+        return;
+    }
+    dp->port_data = NULL;
+
+    /* the driver worker may wait for the lock in dev_rx_func() */
+    struct MidiDeviceData *mdd = dp->dev->mdd;
+    close_port_t close_func = (close_port_t)mdd->ClosePort;
+    unlock_camd();
+    close_func(mdd, dp->num);
+    lock_camd();
+    midi_parser_exit(&dp->rx_parser);
+}
+
+static struct sim_device *load_device(const char *path)
+{
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(handle == NULL) {
+        return NULL;
+    }
+    struct MidiDeviceData **ptr = dlsym(handle, DEVICE_SYMBOL);
+    if((ptr == NULL) || ((*ptr)->Magic != MDD_Magic)) {
+        dlclose(handle);
+        return NULL;
+    }
+    struct MidiDeviceData *mdd = *ptr;
+    if(!mdd->Init()) {
+        dlclose(handle);
+        return NULL;
+    }
+
+    struct sim_device *dev = calloc(1, sizeof(struct sim_device));
+    struct dev_port *ports = calloc(mdd->NPorts, sizeof(struct dev_port));
+    if((dev == NULL) || (ports == NULL)) {
+        free(dev);
+        free(ports);
+        mdd->Expunge();
+        dlclose(handle);
+        return NULL;
+    }
+    dev->handle = handle;
+    dev->mdd = mdd;
+    dev->ports = ports;
+
+    for(int i=0;i<mdd->NPorts;i++) {
+        struct dev_port *dp = &ports[i];
+        char name[128];
+        dp->dev = dev;
+        dp->num = i;
+        snprintf(name, sizeof(name), "%s.out.%d", mdd->Name, i);
+        dp->out_cluster = add_cluster(name);
+        snprintf(name, sizeof(name), "%s.in.%d", mdd->Name, i);
+        dp->in_cluster = add_cluster(name);
+        if((dp->out_cluster != NULL) && (dp->in_cluster != NULL)) {
+            dp->out_cluster->dev_port = dp;
+            dp->out_cluster->dev_out = TRUE;
+            dp->in_cluster->dev_port = dp;
+        }
+    }
+    return dev;
+}
+
+static void camd_expunge(void)
+{
+    lock_camd();
+    struct sim_device *dev = devices;
+    devices = NULL;
+    unlock_camd();
+
+    while(dev != NULL) {
+        struct sim_device *next = dev->next;
+        struct MidiDeviceData *mdd = dev->mdd;
+        for(int i=0;i<mdd->NPorts;i++) {
+            struct dev_port *dp = &dev->ports[i];
+            if(dp->port_data != NULL) {
+                dp->port_data = NULL;
+                ((close_port_t)mdd->ClosePort)(mdd, i);
+                midi_parser_exit(&dp->rx_parser);
+            }
+        }
+        mdd->Expunge();
+        /* keep the code mapped: driver tasks may still be leaving */
+        free(dev->ports);
+        free(dev);
+        dev = next;
+    }
+}
+
+/* ----- library ----- */
+
+APTR LockCAMD(ULONG locknum)
+{
+    init_once();
+    lock_camd();
+    return &camd_lock;
+}
+
+void UnlockCAMD(APTR lock)
+{
+    if(lock != NULL) {
+        unlock_camd();
+    }
+}
+
+/* ----- nodes ----- */
+
+static BOOL alloc_queues(struct sim_node *sn, ULONG msg_size, ULONG sysex_size)
+{
+    MidiMsg *msgs = calloc(msg_size, sizeof(MidiMsg));
+    UBYTE *sysex = malloc(sysex_size);
+    if((msgs == NULL) || (sysex == NULL)) {
+        free(msgs);
+        free(sysex);
+        return FALSE;
+    }
+    free(sn->msgs);
+    free(sn->sysex);
+    sn->msgs = msgs;
+    sn->sysex = sysex;
+    sn->mn.mi_MsgQueueSize = msg_size;
+    sn->mn.mi_SysExQueueSize = sysex_size;
+    sn->msg_put = sn->msg_get = 0;
+    sn->sysex_put = sn->sysex_get = 0;
+    sn->sysex_left = 0;
+    return TRUE;
+}
+
+static BOOL set_node_attrs(struct sim_node *sn, const struct TagItem *tags)
+{
+    struct MidiNode *mn = &sn->mn;
+    ULONG msg_size = mn->mi_MsgQueueSize;
+    ULONG sysex_size = mn->mi_SysExQueueSize;
+
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        switch(t->ti_Tag) {
+            case MIDI_Name:
+                free(mn->mi_Node.ln_Name);
+                mn->mi_Node.ln_Name = copy_name((const char *)t->ti_Data);
+                break;
+            case MIDI_SignalTask:
+                mn->mi_SigTask = (struct Task *)t->ti_Data;
+                break;
+            case MIDI_RecvHook:
+                mn->mi_ReceiveHook = (struct Hook *)t->ti_Data;
+                break;
+            case MIDI_PartHook:
+                mn->mi_ParticipantHook = (struct Hook *)t->ti_Data;
+                break;
+            case MIDI_RecvSignal:
+                mn->mi_ReceiveSigBit = (BYTE)t->ti_Data;
+                break;
+            case MIDI_PartSignal:
+                mn->mi_ParticipantSigBit = (BYTE)t->ti_Data;
+                break;
+            case MIDI_MsgQueue:
+                msg_size = (ULONG)t->ti_Data;
+                break;
+            case MIDI_SysExSize:
+                sysex_size = (ULONG)t->ti_Data;
+                break;
+            case MIDI_TimeStamp:
+                mn->mi_TimeStamp = (ULONG *)t->ti_Data;
+                break;
+            case MIDI_ErrFilter:
+                mn->mi_ErrFilter = (UBYTE)t->ti_Data;
+                break;
+            case MIDI_ClientType:
+                mn->mi_ClientType = (UWORD)t->ti_Data;
+                break;
+            case MIDI_Image:
+                mn->mi_Image = (struct Image *)t->ti_Data;
+                break;
+        }
+    }
+
+    if(msg_size == 0) {
+        msg_size = DEFAULT_MSG_QUEUE;
+    }
+    if(sysex_size == 0) {
+        sysex_size = DEFAULT_SYSEX_SIZE;
+    }
+    if((msg_size != mn->mi_MsgQueueSize) || (sysex_size != mn->mi_SysExQueueSize)) {
+        if(!alloc_queues(sn, msg_size, sysex_size)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+struct MidiNode *CreateMidiA(CONST struct TagItem *tags)
+{
+    init_once();
+
+    struct sim_node *sn = calloc(1, sizeof(struct sim_node));
+    if(sn == NULL) {
+        set_error_code(tags, MIDI_ErrorCode, CME_NoMem);
+        return NULL;
+    }
+    struct MidiNode *mn = &sn->mn;
+    mn->mi_Node.ln_Type = NT_USER;
+    NewList((struct List *)&mn->mi_OutLinks);
+    NewList((struct List *)&mn->mi_InLinks);
+    mn->mi_SigTask = FindTask(NULL);
+    mn->mi_ReceiveSigBit = -1;
+    mn->mi_ParticipantSigBit = -1;
+
+    lock_camd();
+    BOOL ok = set_node_attrs(sn, tags);
+    if(ok) {
+        AddTail(&nodes, &mn->mi_Node);
+    }
+    unlock_camd();
+
+    if(!ok) {
+        set_error_code(tags, MIDI_ErrorCode, CME_NoMem);
+        free(mn->mi_Node.ln_Name);
+        free(sn->msgs);
+        free(sn->sysex);
+        free(sn);
+        return NULL;
+    }
+    return mn;
+}
+
+struct MidiNode *CreateMidi(Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, node_ptr_tags, tag, ap);
+    va_end(ap);
+    return CreateMidiA(tags);
+}
+
+void DeleteMidi(struct MidiNode *mn)
+{
+    if(mn == NULL) {
+        return;
+    }
+    struct sim_node *sn = (struct sim_node *)mn;
+    struct MinNode *n;
+    while((n = mn->mi_InLinks.mlh_Head)->mln_Succ != NULL) {
+        RemoveMidiLink((struct MidiLink *)((UBYTE *)n - offsetof(struct MidiLink, ml_OwnerNode)));
+    }
+    while((n = mn->mi_OutLinks.mlh_Head)->mln_Succ != NULL) {
+        RemoveMidiLink((struct MidiLink *)((UBYTE *)n - offsetof(struct MidiLink, ml_OwnerNode)));
+    }
+
+    lock_camd();
+    Remove(&mn->mi_Node);
+    unlock_camd();
+
+    free(mn->mi_Node.ln_Name);
+    free(sn->msgs);
+    free(sn->sysex);
+    free(sn);
+}
+
+BOOL SetMidiAttrsA(struct MidiNode *mn, CONST struct TagItem *tags)
+{
+    lock_camd();
+    BOOL ok = set_node_attrs((struct sim_node *)mn, tags);
+    unlock_camd();
+    return ok;
+}
+
+BOOL SetMidiAttrs(struct MidiNode *mn, Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, node_ptr_tags, tag, ap);
+    va_end(ap);
+    return SetMidiAttrsA(mn, tags);
+}
+
+ULONG GetMidiAttrsA(struct MidiNode *mn, CONST struct TagItem *tags)
+{
+    ULONG num = 0;
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        IPTR value;
+        switch(t->ti_Tag) {
+            case MIDI_Name:         value = (IPTR)mn->mi_Node.ln_Name; break;
+            case MIDI_SignalTask:   value = (IPTR)mn->mi_SigTask; break;
+            case MIDI_RecvHook:     value = (IPTR)mn->mi_ReceiveHook; break;
+            case MIDI_PartHook:     value = (IPTR)mn->mi_ParticipantHook; break;
+            case MIDI_RecvSignal:   value = mn->mi_ReceiveSigBit; break;
+            case MIDI_PartSignal:   value = mn->mi_ParticipantSigBit; break;
+            case MIDI_MsgQueue:     value = mn->mi_MsgQueueSize; break;
+            case MIDI_SysExSize:    value = mn->mi_SysExQueueSize; break;
+            case MIDI_TimeStamp:    value = (IPTR)mn->mi_TimeStamp; break;
+            case MIDI_ErrFilter:    value = mn->mi_ErrFilter; break;
+            case MIDI_ClientType:   value = mn->mi_ClientType; break;
+            case MIDI_Image:        value = (IPTR)mn->mi_Image; break;
+            default:
+                continue;
+        }
+        if(is_ptr_tag(t->ti_Tag, node_ptr_tags)) {
+            *(IPTR *)t->ti_Data = value;
+        } else {
+            *(ULONG *)t->ti_Data = (ULONG)value;
+        }
+        num++;
+    }
+    return num;
+}
+
+ULONG GetMidiAttrs(struct MidiNode *mn, Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, node_ptr_tags, tag, ap);
+    va_end(ap);
+    return GetMidiAttrsA(mn, tags);
+}
+
+struct MidiNode *NextMidi(struct MidiNode *mn)
+{
+    init_once();
+    struct Node *n = (mn == NULL) ? nodes.lh_Head : mn->mi_Node.ln_Succ;
+    return (n->ln_Succ != NULL) ? (struct MidiNode *)n : NULL;
+}
+
+struct MidiNode *FindMidi(CONST_STRPTR name)
+{
+    init_once();
+    struct Node *n;
+    for(n=nodes.lh_Head;n->ln_Succ!=NULL;n=n->ln_Succ) {
+        if((n->ln_Name != NULL) && (strcmp(n->ln_Name, name) == 0)) {
+            return (struct MidiNode *)n;
+        }
+    }
+    return NULL;
+}
+
+void FlushMidi(struct MidiNode *mn)
+{
+    struct sim_node *sn = (struct sim_node *)mn;
+    lock_camd();
+    sn->msg_get = sn->msg_put;
+    sn->sysex_get = sn->sysex_put;
+    sn->sysex_left = 0;
+    unlock_camd();
+}
+
+/* ----- links ----- */
+
+static void set_link_attrs(struct sim_link *sl, const struct TagItem *tags)
+{
+    struct MidiLink *ml = &sl->ml;
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        switch(t->ti_Tag) {
+            case MLINK_ChannelMask:
+                ml->ml_ChannelMask = (UWORD)t->ti_Data;
+                break;
+            case MLINK_EventMask:
+                ml->ml_EventTypeMask = (ULONG)t->ti_Data;
+                break;
+            case MLINK_UserData:
+                ml->ml_UserData = (APTR)t->ti_Data;
+                break;
+            case MLINK_Comment:
+                ml->ml_ClusterComment = (char *)t->ti_Data;
+                break;
+            case MLINK_PortID:
+                ml->ml_PortID = (UBYTE)t->ti_Data;
+                break;
+            case MLINK_Private:
+                if(t->ti_Data) {
+                    ml->ml_Flags |= MLF_PrivateLink;
+                } else {
+                    ml->ml_Flags &= ~MLF_PrivateLink;
+                }
+                break;
+            case MLINK_Priority:
+                ml->ml_Node.ln_Pri = (BYTE)t->ti_Data;
+                break;
+            case MLINK_SysExFilter:
+            case MLINK_SysExFilterX:
+                ml->ml_SysExFilter.sxf_Packed = (ULONG)t->ti_Data;
+                break;
+            case MLINK_Parse:
+                sl->parse = (t->ti_Data != 0);
+                break;
+            case MLINK_Name:
+                ml->ml_Node.ln_Name = (char *)t->ti_Data;
+                break;
+        }
+    }
+}
+
+struct MidiLink *AddMidiLinkA(struct MidiNode *mn, LONG type, CONST struct TagItem *tags)
+{
+    const char *location = NULL;
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        if(t->ti_Tag == MLINK_Location) {
+            location = (const char *)t->ti_Data;
+        }
+    }
+    if((location == NULL) || ((type != MLTYPE_Receiver) && (type != MLTYPE_Sender))) {
+        return NULL;
+    }
+
+    struct sim_link *sl = calloc(1, sizeof(struct sim_link));
+    if(sl == NULL) {
+        set_error_code(tags, MLINK_ErrorCode, CME_NoMem);
+        return NULL;
+    }
+    struct MidiLink *ml = &sl->ml;
+    ml->ml_MidiNode = mn;
+    ml->ml_ChannelMask = 0xffff;
+    ml->ml_EventTypeMask = CMF_All;
+    ml->ml_Flags = (type == MLTYPE_Sender) ? MLF_Sender : 0;
+    set_link_attrs(sl, tags);
+
+    lock_camd();
+    struct sim_cluster *cl = find_cluster(location);
+    if(cl == NULL) {
+        cl = add_cluster(location);
+    }
+    if(cl == NULL) {
+        unlock_camd();
+        set_error_code(tags, MLINK_ErrorCode, CME_NoMem);
+        free(sl);
+        return NULL;
+    }
+    ml->ml_Location = &cl->mc;
+    if(ml->ml_ClusterComment == NULL) {
+        ml->ml_ClusterComment = cl->mc.mcl_Node.ln_Name;
+    }
+    if(type == MLTYPE_Sender) {
+        AddTail(&cl->mc.mcl_Senders, &ml->ml_Node);
+        AddTail((struct List *)&mn->mi_OutLinks, (struct Node *)&ml->ml_OwnerNode);
+    } else {
+        AddTail(&cl->mc.mcl_Receivers, &ml->ml_Node);
+        AddTail((struct List *)&mn->mi_InLinks, (struct Node *)&ml->ml_OwnerNode);
+    }
+    cl->mc.mcl_Participants++;
+    if(cl->dev_port != NULL) {
+        open_port(cl->dev_port);
+    }
+    unlock_camd();
+    return ml;
+}
+
+struct MidiLink *AddMidiLink(struct MidiNode *mn, LONG type, Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, link_ptr_tags, tag, ap);
+    va_end(ap);
+    return AddMidiLinkA(mn, type, tags);
+}
+
+void RemoveMidiLink(struct MidiLink *ml)
+{
+    if(ml == NULL) {
+        return;
+    }
+    struct sim_link *sl = (struct sim_link *)ml;
+    struct sim_cluster *cl = (struct sim_cluster *)ml->ml_Location;
+
+    lock_camd();
+    Remove(&ml->ml_Node);
+    Remove((struct Node *)&ml->ml_OwnerNode);
+    cl->mc.mcl_Participants--;
+    if(cl->dev_port != NULL) {
+        check_port(cl->dev_port);
+    }
+    check_cluster(cl);
+    unlock_camd();
+
+    if(sl->parser_init) {
+        midi_parser_exit(&sl->parser);
+    }
+    free(sl);
+}
+
+BOOL SetMidiLinkAttrsA(struct MidiLink *ml, CONST struct TagItem *tags)
+{
+    lock_camd();
+    set_link_attrs((struct sim_link *)ml, tags);
+    unlock_camd();
+    return TRUE;
+}
+
+BOOL SetMidiLinkAttrs(struct MidiLink *ml, Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, link_ptr_tags, tag, ap);
+    va_end(ap);
+    return SetMidiLinkAttrsA(ml, tags);
+}
+
+ULONG GetMidiLinkAttrsA(struct MidiLink *ml, CONST struct TagItem *tags)
+{
+    ULONG num = 0;
+    for(const struct TagItem *t=tags;t->ti_Tag!=TAG_END;t++) {
+        IPTR value;
+        switch(t->ti_Tag) {
+            case MLINK_Location:    value = (IPTR)ml->ml_Location->mcl_Node.ln_Name; break;
+            case MLINK_ChannelMask: value = ml->ml_ChannelMask; break;
+            case MLINK_EventMask:   value = ml->ml_EventTypeMask; break;
+            case MLINK_UserData:    value = (IPTR)ml->ml_UserData; break;
+            case MLINK_Comment:     value = (IPTR)ml->ml_ClusterComment; break;
+            case MLINK_PortID:      value = ml->ml_PortID; break;
+            case MLINK_Private:     value = (ml->ml_Flags & MLF_PrivateLink) != 0; break;
+            case MLINK_Priority:    value = ml->ml_Node.ln_Pri; break;
+            case MLINK_SysExFilter: value = ml->ml_SysExFilter.sxf_Packed; break;
+            case MLINK_Parse:       value = ((struct sim_link *)ml)->parse; break;
+            case MLINK_Name:        value = (IPTR)ml->ml_Node.ln_Name; break;
+            default:
+                continue;
+        }
+        if(is_ptr_tag(t->ti_Tag, link_ptr_tags)) {
+            *(IPTR *)t->ti_Data = value;
+        } else {
+            *(ULONG *)t->ti_Data = (ULONG)value;
+        }
+        num++;
+    }
+    return num;
+}
+
+ULONG GetMidiLinkAttrs(struct MidiLink *ml, Tag tag, ...)
+{
+    struct TagItem tags[MAX_TAGS];
+    va_list ap;
+    va_start(ap, tag);
+    collect_tags(tags, link_ptr_tags, tag, ap);
+    va_end(ap);
+    return GetMidiLinkAttrsA(ml, tags);
+}
+
+struct MidiLink *NextClusterLink(struct MidiCluster *mc, struct MidiLink *ml, LONG type)
+{
+    struct List *list = (type == MLTYPE_Sender) ? &mc->mcl_Senders : &mc->mcl_Receivers;
+    struct Node *n = (ml == NULL) ? list->lh_Head : ml->ml_Node.ln_Succ;
+    return (n->ln_Succ != NULL) ? (struct MidiLink *)n : NULL;
+}
+
+struct MidiLink *NextMidiLink(struct MidiNode *mn, struct MidiLink *ml, LONG type)
+{
+    struct MinList *list = (type == MLTYPE_Sender) ? &mn->mi_OutLinks : &mn->mi_InLinks;
+    struct MinNode *n = (ml == NULL) ? list->mlh_Head : ml->ml_OwnerNode.mln_Succ;
+    if(n->mln_Succ == NULL) {
+        return NULL;
+    }
+    return (struct MidiLink *)((UBYTE *)n - offsetof(struct MidiLink, ml_OwnerNode));
+}
+
+BOOL MidiLinkConnected(struct MidiLink *ml)
+{
+    struct MidiCluster *mc = ml->ml_Location;
+    struct sim_cluster *cl = (struct sim_cluster *)mc;
+    if(cl->dev_port != NULL) {
+        return TRUE;
+    }
+    struct List *other = (ml->ml_Flags & MLF_Sender) ? &mc->mcl_Receivers : &mc->mcl_Senders;
+    return other->lh_Head->ln_Succ != NULL;
+}
+
+/* ----- clusters ----- */
+
+struct MidiCluster *NextCluster(struct MidiCluster *mc)
+{
+    init_once();
+    struct Node *n = (mc == NULL) ? clusters.lh_Head : mc->mcl_Node.ln_Succ;
+    return (n->ln_Succ != NULL) ? (struct MidiCluster *)n : NULL;
+}
+
+struct MidiCluster *FindCluster(CONST_STRPTR name)
+{
+    init_once();
+    lock_camd();
+    struct sim_cluster *cl = find_cluster(name);
+    unlock_camd();
+    return (struct MidiCluster *)cl;
+}
+
+/* ----- messages ----- */
+
+void PutMidi(struct MidiLink *ml, LONG msgdata)
+{
+    MidiMsg msg;
+    msg.l[0] = (ULONG)msgdata;
+    msg.l[1] = 0;
+    lock_camd();
+    deliver_msg((struct sim_cluster *)ml->ml_Location, &msg);
+    unlock_camd();
+}
+
+BOOL GetMidi(struct MidiNode *mn, MidiMsg *msg)
+{
+    struct sim_node *sn = (struct sim_node *)mn;
+    BOOL got = FALSE;
+    lock_camd();
+    if(sn->msg_get != sn->msg_put) {
+        *msg = sn->msgs[sn->msg_get % mn->mi_MsgQueueSize];
+        sn->msg_get++;
+        got = TRUE;
+    }
+    unlock_camd();
+    return got;
+}
+
+BOOL WaitMidi(struct MidiNode *mn, MidiMsg *msg)
+{
+    while(!GetMidi(mn, msg)) {
+        if(mn->mi_ReceiveSigBit == -1) {
+            return FALSE;
+        }
+        ULONG got = Wait((1L << mn->mi_ReceiveSigBit) | SIGBREAKF_CTRL_C);
+        if(got & SIGBREAKF_CTRL_C) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void PutSysEx(struct MidiLink *ml, UBYTE *buffer)
+{
+    ULONG size = 1;
+    while(buffer[size - 1] != MS_EOX) {
+        size++;
+    }
+    lock_camd();
+    deliver_sysex((struct sim_cluster *)ml->ml_Location, buffer, size);
+    unlock_camd();
+}
+
+/* size of the rest of the current sysex */
+static ULONG query_sysex(struct sim_node *sn)
+{
+    if((sn->sysex_left == 0) && (sn->sysex_get != sn->sysex_put)) {
+        sysex_read(sn, &sn->sysex_left, sizeof(ULONG));
+    }
+    return sn->sysex_left;
+}
+
+ULONG QuerySysEx(struct MidiNode *mn)
+{
+    lock_camd();
+    ULONG size = query_sysex((struct sim_node *)mn);
+    unlock_camd();
+    return size;
+}
+
+ULONG GetSysEx(struct MidiNode *mn, UBYTE *buffer, ULONG length)
+{
+    struct sim_node *sn = (struct sim_node *)mn;
+    lock_camd();
+    ULONG size = query_sysex(sn);
+    if(size > length) {
+        size = length;
+    }
+    sysex_read(sn, buffer, size);
+    sn->sysex_left -= size;
+    unlock_camd();
+    return size;
+}
+
+void SkipSysEx(struct MidiNode *mn)
+{
+    struct sim_node *sn = (struct sim_node *)mn;
+    lock_camd();
+    sn->sysex_get += query_sysex(sn);
+    sn->sysex_left = 0;
+    unlock_camd();
+}
+
+UBYTE GetMidiErr(struct MidiNode *mn)
+{
+    struct sim_node *sn = (struct sim_node *)mn;
+    lock_camd();
+    UBYTE err = sn->err;
+    sn->err = 0;
+    unlock_camd();
+    return err;
+}
+
+WORD MidiMsgType(MidiMsg *msg)
+{
+    return msg_type(msg->mm_Status, msg->mm_Data1);
+}
+
+WORD MidiMsgLen(ULONG status)
+{
+    MidiMsg msg;
+    msg.l[0] = status;
+    return msg_len(msg.mm_Status);
+}
+
+void ParseMidi(struct MidiLink *ml, UBYTE *buffer, ULONG length)
+{
+    struct sim_link *sl = (struct sim_link *)ml;
+    if(!sl->parse) {
+        return;
+    }
+    lock_camd();
+    if(!sl->parser_init) {
+        midi_parser_init(&sl->parser, sim_exec_base(), 0, PARSER_SYSEX_SIZE);
+        sl->parser_init = TRUE;
+    }
+    struct sim_cluster *cl = (struct sim_cluster *)ml->ml_Location;
+    for(ULONG i=0;i<length;i++) {
+        parse_byte(&sl->parser, cl, buffer[i]);
+    }
+    unlock_camd();
+}
+
+/* ----- devices ----- */
+
+struct MidiDeviceData *OpenMidiDevice(UBYTE *name)
+{
+    init_once();
+    lock_camd();
+    struct sim_device *dev;
+    for(dev=devices;dev!=NULL;dev=dev->next) {
+        if(strcmp(dev->mdd->Name, (char *)name) == 0) {
+            dev->open_cnt++;
+            break;
+        }
+    }
+    unlock_camd();
+    return (dev != NULL) ? dev->mdd : NULL;
+}
+
+void CloseMidiDevice(struct MidiDeviceData *mdd)
+{
+    lock_camd();
+    struct sim_device *dev;
+    for(dev=devices;dev!=NULL;dev=dev->next) {
+        if((dev->mdd == mdd) && (dev->open_cnt > 0)) {
+            dev->open_cnt--;
+            break;
+        }
+    }
+    unlock_camd();
+}
+
+int RethinkCAMD(void)
+{
+    return 0;
+}
+
+void StartClusterNotify(struct ClusterNotifyNode *node)
+{
+}
+
+void EndClusterNotify(struct ClusterNotifyNode *node)
+{
+}
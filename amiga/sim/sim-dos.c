@@ -0,0 +1,751 @@
+/*
+ * sim-dos.c - dos.library files and argument parsing on the host
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+
+#include "sim.h"
+
+static __thread BPTR cur_input;
+static __thread BPTR cur_output;
+static __thread LONG io_err;
+
+static int sim_argc;
+static char **sim_argv;
+
+void sim_set_args(int argc, char **argv)
+{
+    sim_argc = argc;
+    sim_argv = argv;
+}
+
+/* glibc passes the arguments to constructors: unchanged Amiga tools
+   never call sim_set_args() */
+__attribute__((constructor)) static void init_args(int argc, char **argv, char **envp)
+{
+    if(sim_argv == NULL) {
+        sim_set_args(argc, argv);
+    }
+    /* like the Amiga console show output lines at once */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+/* ----- files ----- */
+
+const char *sim_host_path(const char *name, char *buf, int buf_size)
+{
+    static const struct {
+        const char *volume;
+        const char *env;
+        const char *def;
+    } assigns[] = {
+        { "ENV:", "SIM_ENV", "env" },
+        { "ENVARC:", "SIM_ENVARC", "envarc" },
+        { "DEVS:", "SIM_DEVS", "devs" },
+        { "T:", "TMPDIR", "/tmp" },
+        { "RAM:", "TMPDIR", "/tmp" },
+        { NULL, NULL, NULL }
+    };
+
+    for(int i=0;assigns[i].volume!=NULL;i++) {
+        int len = strlen(assigns[i].volume);
+        if(strncasecmp(name, assigns[i].volume, len) == 0) {
+            const char *dir = getenv(assigns[i].env);
+            if(dir == NULL) {
+                dir = assigns[i].def;
+            }
+            snprintf(buf, buf_size, "%s/%s", dir, name + len);
+            return buf;
+        }
+    }
+    return name;
+}
+
+BPTR Open(CONST_STRPTR name, LONG accessMode)
+{
+    char buf[512];
+    const char *mode;
+
+    switch(accessMode) {
+        case MODE_NEWFILE:
+            mode = "w+";
+            break;
+        case MODE_READWRITE:
+            mode = "a+";
+            break;
+        default:
+            mode = "r";
+            break;
+    }
+
+    FILE *fh = fopen(sim_host_path(name, buf, sizeof(buf)), mode);
+    if(fh == NULL) {
+        io_err = ERROR_OBJECT_NOT_FOUND;
+        return 0;
+    }
+    return (BPTR)fh;
+}
+
+LONG Close(BPTR file)
+{
+    if(file == 0) {
+        return DOSTRUE;
+    }
+    return (fclose((FILE *)file) == 0) ? DOSTRUE : DOSFALSE;
+}
+
+LONG Read(BPTR file, APTR buffer, LONG length)
+{
+    FILE *fh = (FILE *)file;
+    size_t num = fread(buffer, 1, length, fh);
+    if((num == 0) && ferror(fh)) {
+        io_err = errno;
+        return -1;
+    }
+    return (LONG)num;
+}
+
+LONG Write(BPTR file, const void *buffer, LONG length)
+{
+    FILE *fh = (FILE *)file;
+    size_t num = fwrite(buffer, 1, length, fh);
+    fflush(fh);
+    if(num != length) {
+        io_err = errno;
+        return -1;
+    }
+    return (LONG)num;
+}
+
+LONG Seek(BPTR file, LONG position, LONG offset)
+{
+    FILE *fh = (FILE *)file;
+    long old = ftell(fh);
+    int whence = SEEK_CUR;
+    if(offset == OFFSET_BEGINNING) {
+        whence = SEEK_SET;
+    } else if(offset == OFFSET_END) {
+        whence = SEEK_END;
+    }
+    if((old < 0) || (fseek(fh, position, whence) != 0)) {
+        io_err = errno;
+        return -1;
+    }
+    return (LONG)old;
+}
+
+/* buffered io */
+LONG FRead(BPTR fh, APTR block, ULONG blocklen, ULONG number)
+{
+    size_t num = fread(block, blocklen, number, (FILE *)fh);
+    if((num < number) && ferror((FILE *)fh)) {
+        io_err = errno;
+    }
+    return (LONG)num;
+}
+
+LONG FWrite(BPTR fh, const void *block, ULONG blocklen, ULONG number)
+{
+    size_t num = fwrite(block, blocklen, number, (FILE *)fh);
+    if(num < number) {
+        io_err = errno;
+    }
+    return (LONG)num;
+}
+
+LONG Flush(BPTR fh)
+{
+    return (fflush((FILE *)fh) == 0) ? DOSTRUE : DOSFALSE;
+}
+
+LONG DeleteFile(CONST_STRPTR name)
+{
+    char buf[512];
+    if(remove(sim_host_path(name, buf, sizeof(buf))) != 0) {
+        io_err = ERROR_OBJECT_NOT_FOUND;
+        return DOSFALSE;
+    }
+    return DOSTRUE;
+}
+
+BPTR Input(void)
+{
+    return (cur_input != 0) ? cur_input : (BPTR)stdin;
+}
+
+BPTR Output(void)
+{
+    return (cur_output != 0) ? cur_output : (BPTR)stdout;
+}
+
+BPTR SelectInput(BPTR fh)
+{
+    BPTR old = Input();
+    cur_input = fh;
+    return old;
+}
+
+BPTR SelectOutput(BPTR fh)
+{
+    BPTR old = Output();
+    cur_output = fh;
+    return old;
+}
+
+LONG IoErr(void)
+{
+    return io_err;
+}
+
+LONG SetIoErr(LONG result)
+{
+    LONG old = io_err;
+    io_err = result;
+    return old;
+}
+
+/* ----- locks ----- */
+
+/* a lock keeps the host path of the object */
+BPTR Lock(CONST_STRPTR name, LONG type)
+{
+    char buf[512];
+    struct stat st;
+    const char *path = sim_host_path(name, buf, sizeof(buf));
+    if(stat(path, &st) != 0) {
+        io_err = ERROR_OBJECT_NOT_FOUND;
+        return 0;
+    }
+    char *lock = strdup(path);
+    if(lock == NULL) {
+        io_err = ERROR_NO_FREE_STORE;
+    }
+    return (BPTR)lock;
+}
+
+void UnLock(BPTR lock)
+{
+    free((char *)lock);
+}
+
+/* days since 1.1.1978 */
+#define AMIGA_EPOCH     252460800
+
+LONG Examine(BPTR lock, struct FileInfoBlock *fib)
+{
+    struct stat st;
+    const char *path = (const char *)lock;
+    if(stat(path, &st) != 0) {
+        io_err = ERROR_OBJECT_NOT_FOUND;
+        return DOSFALSE;
+    }
+
+    memset(fib, 0, sizeof(struct FileInfoBlock));
+    const char *base = strrchr(path, '/');
+    base = (base != NULL) ? base + 1 : path;
+    strncpy(fib->fib_FileName, base, sizeof(fib->fib_FileName) - 1);
+    fib->fib_DirEntryType = S_ISDIR(st.st_mode) ? 2 : -3;
+    fib->fib_EntryType = fib->fib_DirEntryType;
+    fib->fib_Size = (LONG)st.st_size;
+    fib->fib_NumBlocks = (LONG)st.st_blocks;
+
+    long secs = (long)st.st_mtim.tv_sec - AMIGA_EPOCH;
+    if(secs < 0) {
+        secs = 0;
+    }
+    fib->fib_Date.ds_Days = secs / 86400;
+    fib->fib_Date.ds_Minute = (secs % 86400) / 60;
+    fib->fib_Date.ds_Tick = (secs % 60) * TICKS_PER_SECOND
+                          + st.st_mtim.tv_nsec / (1000000000L / TICKS_PER_SECOND);
+    return DOSTRUE;
+}
+
+APTR AllocDosObject(ULONG type, const struct TagItem *tags)
+{
+    if(type == DOS_FIB) {
+        return calloc(1, sizeof(struct FileInfoBlock));
+    }
+    io_err = ERROR_NO_FREE_STORE;
+    return NULL;
+}
+
+void FreeDosObject(ULONG type, APTR ptr)
+{
+    free(ptr);
+}
+
+/* < 0 if date1 is later than date2 */
+LONG CompareDates(const struct DateStamp *date1, const struct DateStamp *date2)
+{
+    if(date1->ds_Days != date2->ds_Days) {
+        return date2->ds_Days - date1->ds_Days;
+    }
+    if(date1->ds_Minute != date2->ds_Minute) {
+        return date2->ds_Minute - date1->ds_Minute;
+    }
+    return date2->ds_Tick - date1->ds_Tick;
+}
+
+/* ----- output ----- */
+
+LONG PutStr(CONST_STRPTR str)
+{
+    return (fputs(str, (FILE *)Output()) < 0) ? -1 : 0;
+}
+
+LONG Printf(CONST_STRPTR format, ...)
+{
+    char host_fmt[256];
+
+    va_list ap;
+    va_start(ap, format);
+    int res = vfprintf((FILE *)Output(), sim_host_format(format, host_fmt, sizeof(host_fmt)), ap);
+    va_end(ap);
+    return res;
+}
+
+LONG FPrintf(BPTR fh, CONST_STRPTR format, ...)
+{
+    char host_fmt[256];
+
+    va_list ap;
+    va_start(ap, format);
+    int res = vfprintf((FILE *)fh, sim_host_format(format, host_fmt, sizeof(host_fmt)), ap);
+    va_end(ap);
+    return res;
+}
+
+/* on the host the argument array is the va_list of the caller */
+LONG VPrintf(CONST_STRPTR format, const void *argarray)
+{
+    char host_fmt[256];
+
+    va_list ap;
+    va_copy(ap, *(va_list *)argarray);
+    int res = vfprintf((FILE *)Output(), sim_host_format(format, host_fmt, sizeof(host_fmt)), ap);
+    va_end(ap);
+    return res;
+}
+
+LONG PrintFault(LONG code, CONST_STRPTR header)
+{
+    static const struct {
+        LONG code;
+        const char *text;
+    } faults[] = {
+        { ERROR_NO_FREE_STORE, "not enough memory available" },
+        { ERROR_BAD_NUMBER, "bad number" },
+        { ERROR_REQUIRED_ARG_MISSING, "required argument missing" },
+        { ERROR_TOO_MANY_ARGS, "wrong number of arguments" },
+        { ERROR_LINE_TOO_LONG, "argument line invalid or too long" },
+        { ERROR_KEY_NEEDS_ARG, "keyword needs an argument" },
+        { ERROR_OBJECT_NOT_FOUND, "object not found" },
+        { 0, NULL }
+    };
+
+    const char *text = NULL;
+    for(int i=0;faults[i].text!=NULL;i++) {
+        if(faults[i].code == code) {
+            text = faults[i].text;
+            break;
+        }
+    }
+
+    FILE *fh = (FILE *)Output();
+    if(header != NULL) {
+        fprintf(fh, "%s: ", header);
+    }
+    if(text != NULL) {
+        fprintf(fh, "%s\n", text);
+    } else {
+        fprintf(fh, "Error %d\n", (int)code);
+    }
+    return DOSTRUE;
+}
+
+/* ----- ReadArgs ----- */
+
+#define MAX_ITEMS       32
+#define MAX_ALIASES     4
+#define MAX_TOKENS      128
+
+struct tmpl_item {
+    char   *names[MAX_ALIASES];
+    int     num_names;
+    BOOL    req;            /* /A */
+    BOOL    key;            /* /K */
+    BOOL    num;            /* /N */
+    BOOL    sw;             /* /S and /T */
+    BOOL    multi;          /* /M */
+    BOOL    rest;           /* /F */
+};
+
+/* all memory of a parse is freed with the args */
+struct sim_rdargs {
+    struct RDArgs   rda;
+    void          **blocks;
+    int             num_blocks;
+    int             max_blocks;
+};
+
+static void *rda_alloc(struct sim_rdargs *sr, size_t size)
+{
+    if(sr->num_blocks == sr->max_blocks) {
+        int max = sr->max_blocks ? sr->max_blocks * 2 : 16;
+        void **blocks = realloc(sr->blocks, max * sizeof(void *));
+        if(blocks == NULL) {
+            return NULL;
+        }
+        sr->blocks = blocks;
+        sr->max_blocks = max;
+    }
+    void *mem = calloc(1, size);
+    if(mem != NULL) {
+        sr->blocks[sr->num_blocks++] = mem;
+    }
+    return mem;
+}
+
+static char *rda_strdup(struct sim_rdargs *sr, const char *str)
+{
+    char *copy = rda_alloc(sr, strlen(str) + 1);
+    if(copy != NULL) {
+        strcpy(copy, str);
+    }
+    return copy;
+}
+
+static int parse_template(struct sim_rdargs *sr, const char *tmpl,
+                          struct tmpl_item *items)
+{
+    char *buf = rda_strdup(sr, tmpl);
+    if(buf == NULL) {
+        return -1;
+    }
+
+    int num = 0;
+    char *item_str = strtok(buf, ",");
+    while((item_str != NULL) && (num < MAX_ITEMS)) {
+        struct tmpl_item *item = &items[num++];
+        memset(item, 0, sizeof(struct tmpl_item));
+
+        /* modifiers */
+        char *mod = strchr(item_str, '/');
+        while(mod != NULL) {
+            *mod++ = '\0';
+            switch(*mod) {
+                case 'a': case 'A': item->req = TRUE; break;
+                case 'k': case 'K': item->key = TRUE; break;
+                case 'n': case 'N': item->num = TRUE; break;
+                case 's': case 'S':
+                case 't': case 'T': item->sw = TRUE; break;
+                case 'm': case 'M': item->multi = TRUE; break;
+                case 'f': case 'F': item->rest = TRUE; break;
+            }
+            mod = strchr(mod, '/');
+        }
+
+        /* names */
+        char *name = item_str;
+        while((name != NULL) && (item->num_names < MAX_ALIASES)) {
+            char *next = strchr(name, '=');
+            if(next != NULL) {
+                *next++ = '\0';
+            }
+            item->names[item->num_names++] = name;
+            name = next;
+        }
+
+        item_str = strtok(NULL, ",");
+    }
+    return num;
+}
+
+/* split a line into tokens. quotes group spaces, also after KEY= */
+static int tokenize(struct sim_rdargs *sr, const char *line, char **tokens)
+{
+    char *buf = rda_strdup(sr, line);
+    if(buf == NULL) {
+        return -1;
+    }
+
+    int num = 0;
+    char *ptr = buf;
+    while(*ptr != '\0') {
+        while((*ptr == ' ') || (*ptr == '\t') || (*ptr == '\n') || (*ptr == '\r')) {
+            ptr++;
+        }
+        if(*ptr == '\0') {
+            break;
+        }
+        if(num == MAX_TOKENS) {
+            return -1;
+        }
+        char *out = ptr;
+        tokens[num++] = out;
+        BOOL quoted = FALSE;
+        while(*ptr != '\0') {
+            char c = *ptr;
+            if(c == '"') {
+                quoted = !quoted;
+                ptr++;
+                continue;
+            }
+            if(!quoted && ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r'))) {
+                break;
+            }
+            *out++ = c;
+            ptr++;
+        }
+        if(*ptr != '\0') {
+            ptr++;
+        }
+        *out = '\0';
+    }
+    return num;
+}
+
+static int find_item(struct tmpl_item *items, int num_items, const char *key, int key_len)
+{
+    for(int i=0;i<num_items;i++) {
+        for(int j=0;j<items[i].num_names;j++) {
+            const char *name = items[i].names[j];
+            if((strlen(name) == key_len) && (strncasecmp(name, key, key_len) == 0)) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+static int store_value(struct sim_rdargs *sr, struct tmpl_item *item,
+                       IPTR *slot, char *value)
+{
+    if(item->num) {
+        char *end;
+        LONG *num = rda_alloc(sr, sizeof(LONG));
+        if(num == NULL) {
+            return ERROR_NO_FREE_STORE;
+        }
+        *num = strtol(value, &end, 10);
+        if((*value == '\0') || (*end != '\0')) {
+            return ERROR_BAD_NUMBER;
+        }
+        *slot = (IPTR)num;
+    } else {
+        *slot = (IPTR)value;
+    }
+    return 0;
+}
+
+static int parse_args(struct sim_rdargs *sr, struct tmpl_item *items, int num_items,
+                      char **tokens, int num_tokens, IPTR *array)
+{
+    BOOL used[MAX_TOKENS];
+    BOOL filled[MAX_ITEMS];
+    memset(used, 0, sizeof(used));
+    memset(filled, 0, sizeof(filled));
+
+    /* keywords first */
+    for(int t=0;t<num_tokens;t++) {
+        if(used[t]) {
+            continue;
+        }
+        char *tok = tokens[t];
+        char *eq = strchr(tok, '=');
+        int key_len = (eq != NULL) ? (eq - tok) : strlen(tok);
+        int idx = find_item(items, num_items, tok, key_len);
+        if(idx < 0) {
+            continue;
+        }
+        struct tmpl_item *item = &items[idx];
+        used[t] = TRUE;
+        if(item->sw) {
+            array[idx] = (IPTR)DOSTRUE;
+            filled[idx] = TRUE;
+            continue;
+        }
+        char *value = (eq != NULL) ? (eq + 1) : NULL;
+        if(value == NULL) {
+            if((t + 1 >= num_tokens) || used[t + 1]) {
+                return ERROR_KEY_NEEDS_ARG;
+            }
+            value = tokens[++t];
+            used[t] = TRUE;
+        }
+        if(item->multi) {
+            char **vec = rda_alloc(sr, 2 * sizeof(char *));
+            if(vec == NULL) {
+                return ERROR_NO_FREE_STORE;
+            }
+            vec[0] = value;
+            array[idx] = (IPTR)vec;
+        } else {
+            int res = store_value(sr, item, &array[idx], value);
+            if(res != 0) {
+                return res;
+            }
+        }
+        filled[idx] = TRUE;
+    }
+
+    /* positional args fill the remaining items in order */
+    int t = 0;
+    for(int i=0;i<num_items;i++) {
+        struct tmpl_item *item = &items[i];
+        if(filled[i] || item->key || item->sw) {
+            continue;
+        }
+        while((t < num_tokens) && used[t]) {
+            t++;
+        }
+        if(t == num_tokens) {
+            break;
+        }
+        if(item->multi || item->rest) {
+            /* leave tokens for required items after this one */
+            int reserve = 0;
+            for(int j=i+1;j<num_items;j++) {
+                if(!filled[j] && items[j].req && !items[j].key && !items[j].sw) {
+                    reserve++;
+                }
+            }
+            int avail = 0;
+            for(int k=t;k<num_tokens;k++) {
+                if(!used[k]) {
+                    avail++;
+                }
+            }
+            int take = avail - reserve;
+            if(take <= 0) {
+                continue;
+            }
+            if(item->multi) {
+                char **vec = rda_alloc(sr, (take + 1) * sizeof(char *));
+                if(vec == NULL) {
+                    return ERROR_NO_FREE_STORE;
+                }
+                int n = 0;
+                for(int k=t;(k<num_tokens) && (n<take);k++) {
+                    if(!used[k]) {
+                        vec[n++] = tokens[k];
+                        used[k] = TRUE;
+                    }
+                }
+                array[i] = (IPTR)vec;
+            } else {
+                size_t len = 1;
+                for(int k=t;k<num_tokens;k++) {
+                    len += strlen(tokens[k]) + 1;
+                }
+                char *str = rda_alloc(sr, len);
+                if(str == NULL) {
+                    return ERROR_NO_FREE_STORE;
+                }
+                int n = 0;
+                for(int k=t;(k<num_tokens) && (n<take);k++) {
+                    if(!used[k]) {
+                        if(n > 0) {
+                            strcat(str, " ");
+                        }
+                        strcat(str, tokens[k]);
+                        used[k] = TRUE;
+                        n++;
+                    }
+                }
+                array[i] = (IPTR)str;
+            }
+            filled[i] = TRUE;
+            continue;
+        }
+        int res = store_value(sr, item, &array[i], tokens[t]);
+        if(res != 0) {
+            return res;
+        }
+        used[t] = TRUE;
+        filled[i] = TRUE;
+    }
+
+    for(int k=0;k<num_tokens;k++) {
+        if(!used[k]) {
+            return ERROR_TOO_MANY_ARGS;
+        }
+    }
+    for(int i=0;i<num_items;i++) {
+        if(items[i].req && !filled[i]) {
+            return ERROR_REQUIRED_ARG_MISSING;
+        }
+    }
+    return 0;
+}
+
+void FreeArgs(struct RDArgs *args)
+{
+    struct sim_rdargs *sr = (struct sim_rdargs *)args;
+    if(sr == NULL) {
+        return;
+    }
+    for(int i=0;i<sr->num_blocks;i++) {
+        free(sr->blocks[i]);
+    }
+    free(sr->blocks);
+    free(sr);
+}
+
+/* arguments come from the selected input (e.g. a config file) or from
+   the host command line */
+struct RDArgs *ReadArgs(CONST_STRPTR arg_template, LONG *array, struct RDArgs *args)
+{
+    struct tmpl_item items[MAX_ITEMS];
+    char *tokens[MAX_TOKENS];
+    int num_tokens;
+
+    struct sim_rdargs *sr = calloc(1, sizeof(struct sim_rdargs));
+    if(sr == NULL) {
+        io_err = ERROR_NO_FREE_STORE;
+        return NULL;
+    }
+
+    int num_items = parse_template(sr, arg_template, items);
+    if(num_items < 0) {
+        FreeArgs(&sr->rda);
+        io_err = ERROR_NO_FREE_STORE;
+        return NULL;
+    }
+
+    if(Input() != (BPTR)stdin) {
+        char line[1024];
+        if(fgets(line, sizeof(line), (FILE *)Input()) == NULL) {
+            line[0] = '\0';
+        }
+        num_tokens = tokenize(sr, line, tokens);
+        if(num_tokens < 0) {
+            FreeArgs(&sr->rda);
+            io_err = ERROR_TOO_MANY_ARGS;
+            return NULL;
+        }
+    } else {
+        num_tokens = 0;
+        for(int i=1;(i<sim_argc) && (num_tokens<MAX_TOKENS);i++) {
+            tokens[num_tokens++] = sim_argv[i];
+        }
+    }
+
+    int res = parse_args(sr, items, num_items, tokens, num_tokens, (IPTR *)array);
+    if(res != 0) {
+        FreeArgs(&sr->rda);
+        io_err = res;
+        return NULL;
+    }
+    return &sr->rda;
+}
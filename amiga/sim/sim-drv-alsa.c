@@ -0,0 +1,289 @@
+/*
+ * sim-drv-alsa.c - ALSA sequencer ports as a driver in DEVS:midi
+ *
+ * The driver opens the sequencer client "camd-sim" with a duplex port for
+ * each driver port. Bytes put into the cluster alsa.out.n leave sequencer
+ * port n as events to all its subscribers and events sent to port n show
+ * up in alsa.in.n. Connect the ports to other clients with aconnect.
+ *
+ * Unlike the other drivers this is no Amiga code: it only exists for the
+ * emulated camd.library and talks to the host directly.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <pthread.h>
+#include <poll.h>
+#include <alsa/asoundlib.h>
+
+#include <exec/types.h>
+#include <midi/camddevices.h>
+
+#include "compiler.h"
+
+#define NUM_PORTS           4
+#define CLIENT_NAME         "camd-sim"
+/* a longer sysex leaves in several events */
+#define ENCODE_BUF_SIZE     256
+#define DECODE_BUF_SIZE     16
+/* the receiver checks for expunge this often */
+#define RX_POLL_MS          100
+#define MAX_POLL_FDS        4
+
+typedef ULONG (* ASM tx_func_t)(REG(a2, APTR) userdata);
+typedef void (* ASM rx_func_t)(REG(d0, UWORD input), REG(a2, APTR userdata));
+
+struct alsa_port {
+    struct MidiPortData     port_data;
+    int                     seq_port;
+    snd_midi_event_t       *encoder;
+    /* tx runs in the sender calling ActivateXmit, rx in the receiver.
+       both only take their own lock: the camd lock is taken inside */
+    pthread_mutex_t         tx_lock;
+    pthread_mutex_t         rx_lock;
+    tx_func_t               tx_func;
+    rx_func_t               rx_func;
+    APTR                    user_data;
+};
+
+static BOOL alsa_init(void);
+static void alsa_expunge(void);
+static ASM struct MidiPortData *alsa_open_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum),
+        REG(a0, tx_func_t tx_func),
+        REG(a1, rx_func_t rx_func),
+        REG(a2, APTR userdata)
+        );
+static ASM void alsa_close_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum)
+        );
+
+static struct MidiDeviceData my_dev = {
+    .Magic = MDD_Magic,
+    .Name = "alsa",
+    .IDString = "ALSA sequencer driver",
+    .Version = 0,
+    .Revision = 1,
+    .Init = alsa_init,
+    .Expunge = alsa_expunge,
+    .OpenPort = alsa_open_port,
+    .ClosePort = alsa_close_port,
+    .NPorts = NUM_PORTS,
+    .Flags = 1, // new style driver
+};
+
+/* the simulated camd.library finds the driver by this symbol */
+struct MidiDeviceData *midi_drv_device = &my_dev;
+
+static snd_seq_t *seq;
+static snd_midi_event_t *decoder;
+static struct alsa_port ports[NUM_PORTS];
+static pthread_t rx_thread;
+static volatile BOOL rx_quit;
+
+/* TX */
+
+static void xmit(struct alsa_port *ap)
+{
+    pthread_mutex_lock(&ap->tx_lock);
+    if(ap->tx_func != NULL) {
+        ULONG data;
+        snd_seq_event_t ev;
+        snd_seq_ev_clear(&ev);
+        while((data = ap->tx_func(ap->user_data)) < 0x100) {
+            if(snd_midi_event_encode_byte(ap->encoder, (int)data, &ev) == 1) {
+                snd_seq_ev_set_source(&ev, ap->seq_port);
+                snd_seq_ev_set_subs(&ev);
+                snd_seq_ev_set_direct(&ev);
+                snd_seq_event_output_direct(seq, &ev);
+                snd_seq_ev_clear(&ev);
+            }
+        }
+    }
+    pthread_mutex_unlock(&ap->tx_lock);
+}
+
+/* ActivateXmit has no arguments: one entry per port */
+static void xmit_0(void) { xmit(&ports[0]); }
+static void xmit_1(void) { xmit(&ports[1]); }
+static void xmit_2(void) { xmit(&ports[2]); }
+static void xmit_3(void) { xmit(&ports[3]); }
+
+static void (*xmit_funcs[NUM_PORTS])(void) = {
+    xmit_0, xmit_1, xmit_2, xmit_3
+};
+
+/* RX */
+
+static struct alsa_port *find_port(int seq_port)
+{
+    for(int i=0;i<NUM_PORTS;i++) {
+        if(ports[i].seq_port == seq_port) {
+            return &ports[i];
+        }
+    }
+    return NULL;
+}
+
+static void rx_event(snd_seq_event_t *ev)
+{
+    struct alsa_port *ap = find_port(ev->dest.port);
+    if(ap == NULL) {
+        return;
+    }
+
+    /* sysex chunks are passed on as is. the camd parser joins them */
+    UBYTE buf[DECODE_BUF_SIZE];
+    const UBYTE *data = buf;
+    long size;
+    if(ev->type == SND_SEQ_EVENT_SYSEX) {
+        data = ev->data.ext.ptr;
+        size = ev->data.ext.len;
+    } else {
+        size = snd_midi_event_decode(decoder, buf, sizeof(buf), ev);
+    }
+    if(size <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&ap->rx_lock);
+    if(ap->rx_func != NULL) {
+        for(long i=0;i<size;i++) {
+            ap->rx_func(data[i], ap->user_data);
+        }
+    }
+    pthread_mutex_unlock(&ap->rx_lock);
+}
+
+static void *rx_main(void *arg)
+{
+    struct pollfd fds[MAX_POLL_FDS];
+    int num = snd_seq_poll_descriptors(seq, fds, MAX_POLL_FDS, POLLIN);
+    while(!rx_quit) {
+        if(poll(fds, num, RX_POLL_MS) <= 0) {
+            continue;
+        }
+        while(snd_seq_event_input_pending(seq, 1) > 0) {
+            snd_seq_event_t *ev;
+            if(snd_seq_event_input(seq, &ev) < 0) {
+                break;
+            }
+            rx_event(ev);
+        }
+    }
+    return NULL;
+}
+
+/* Setup */
+
+static void free_ports(void)
+{
+    for(int i=0;i<NUM_PORTS;i++) {
+        struct alsa_port *ap = &ports[i];
+        if(ap->encoder != NULL) {
+            snd_midi_event_free(ap->encoder);
+            ap->encoder = NULL;
+        }
+        pthread_mutex_destroy(&ap->tx_lock);
+        pthread_mutex_destroy(&ap->rx_lock);
+    }
+    if(decoder != NULL) {
+        snd_midi_event_free(decoder);
+        decoder = NULL;
+    }
+    snd_seq_close(seq);
+    seq = NULL;
+}
+
+static BOOL alsa_init(void)
+{
+    if(snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, 0) < 0) {
+        return FALSE;
+    }
+    snd_seq_set_client_name(seq, CLIENT_NAME);
+
+    BOOL ok = (snd_midi_event_new(DECODE_BUF_SIZE, &decoder) == 0);
+    if(ok) {
+        /* one decoder serves all ports */
+        snd_midi_event_no_status(decoder, 1);
+    }
+    for(int i=0;i<NUM_PORTS;i++) {
+        struct alsa_port *ap = &ports[i];
+        char name[32];
+        pthread_mutex_init(&ap->tx_lock, NULL);
+        pthread_mutex_init(&ap->rx_lock, NULL);
+        ap->port_data.ActivateXmit = xmit_funcs[i];
+        snprintf(name, sizeof(name), "port %d", i);
+        ap->seq_port = snd_seq_create_simple_port(seq, name,
+            SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ |
+            SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+            SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+        if((ap->seq_port < 0) || (snd_midi_event_new(ENCODE_BUF_SIZE, &ap->encoder) < 0)) {
+            ok = FALSE;
+        }
+    }
+
+    rx_quit = FALSE;
+    if(ok && (pthread_create(&rx_thread, NULL, rx_main, NULL) != 0)) {
+        ok = FALSE;
+    }
+    if(!ok) {
+        free_ports();
+    }
+    return ok;
+}
+
+static void alsa_expunge(void)
+{
+    rx_quit = TRUE;
+    pthread_join(rx_thread, NULL);
+    free_ports();
+}
+
+static ASM struct MidiPortData *alsa_open_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum),
+        REG(a0, tx_func_t tx_func),
+        REG(a1, rx_func_t rx_func),
+        REG(a2, APTR userdata)
+        )
+{
+    if((portnum < 0) || (portnum >= NUM_PORTS)) {
+        return NULL;
+    }
+    struct alsa_port *ap = &ports[portnum];
+
+    pthread_mutex_lock(&ap->tx_lock);
+    snd_midi_event_reset_encode(ap->encoder);
+    ap->tx_func = tx_func;
+    ap->user_data = userdata;
+    pthread_mutex_unlock(&ap->tx_lock);
+
+    pthread_mutex_lock(&ap->rx_lock);
+    ap->rx_func = rx_func;
+    pthread_mutex_unlock(&ap->rx_lock);
+
+    return &ap->port_data;
+}
+
+/* the receiver may wait for the camd lock in rx_func: it is not held here */
+static ASM void alsa_close_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum)
+        )
+{
+    if((portnum < 0) || (portnum >= NUM_PORTS)) {
+        return;
+    }
+    struct alsa_port *ap = &ports[portnum];
+
+    pthread_mutex_lock(&ap->rx_lock);
+    ap->rx_func = NULL;
+    pthread_mutex_unlock(&ap->rx_lock);
+
+    pthread_mutex_lock(&ap->tx_lock);
+    ap->tx_func = NULL;
+    pthread_mutex_unlock(&ap->tx_lock);
+}
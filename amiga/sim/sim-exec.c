@@ -0,0 +1,796 @@
+/*
+ * sim-exec.c - exec.library on top of POSIX threads
+ *
+ * Tasks are threads. Each task has a pipe that wakes it up when signals
+ * arrive, so waiting for signals and file descriptors can be combined
+ * in WaitSelect().
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <proto/exec.h>
+#include <clib/alib_protos.h>
+#include <clib/debug_protos.h>
+#include <dos/dos.h>
+#include <devices/timer.h>
+
+#include "sim.h"
+
+struct sim_task {
+    struct Task         task;
+    pthread_t           thread;
+    int                 wake_fd[2];
+    ULONG               sig_recvd;
+    void                (*entry)(void);
+};
+
+static pthread_mutex_t global_lock;
+static pthread_once_t global_once = PTHREAD_ONCE_INIT;
+static __thread struct sim_task *cur_task;
+
+static struct ExecBase exec_base;
+
+static void global_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&global_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void sim_lock(void)
+{
+    pthread_once(&global_once, global_init);
+    pthread_mutex_lock(&global_lock);
+}
+
+void sim_unlock(void)
+{
+    pthread_mutex_unlock(&global_lock);
+}
+
+void Forbid(void)
+{
+    sim_lock();
+}
+
+void Permit(void)
+{
+    sim_unlock();
+}
+
+struct ExecBase *sim_exec_base(void)
+{
+    return &exec_base;
+}
+
+/* tools expect the startup code to set SysBase. a driver linked into the
+   same binary brings its own definition */
+__attribute__((weak)) struct ExecBase *SysBase;
+
+/* unchanged Amiga tools neither set SysBase nor call sim_break_init() */
+__attribute__((constructor)) static void init_sysbase(void)
+{
+    SysBase = &exec_base;
+    NewList(&exec_base.PortList);
+    sim_break_init(FindTask(NULL));
+}
+
+/* ----- tasks ----- */
+
+static struct sim_task *alloc_task(CONST_STRPTR name)
+{
+    struct sim_task *st = calloc(1, sizeof(struct sim_task));
+    if(st == NULL) {
+        return NULL;
+    }
+    if(pipe(st->wake_fd) != 0) {
+        free(st);
+        return NULL;
+    }
+    fcntl(st->wake_fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(st->wake_fd[1], F_SETFL, O_NONBLOCK);
+
+    st->task.tc_Node.ln_Type = NT_TASK;
+    st->task.tc_Node.ln_Name = (char *)name;
+    /* lower 16 signals are reserved by the system */
+    st->task.tc_SigAlloc = 0xffff;
+    st->task.tc_SimData = st;
+    return st;
+}
+
+static void free_task(struct sim_task *st)
+{
+    close(st->wake_fd[0]);
+    close(st->wake_fd[1]);
+    free(st);
+}
+
+struct Task *FindTask(CONST_STRPTR name)
+{
+    if(name != NULL) {
+        return NULL;
+    }
+    /* threads not created by CreateTask() become tasks on first use */
+    if(cur_task == NULL) {
+        cur_task = alloc_task("main");
+        if(cur_task != NULL) {
+            cur_task->thread = pthread_self();
+        }
+    }
+    return &cur_task->task;
+}
+
+/* only recorded: host threads keep their scheduling */
+BYTE SetTaskPri(struct Task *task, LONG priority)
+{
+    BYTE old = task->tc_Node.ln_Pri;
+    task->tc_Node.ln_Pri = (BYTE)priority;
+    return old;
+}
+
+static void *task_entry(void *data)
+{
+    struct sim_task *st = (struct sim_task *)data;
+    cur_task = st;
+    st->entry();
+    /* the task ends when its code returns */
+    cur_task = NULL;
+    free_task(st);
+    return NULL;
+}
+
+struct Task *CreateTask(CONST_STRPTR name, LONG pri, APTR initPC, ULONG stackSize)
+{
+    struct sim_task *st = alloc_task(name);
+    if(st == NULL) {
+        return NULL;
+    }
+    st->task.tc_Node.ln_Pri = (BYTE)pri;
+    st->entry = (void (*)(void))initPC;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int res = pthread_create(&st->thread, &attr, task_entry, st);
+    pthread_attr_destroy(&attr);
+    if(res != 0) {
+        free_task(st);
+        return NULL;
+    }
+    return &st->task;
+}
+
+void DeleteTask(struct Task *task)
+{
+    /* tasks end by returning from their code */
+}
+
+/* ----- signals ----- */
+
+BYTE AllocSignal(LONG signalNum)
+{
+    struct Task *task = FindTask(NULL);
+    BYTE result = -1;
+
+    sim_lock();
+    if(signalNum == -1) {
+        for(int i=31;i>=0;i--) {
+            if((task->tc_SigAlloc & (1UL << i)) == 0) {
+                result = i;
+                break;
+            }
+        }
+    } else if((signalNum >= 0) && (signalNum < 32)) {
+        if((task->tc_SigAlloc & (1UL << signalNum)) == 0) {
+            result = signalNum;
+        }
+    }
+    if(result != -1) {
+        struct sim_task *st = (struct sim_task *)task->tc_SimData;
+        task->tc_SigAlloc |= 1UL << result;
+        st->sig_recvd &= ~(1UL << result);
+    }
+    sim_unlock();
+    return result;
+}
+
+void FreeSignal(LONG signalNum)
+{
+    if((signalNum < 0) || (signalNum >= 32)) {
+        return;
+    }
+    struct Task *task = FindTask(NULL);
+    sim_lock();
+    task->tc_SigAlloc &= ~(1UL << signalNum);
+    sim_unlock();
+}
+
+void Signal(struct Task *task, ULONG signalSet)
+{
+    if(task == NULL) {
+        return;
+    }
+    struct sim_task *st = (struct sim_task *)task->tc_SimData;
+
+    sim_lock();
+    st->sig_recvd |= signalSet;
+    sim_unlock();
+
+    /* a full pipe already wakes the task */
+    char c = 0;
+    if(write(st->wake_fd[1], &c, 1) < 0) {
+        /* ignore */
+    }
+}
+
+ULONG SetSignal(ULONG newSignals, ULONG signalSet)
+{
+    struct Task *task = FindTask(NULL);
+    struct sim_task *st = (struct sim_task *)task->tc_SimData;
+
+    sim_lock();
+    ULONG old = st->sig_recvd;
+    st->sig_recvd = (old & ~signalSet) | (newSignals & signalSet);
+    sim_unlock();
+    return old;
+}
+
+static ULONG take_signals(struct sim_task *st, ULONG mask)
+{
+    sim_lock();
+    ULONG got = st->sig_recvd & mask;
+    st->sig_recvd &= ~got;
+    sim_unlock();
+    return got;
+}
+
+static void drain_wake(struct sim_task *st)
+{
+    char buf[64];
+    while(read(st->wake_fd[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+int sim_wait_fds(struct pollfd *fds, int num_fds, int timeout_ms, ULONG *mask)
+{
+    struct Task *task = FindTask(NULL);
+    struct sim_task *st = (struct sim_task *)task->tc_SimData;
+    struct pollfd all_fds[num_fds + 1];
+    ULONG want = *mask;
+    ULONG got = 0;
+
+    for(int i=0;i<num_fds;i++) {
+        all_fds[i] = fds[i];
+    }
+    all_fds[num_fds].fd = st->wake_fd[0];
+    all_fds[num_fds].events = POLLIN;
+
+    struct timespec now, end;
+    if(timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        end.tv_sec += timeout_ms / 1000;
+        end.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if(end.tv_nsec >= 1000000000L) {
+            end.tv_sec++;
+            end.tv_nsec -= 1000000000L;
+        }
+    }
+
+    while(1) {
+        int wait_ms = timeout_ms;
+        if(timeout_ms >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long left = (end.tv_sec - now.tv_sec) * 1000LL
+                           + (end.tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+            wait_ms = (left > 0) ? (int)left : 0;
+        }
+        got |= take_signals(st, want);
+        /* only poll the fds if signals are already there */
+        int n = poll(all_fds, num_fds + 1, (got != 0) ? 0 : wait_ms);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            *mask = got;
+            return -1;
+        }
+        if(all_fds[num_fds].revents != 0) {
+            drain_wake(st);
+            got |= take_signals(st, want);
+            n--;
+        }
+        if((n > 0) || (got != 0) || ((timeout_ms >= 0) && (wait_ms == 0))) {
+            for(int i=0;i<num_fds;i++) {
+                fds[i].revents = all_fds[i].revents;
+            }
+            *mask = got;
+            return n;
+        }
+    }
+}
+
+ULONG Wait(ULONG signalSet)
+{
+    ULONG mask = signalSet;
+    while(1) {
+        sim_wait_fds(NULL, 0, -1, &mask);
+        if(mask != 0) {
+            return mask;
+        }
+        mask = signalSet;
+    }
+}
+
+/* ----- host SIGINT ----- */
+
+static struct Task *break_task;
+static volatile sig_atomic_t break_pending;
+static pthread_t break_thread;
+
+static void break_handler(int sig)
+{
+    break_pending = 1;
+}
+
+/* forwards the break from a thread as Signal() is not async signal safe */
+static void *break_entry(void *data)
+{
+    while(1) {
+        if(break_pending) {
+            break_pending = 0;
+            Signal(break_task, SIGBREAKF_CTRL_C);
+        }
+        usleep(10000);
+    }
+    return NULL;
+}
+
+void sim_break_init(struct Task *task)
+{
+    BOOL first = (break_task == NULL);
+    break_task = task;
+    if(!first) {
+        return;
+    }
+    signal(SIGINT, break_handler);
+    pthread_create(&break_thread, NULL, break_entry, NULL);
+    pthread_detach(break_thread);
+}
+
+/* ----- lists ----- */
+
+void NewList(struct List *list)
+{
+    list->lh_Head = (struct Node *)&list->lh_Tail;
+    list->lh_Tail = NULL;
+    list->lh_TailPred = (struct Node *)&list->lh_Head;
+}
+
+void AddHead(struct List *list, struct Node *node)
+{
+    node->ln_Succ = list->lh_Head;
+    node->ln_Pred = (struct Node *)&list->lh_Head;
+    list->lh_Head->ln_Pred = node;
+    list->lh_Head = node;
+}
+
+void AddTail(struct List *list, struct Node *node)
+{
+    node->ln_Succ = (struct Node *)&list->lh_Tail;
+    node->ln_Pred = list->lh_TailPred;
+    list->lh_TailPred->ln_Succ = node;
+    list->lh_TailPred = node;
+}
+
+/* the node is cleared to tell if it is still linked */
+void Remove(struct Node *node)
+{
+    node->ln_Pred->ln_Succ = node->ln_Succ;
+    node->ln_Succ->ln_Pred = node->ln_Pred;
+    node->ln_Succ = NULL;
+    node->ln_Pred = NULL;
+}
+
+struct Node *RemHead(struct List *list)
+{
+    struct Node *node = list->lh_Head;
+    if(node->ln_Succ == NULL) {
+        return NULL;
+    }
+    Remove(node);
+    return node;
+}
+
+struct Node *RemTail(struct List *list)
+{
+    struct Node *node = list->lh_TailPred;
+    if(node->ln_Pred == NULL) {
+        return NULL;
+    }
+    Remove(node);
+    return node;
+}
+
+/* ----- message ports ----- */
+
+struct MsgPort *CreateMsgPort(void)
+{
+    struct MsgPort *port = calloc(1, sizeof(struct MsgPort));
+    if(port == NULL) {
+        return NULL;
+    }
+    BYTE sig = AllocSignal(-1);
+    if(sig == -1) {
+        free(port);
+        return NULL;
+    }
+    port->mp_Node.ln_Type = NT_MSGPORT;
+    port->mp_Flags = PA_SIGNAL;
+    port->mp_SigBit = sig;
+    port->mp_SigTask = FindTask(NULL);
+    NewList(&port->mp_MsgList);
+    return port;
+}
+
+void DeleteMsgPort(struct MsgPort *port)
+{
+    if(port != NULL) {
+        FreeSignal(port->mp_SigBit);
+        free(port);
+    }
+}
+
+/* public ports are only visible inside of one host process */
+void AddPort(struct MsgPort *port)
+{
+    sim_lock();
+    port->mp_Node.ln_Type = NT_MSGPORT;
+    NewList(&port->mp_MsgList);
+    AddTail(&exec_base.PortList, &port->mp_Node);
+    sim_unlock();
+}
+
+void RemPort(struct MsgPort *port)
+{
+    sim_lock();
+    Remove(&port->mp_Node);
+    sim_unlock();
+}
+
+/* caller has to Forbid() */
+struct MsgPort *FindPort(CONST_STRPTR name)
+{
+    struct Node *node;
+    for(node = exec_base.PortList.lh_Head; node->ln_Succ != NULL; node = node->ln_Succ) {
+        if((node->ln_Name != NULL) && (strcmp(node->ln_Name, name) == 0)) {
+            return (struct MsgPort *)node;
+        }
+    }
+    return NULL;
+}
+
+struct MsgPort *CreatePort(CONST_STRPTR name, LONG pri)
+{
+    struct MsgPort *port = CreateMsgPort();
+    if(port != NULL) {
+        port->mp_Node.ln_Name = (char *)name;
+        port->mp_Node.ln_Pri = (BYTE)pri;
+        if(name != NULL) {
+            AddPort(port);
+        }
+    }
+    return port;
+}
+
+void DeletePort(struct MsgPort *port)
+{
+    if((port != NULL) && (port->mp_Node.ln_Name != NULL)) {
+        RemPort(port);
+    }
+    DeleteMsgPort(port);
+}
+
+void PutMsg(struct MsgPort *port, struct Message *message)
+{
+    sim_lock();
+    message->mn_Node.ln_Type = NT_MESSAGE;
+    AddTail(&port->mp_MsgList, &message->mn_Node);
+    sim_unlock();
+    Signal((struct Task *)port->mp_SigTask, 1UL << port->mp_SigBit);
+}
+
+struct Message *GetMsg(struct MsgPort *port)
+{
+    sim_lock();
+    struct Message *msg = (struct Message *)RemHead(&port->mp_MsgList);
+    sim_unlock();
+    return msg;
+}
+
+void ReplyMsg(struct Message *message)
+{
+    struct MsgPort *port = message->mn_ReplyPort;
+    sim_lock();
+    message->mn_Node.ln_Type = NT_REPLYMSG;
+    if(port != NULL) {
+        AddTail(&port->mp_MsgList, &message->mn_Node);
+    }
+    sim_unlock();
+    if(port != NULL) {
+        Signal((struct Task *)port->mp_SigTask, 1UL << port->mp_SigBit);
+    }
+}
+
+struct Message *WaitPort(struct MsgPort *port)
+{
+    while(1) {
+        sim_lock();
+        struct Node *head = port->mp_MsgList.lh_Head;
+        sim_unlock();
+        if(head->ln_Succ != NULL) {
+            return (struct Message *)head;
+        }
+        Wait(1UL << port->mp_SigBit);
+    }
+}
+
+/* ----- semaphores ----- */
+
+void InitSemaphore(struct SignalSemaphore *sigSem)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sigSem->ss_Mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    sigSem->ss_Link.ln_Type = NT_SIGNALSEM;
+}
+
+void ObtainSemaphore(struct SignalSemaphore *sigSem)
+{
+    pthread_mutex_lock(&sigSem->ss_Mutex);
+}
+
+ULONG AttemptSemaphore(struct SignalSemaphore *sigSem)
+{
+    return pthread_mutex_trylock(&sigSem->ss_Mutex) == 0;
+}
+
+void ReleaseSemaphore(struct SignalSemaphore *sigSem)
+{
+    pthread_mutex_unlock(&sigSem->ss_Mutex);
+}
+
+/* ----- memory ----- */
+
+APTR AllocVec(ULONG byteSize, ULONG requirements)
+{
+    if(requirements & MEMF_CLEAR) {
+        return calloc(1, byteSize);
+    } else {
+        return malloc(byteSize);
+    }
+}
+
+void FreeVec(APTR memoryBlock)
+{
+    free(memoryBlock);
+}
+
+APTR AllocMem(ULONG byteSize, ULONG requirements)
+{
+    return AllocVec(byteSize, requirements);
+}
+
+void FreeMem(APTR memoryBlock, ULONG byteSize)
+{
+    free(memoryBlock);
+}
+
+void CopyMem(const void *source, APTR dest, ULONG size)
+{
+    memmove(dest, source, size);
+}
+
+/* on the host the data stream is the va_list of the caller: the only
+   user passes the va_list of its own varargs function */
+APTR RawDoFmt(CONST_STRPTR formatString, APTR dataStream, void (*putChProc)(char, APTR), APTR putChData)
+{
+    char host_fmt[256];
+    char buf[1024];
+
+    va_list ap;
+    va_copy(ap, *(va_list *)dataStream);
+    vsnprintf(buf, sizeof(buf), sim_host_format(formatString, host_fmt, sizeof(host_fmt)), ap);
+    va_end(ap);
+
+    /* like on the Amiga the terminating zero is also emitted */
+    char *ptr = buf;
+    do {
+        putChProc(*ptr, putChData);
+    } while(*ptr++ != '\0');
+    return dataStream;
+}
+
+/* ----- libraries ----- */
+
+static const char *lib_names[] = {
+    "dos.library",
+    "utility.library",
+    "bsdsocket.library",
+    "camd.library",
+    NULL
+};
+static struct Library libs[sizeof(lib_names) / sizeof(lib_names[0])];
+
+struct Library *OpenLibrary(CONST_STRPTR libName, ULONG version)
+{
+    for(int i=0;lib_names[i]!=NULL;i++) {
+        if(strcmp(lib_names[i], libName) == 0) {
+            struct Library *lib = &libs[i];
+            lib->lib_Node.ln_Type = NT_LIBRARY;
+            lib->lib_Node.ln_Name = (char *)lib_names[i];
+            lib->lib_Version = 40;
+            lib->lib_OpenCnt++;
+            return lib;
+        }
+    }
+    return NULL;
+}
+
+void CloseLibrary(struct Library *library)
+{
+    if(library != NULL) {
+        library->lib_OpenCnt--;
+    }
+}
+
+/* ----- devices ----- */
+
+static struct Device timer_device;
+
+struct IORequest *CreateExtIO(struct MsgPort *port, LONG ioSize)
+{
+    if(port == NULL) {
+        return NULL;
+    }
+    struct IORequest *req = calloc(1, ioSize);
+    if(req == NULL) {
+        return NULL;
+    }
+    /* an unused request counts as done for WaitIO() */
+    req->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+    req->io_Message.mn_ReplyPort = port;
+    req->io_Message.mn_Length = (UWORD)ioSize;
+    return req;
+}
+
+void DeleteExtIO(struct IORequest *ioReq)
+{
+    free(ioReq);
+}
+
+BYTE OpenDevice(CONST_STRPTR devName, ULONG unit, struct IORequest *ioRequest, ULONG flags)
+{
+    if(strcmp(devName, TIMERNAME) == 0) {
+        timer_device.dd_Library.lib_Node.ln_Type = NT_DEVICE;
+        timer_device.dd_Library.lib_Node.ln_Name = TIMERNAME;
+        ioRequest->io_Device = &timer_device;
+        ioRequest->io_Unit = (struct Unit *)(IPTR)unit;
+        ioRequest->io_Error = 0;
+        return 0;
+    }
+    ioRequest->io_Error = IOERR_OPENFAIL;
+    return IOERR_OPENFAIL;
+}
+
+void CloseDevice(struct IORequest *ioRequest)
+{
+    ioRequest->io_Device = NULL;
+}
+
+void SendIO(struct IORequest *ioRequest)
+{
+    ioRequest->io_Flags &= ~IOF_QUICK;
+    ioRequest->io_Error = 0;
+    ioRequest->io_Message.mn_Node.ln_Type = NT_MESSAGE;
+    if(ioRequest->io_Device == &timer_device) {
+        sim_timer_begin_io(ioRequest);
+    } else {
+        ioRequest->io_Error = IOERR_NOCMD;
+        ReplyMsg(&ioRequest->io_Message);
+    }
+}
+
+struct IORequest *CheckIO(struct IORequest *ioRequest)
+{
+    sim_lock();
+    BOOL done = ioRequest->io_Message.mn_Node.ln_Type == NT_REPLYMSG;
+    sim_unlock();
+    return done ? ioRequest : NULL;
+}
+
+BYTE WaitIO(struct IORequest *ioRequest)
+{
+    struct MsgPort *port = ioRequest->io_Message.mn_ReplyPort;
+    while(1) {
+        sim_lock();
+        if(ioRequest->io_Message.mn_Node.ln_Type == NT_REPLYMSG) {
+            /* remove from reply port if still queued there */
+            if(ioRequest->io_Message.mn_Node.ln_Succ != NULL) {
+                Remove(&ioRequest->io_Message.mn_Node);
+            }
+            sim_unlock();
+            return ioRequest->io_Error;
+        }
+        sim_unlock();
+        Wait(1UL << port->mp_SigBit);
+    }
+}
+
+BYTE DoIO(struct IORequest *ioRequest)
+{
+    SendIO(ioRequest);
+    return WaitIO(ioRequest);
+}
+
+void AbortIO(struct IORequest *ioRequest)
+{
+    if(ioRequest->io_Device == &timer_device) {
+        sim_timer_abort_io(ioRequest);
+    }
+}
+
+/* ----- debug ----- */
+
+/* Amiga formats use %l for 32 bit values. all args are passed in full
+   machine words on the supported hosts, so it is simply dropped. */
+const char *sim_host_format(const char *fmt, char *buf, int buf_size)
+{
+    int pos = 0;
+    BOOL in_fmt = FALSE;
+
+    while((*fmt != '\0') && (pos < buf_size - 1)) {
+        char c = *fmt++;
+        if(c == '%') {
+            in_fmt = !in_fmt;
+        } else if(in_fmt) {
+            if(c == 'l') {
+                continue;
+            }
+            if((c != '-') && (c != '.') && ((c < '0') || (c > '9'))) {
+                in_fmt = FALSE;
+            }
+        }
+        buf[pos++] = c;
+    }
+    buf[pos] = '\0';
+    return buf;
+}
+
+void KPrintF(const char *fmt, ...)
+{
+    char host_fmt[256];
+
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, sim_host_format(fmt, host_fmt, sizeof(host_fmt)), ap);
+    va_end(ap);
+}
+
+void KPutCh(int ch)
+{
+    fputc(ch, stderr);
+}
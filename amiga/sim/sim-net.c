@@ -0,0 +1,94 @@
+/*
+ * sim-net.c - bsdsocket.library calls missing in the host socket API
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <proto/exec.h>
+#include <proto/bsdsocket.h>
+
+#include "sim.h"
+
+LONG WaitSelect(LONG nfds, fd_set *readfds, fd_set *writefds, fd_set *exeptfds,
+                struct timeval *timeout, ULONG *maskp)
+{
+    struct pollfd fds[nfds > 0 ? nfds : 1];
+    int num = 0;
+
+    for(int fd=0;fd<nfds;fd++) {
+        short events = 0;
+        if((readfds != NULL) && FD_ISSET(fd, readfds)) {
+            events |= POLLIN;
+        }
+        if((writefds != NULL) && FD_ISSET(fd, writefds)) {
+            events |= POLLOUT;
+        }
+        if((exeptfds != NULL) && FD_ISSET(fd, exeptfds)) {
+            events |= POLLPRI;
+        }
+        if(events != 0) {
+            fds[num].fd = fd;
+            fds[num].events = events;
+            fds[num].revents = 0;
+            num++;
+        }
+    }
+
+    int timeout_ms = -1;
+    if(timeout != NULL) {
+        timeout_ms = timeout->tv_secs * 1000 + (timeout->tv_micro + 999) / 1000;
+    }
+
+    ULONG mask = (maskp != NULL) ? *maskp : 0;
+    int res = sim_wait_fds(fds, num, timeout_ms, &mask);
+    if(maskp != NULL) {
+        *maskp = mask;
+    }
+    if(res < 0) {
+        return -1;
+    }
+
+    /* report ready fds like select() */
+    if(readfds != NULL) {
+        FD_ZERO(readfds);
+    }
+    if(writefds != NULL) {
+        FD_ZERO(writefds);
+    }
+    if(exeptfds != NULL) {
+        FD_ZERO(exeptfds);
+    }
+    int ready = 0;
+    for(int i=0;i<num;i++) {
+        short rev = fds[i].revents;
+        if(rev == 0) {
+            continue;
+        }
+        if((readfds != NULL) && (rev & (POLLIN | POLLHUP | POLLERR))) {
+            FD_SET(fds[i].fd, readfds);
+            ready++;
+        }
+        if((writefds != NULL) && (rev & POLLOUT)) {
+            FD_SET(fds[i].fd, writefds);
+            ready++;
+        }
+        if((exeptfds != NULL) && (rev & POLLPRI)) {
+            FD_SET(fds[i].fd, exeptfds);
+            ready++;
+        }
+    }
+    return ready;
+}
+
+LONG CloseSocket(LONG sock)
+{
+    return close(sock);
+}
+
+LONG Errno(void)
+{
+    return errno;
+}
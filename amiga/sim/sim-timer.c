@@ -0,0 +1,231 @@
+/*
+ * sim-timer.c - timer.device with a single timer thread
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <proto/exec.h>
+#include <proto/timer.h>
+
+#include "sim.h"
+
+/* the E-clock of a PAL Amiga */
+#define ECLOCK_FREQ     709379
+
+struct timer_entry {
+    struct timer_entry *next;
+    struct timerequest *req;
+    struct timespec     when;
+};
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static pthread_t timer_thread;
+static struct timer_entry *timer_list;
+
+static BOOL before(struct timespec *a, struct timespec *b)
+{
+    if(a->tv_sec != b->tv_sec) {
+        return a->tv_sec < b->tv_sec;
+    }
+    return a->tv_nsec < b->tv_nsec;
+}
+
+static void *timer_entry_func(void *data)
+{
+    pthread_mutex_lock(&timer_lock);
+    while(1) {
+        struct timer_entry *e = timer_list;
+        if(e == NULL) {
+            pthread_cond_wait(&timer_cond, &timer_lock);
+            continue;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(before(&now, &e->when)) {
+            pthread_cond_timedwait(&timer_cond, &timer_lock, &e->when);
+            continue;
+        }
+
+        /* expired: reply outside of the lock */
+        timer_list = e->next;
+        pthread_mutex_unlock(&timer_lock);
+        ReplyMsg(&e->req->tr_node.io_Message);
+        free(e);
+        pthread_mutex_lock(&timer_lock);
+    }
+    return NULL;
+}
+
+static void timer_init(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_create(&timer_thread, NULL, timer_entry_func, NULL);
+    pthread_detach(timer_thread);
+}
+
+static void add_timer(struct timerequest *req, struct timespec *when)
+{
+    struct timer_entry *e = malloc(sizeof(struct timer_entry));
+    if(e == NULL) {
+        req->tr_node.io_Error = IOERR_ABORTED;
+        ReplyMsg(&req->tr_node.io_Message);
+        return;
+    }
+    e->req = req;
+    e->when = *when;
+
+    /* keep the list sorted by expiry */
+    pthread_mutex_lock(&timer_lock);
+    struct timer_entry **ptr = &timer_list;
+    while((*ptr != NULL) && !before(when, &(*ptr)->when)) {
+        ptr = &(*ptr)->next;
+    }
+    e->next = *ptr;
+    *ptr = e;
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_lock);
+}
+
+void sim_timer_begin_io(struct IORequest *ioReq)
+{
+    struct timerequest *req = (struct timerequest *)ioReq;
+    ULONG unit = (ULONG)(IPTR)ioReq->io_Unit;
+
+    pthread_once(&timer_once, timer_init);
+
+    switch(ioReq->io_Command) {
+        case TR_ADDREQUEST:
+            {
+                struct timespec when;
+                clock_gettime(CLOCK_MONOTONIC, &when);
+                if(unit == UNIT_WAITUNTIL) {
+                    /* absolute system time: convert to a delay */
+                    struct timeval now;
+                    GetSysTime(&now);
+                    long long delta = ((long long)req->tr_time.tv_secs - now.tv_secs) * 1000000LL
+                                    + ((long long)req->tr_time.tv_micro - now.tv_micro);
+                    if(delta < 0) {
+                        delta = 0;
+                    }
+                    when.tv_sec += delta / 1000000LL;
+                    when.tv_nsec += (delta % 1000000LL) * 1000L;
+                } else if(unit == UNIT_WAITECLOCK) {
+                    /* absolute E-clock value: ev_hi in tv_secs, ev_lo in tv_micro */
+                    struct EClockVal now;
+                    ReadEClock(&now);
+                    unsigned long long target = ((unsigned long long)req->tr_time.tv_secs << 32)
+                                              | req->tr_time.tv_micro;
+                    unsigned long long cur = ((unsigned long long)now.ev_hi << 32) | now.ev_lo;
+                    if(target > cur) {
+                        unsigned long long delta = target - cur;
+                        when.tv_sec += delta / ECLOCK_FREQ;
+                        when.tv_nsec += (delta % ECLOCK_FREQ) * 1000000000ULL / ECLOCK_FREQ;
+                    }
+                } else {
+                    when.tv_sec += req->tr_time.tv_secs;
+                    when.tv_nsec += (long)req->tr_time.tv_micro * 1000L;
+                }
+                while(when.tv_nsec >= 1000000000L) {
+                    when.tv_sec++;
+                    when.tv_nsec -= 1000000000L;
+                }
+                add_timer(req, &when);
+            }
+            break;
+        case TR_GETSYSTIME:
+            GetSysTime(&req->tr_time);
+            ReplyMsg(&ioReq->io_Message);
+            break;
+        default:
+            ioReq->io_Error = IOERR_NOCMD;
+            ReplyMsg(&ioReq->io_Message);
+            break;
+    }
+}
+
+void sim_timer_abort_io(struct IORequest *ioReq)
+{
+    struct timer_entry *found = NULL;
+
+    pthread_mutex_lock(&timer_lock);
+    struct timer_entry **ptr = &timer_list;
+    while(*ptr != NULL) {
+        if((*ptr)->req == (struct timerequest *)ioReq) {
+            found = *ptr;
+            *ptr = found->next;
+            break;
+        }
+        ptr = &(*ptr)->next;
+    }
+    pthread_mutex_unlock(&timer_lock);
+
+    /* not pending: already done */
+    if(found != NULL) {
+        ioReq->io_Error = IOERR_ABORTED;
+        ReplyMsg(&ioReq->io_Message);
+        free(found);
+    }
+}
+
+void GetSysTime(struct timeval *dest)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    dest->tv_secs = (ULONG)ts.tv_sec;
+    dest->tv_micro = (ULONG)(ts.tv_nsec / 1000);
+}
+
+ULONG ReadEClock(struct EClockVal *dest)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    unsigned long long ticks = (unsigned long long)ts.tv_sec * ECLOCK_FREQ
+                             + (unsigned long long)ts.tv_nsec * ECLOCK_FREQ / 1000000000ULL;
+    dest->ev_hi = (ULONG)(ticks >> 32);
+    dest->ev_lo = (ULONG)ticks;
+    return ECLOCK_FREQ;
+}
+
+void AddTime(struct timeval *dest, struct timeval *src)
+{
+    dest->tv_secs += src->tv_secs;
+    dest->tv_micro += src->tv_micro;
+    if(dest->tv_micro >= 1000000) {
+        dest->tv_micro -= 1000000;
+        dest->tv_secs++;
+    }
+}
+
+void SubTime(struct timeval *dest, struct timeval *src)
+{
+    if(dest->tv_micro < src->tv_micro) {
+        dest->tv_micro += 1000000;
+        dest->tv_secs--;
+    }
+    dest->tv_micro -= src->tv_micro;
+    dest->tv_secs -= src->tv_secs;
+}
+
+/* -1 if dest is later than src, 1 if earlier */
+LONG CmpTime(struct timeval *dest, struct timeval *src)
+{
+    if(dest->tv_secs != src->tv_secs) {
+        return (dest->tv_secs > src->tv_secs) ? -1 : 1;
+    }
+    if(dest->tv_micro != src->tv_micro) {
+        return (dest->tv_micro > src->tv_micro) ? -1 : 1;
+    }
+    return 0;
+}
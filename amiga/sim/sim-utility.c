@@ -0,0 +1,38 @@
+/*
+ * sim-utility.c - utility.library string functions
+ */
+
+#include <ctype.h>
+
+#include <proto/exec.h>
+#include <proto/utility.h>
+
+LONG Stricmp(CONST_STRPTR string1, CONST_STRPTR string2)
+{
+    return Strnicmp(string1, string2, 0x7fffffff);
+}
+
+LONG Strnicmp(CONST_STRPTR string1, CONST_STRPTR string2, LONG length)
+{
+    while(length-- > 0) {
+        UBYTE c1 = ToUpper((UBYTE)*string1++);
+        UBYTE c2 = ToUpper((UBYTE)*string2++);
+        if(c1 != c2) {
+            return (LONG)c1 - (LONG)c2;
+        }
+        if(c1 == '\0') {
+            break;
+        }
+    }
+    return 0;
+}
+
+UBYTE ToUpper(ULONG character)
+{
+    return (UBYTE)toupper((int)(character & 0xff));
+}
+
+UBYTE ToLower(ULONG character)
+{
+    return (UBYTE)tolower((int)(character & 0xff));
+}
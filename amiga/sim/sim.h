@@ -0,0 +1,43 @@
+#ifndef SIM_H
+#define SIM_H
+
+/* internal interface of the simulated Amiga host */
+
+#include <poll.h>
+
+#include <exec/types.h>
+
+/* the host side uses struct timespec. Amiga timevals use tv_secs */
+#undef tv_sec
+#undef tv_usec
+
+struct Task;
+struct IORequest;
+
+/* global lock for lists and signals. nests like Forbid() */
+extern void sim_lock(void);
+extern void sim_unlock(void);
+
+/* wait for exec signals in mask and poll the given fds at the same time.
+   timeout_ms < 0 waits forever. returns the number of ready fds or -1
+   and the signals received in mask. */
+extern int sim_wait_fds(struct pollfd *fds, int num_fds, int timeout_ms,
+                        ULONG *mask);
+
+/* turn SIGINT of the host into Ctrl-C of the given task */
+extern void sim_break_init(struct Task *task);
+
+/* host argument vector used by ReadArgs() without selected input */
+extern void sim_set_args(int argc, char **argv);
+
+/* map an Amiga path to a host path, e.g. ENV: to $SIM_ENV */
+extern const char *sim_host_path(const char *name, char *buf, int buf_size);
+
+/* convert an Amiga format string (%ld) to a host one */
+extern const char *sim_host_format(const char *fmt, char *buf, int buf_size);
+
+/* timer.device */
+extern void sim_timer_begin_io(struct IORequest *req);
+extern void sim_timer_abort_io(struct IORequest *req);
+
+#endif
@@ -5,15 +5,117 @@
 
 #include "cmd.h"
 
-static cmd_t *find_cmd(char *cmd_name, cmd_t *cmd_table)
+/* hash index of command names and long names for fast lookup.
+   it is built on first use of a command table. */
+#define HASH_SIZE   256
+#define HASH_MASK   (HASH_SIZE - 1)
+
+/* file parser config */
+static int   max_args = CMD_DEFAULT_MAX_ARGS;
+static ULONG line_buf_size = CMD_DEFAULT_LINE_BUF_SIZE;
+
+static cmd_t *hash_table;
+static cmd_t *hash_slots[HASH_SIZE];
+static BOOL   hash_ok;
+
+static ULONG hash_name(char *name)
 {
+    ULONG hash = 0;
+    while(*name != '\0') {
+        UBYTE c = *name++;
+        /* ignore case */
+        if((c >= 'A') && (c <= 'Z')) {
+            c += 'a' - 'A';
+        }
+        hash = hash * 31 + c;
+    }
+    return hash;
+}
+
+static BOOL hash_add(char *name, cmd_t *cmd)
+{
+    ULONG pos = hash_name(name);
+    for(int i=0;i<HASH_SIZE;i++) {
+        pos &= HASH_MASK;
+        if(hash_slots[pos] == NULL) {
+            hash_slots[pos] = cmd;
+            return TRUE;
+        }
+        pos++;
+    }
+    return FALSE;
+}
+
+static void hash_build(cmd_t *cmd_table)
+{
+    hash_table = cmd_table;
+    hash_ok = TRUE;
+
+    for(int i=0;i<HASH_SIZE;i++) {
+        hash_slots[i] = NULL;
+    }
+
+    /* keep the load factor at most 1/2 or fall back to a linear search */
+    int num = 0;
     cmd_t *cmd = cmd_table;
     while(cmd->name != NULL) {
-        int match = Stricmp(cmd->name, cmd_name) == 0;
-        if(!match && (cmd->long_name != NULL)) {
-            match = Stricmp(cmd->long_name, cmd_name) == 0;
+        num++;
+        if(cmd->long_name != NULL) {
+            num++;
         }
-        if(match) {
+        cmd++;
+    }
+    if(num > HASH_SIZE / 2) {
+        hash_ok = FALSE;
+        return;
+    }
+
+    cmd = cmd_table;
+    while(cmd->name != NULL) {
+        hash_add(cmd->name, cmd);
+        if(cmd->long_name != NULL) {
+            hash_add(cmd->long_name, cmd);
+        }
+        cmd++;
+    }
+}
+
+static BOOL match_cmd(cmd_t *cmd, char *cmd_name)
+{
+    int match = Stricmp(cmd->name, cmd_name) == 0;
+    if(!match && (cmd->long_name != NULL)) {
+        match = Stricmp(cmd->long_name, cmd_name) == 0;
+    }
+    return match;
+}
+
+static cmd_t *find_cmd(char *cmd_name, cmd_t *cmd_table)
+{
+    /* (re)build index for a new table */
+    if(hash_table != cmd_table) {
+        hash_build(cmd_table);
+    }
+
+    /* probe hash slots until an empty one is found */
+    if(hash_ok) {
+        ULONG pos = hash_name(cmd_name);
+        for(int i=0;i<HASH_SIZE;i++) {
+            pos &= HASH_MASK;
+            cmd_t *cmd = hash_slots[pos];
+            if(cmd == NULL) {
+                break;
+            }
+            if(match_cmd(cmd, cmd_name)) {
+                return cmd;
+            }
+            pos++;
+        }
+        return NULL;
+    }
+
+    cmd_t *cmd = cmd_table;
+    while(cmd->name != NULL) {
+        if(match_cmd(cmd, cmd_name)) {
             return cmd;
         }
         cmd++;
@@ -144,67 +246,158 @@ static int find_args_in_line(char **buf, char **args_buf, int max_args)
     return num_args;
 }
 
+/* read the next line from file into the buffer and return it terminated.
+   partial lines are moved to the buffer start and the buffer is refilled. */
+struct line_reader {
+    BPTR    fh;
+    char   *buf;
+    ULONG   buf_size;
+    ULONG   pos;
+    ULONG   len;
+    BOOL    eof;
+};
+
+#define LINE_OK         0
+#define LINE_EOF        1
+#define LINE_TOO_LONG   2
+#define LINE_IO_ERROR   3
+
+static int read_line(struct line_reader *lr, char **line)
+{
+    while(1) {
+        /* search end of line in buffered data */
+        char *ptr = lr->buf + lr->pos;
+        char *end = lr->buf + lr->len;
+        while(ptr < end) {
+            if(*ptr == '\n') {
+                *ptr = '\0';
+                *line = lr->buf + lr->pos;
+                lr->pos = ptr - lr->buf + 1;
+                return LINE_OK;
+            }
+            ptr++;
+        }
+
+        /* last line without newline */
+        if(lr->eof) {
+            if(lr->pos == lr->len) {
+                return LINE_EOF;
+            }
+            lr->buf[lr->len] = '\0';
+            *line = lr->buf + lr->pos;
+            lr->pos = lr->len;
+            return LINE_OK;
+        }
+
+        /* move partial line to front */
+        ULONG left = lr->len - lr->pos;
+        if(left == lr->buf_size) {
+            return LINE_TOO_LONG;
+        }
+        if((left > 0) && (lr->pos > 0)) {
+            CopyMem(lr->buf + lr->pos, lr->buf, left);
+        }
+        lr->pos = 0;
+        lr->len = left;
+
+        /* refill */
+        LONG got = Read(lr->fh, lr->buf + left, lr->buf_size - left);
+        if(got < 0) {
+            return LINE_IO_ERROR;
+        }
+        if(got == 0) {
+            lr->eof = TRUE;
+        }
+        lr->len += got;
+    }
+}
+
 int cmd_exec_file(char *file_name, cmd_t *cmd_table, handle_other_func_t func)
 {
-    BPTR fh = Open((STRPTR)file_name, MODE_OLDFILE);
-    if(fh == NULL) {
+    struct line_reader lr;
+
+    lr.fh = Open((STRPTR)file_name, MODE_OLDFILE);
+    if(lr.fh == NULL) {
         Printf("Error opening command file: %s\n", file_name);
         return 1;
     }
 
-    /* get size */
-    Seek(fh, 0, OFFSET_END);
-    LONG buf_len = Seek(fh, 0, OFFSET_BEGINNING);
-
-    /* alloc file buffer */
-    UBYTE *data = AllocVec(buf_len + 1, 0);
-    if(data == NULL) {
+    /* alloc line buffer (+1 for terminator of last line) */
+    lr.buf_size = line_buf_size;
+    lr.pos = 0;
+    lr.len = 0;
+    lr.eof = FALSE;
+    lr.buf = AllocVec(lr.buf_size + 1, 0);
+    if(lr.buf == NULL) {
         PutStr("Out of memory!\n");
-        Close(fh);
+        Close(lr.fh);
         return 2;
     }
 
     /* alloc arg buffer */
-    const int max_args = 256;
     char **args_buf = (char **)AllocVec(max_args * sizeof(char *), 0);
     if(args_buf == NULL) {
         PutStr("Out of memory!\n");
-        Close(fh);
+        FreeVec(lr.buf);
+        Close(lr.fh);
         return 3;
     }
 
-    /* read file */
+    /* parse loop: execute line by line while reading */
     int ret_code = 0;
-    LONG got_size = Read(fh, data, buf_len);
-    
-    /* parse loop */
-    if(got_size == buf_len) {
-        data[buf_len] = '\0';
-
-        char *ptr = data;
-        while(ptr != NULL) {
-            int num_args = find_args_in_line(&ptr, args_buf, max_args);
-            if(num_args > 0) {
-                char **result = cmd_exec_cmd_line(args_buf, cmd_table, func);
-                if(result != NULL) {
-                    Printf("Error parsing in file '%s': cmd=%s\n", file_name, *result);
-                    return 3;
-                }
-            } else if(num_args < 0) {
-                Printf("Error finding commands!\n");
-                ret_code = 5;
+    while(1) {
+        char *line;
+        int res = read_line(&lr, &line);
+        if(res == LINE_EOF) {
+            break;
+        }
+        else if(res == LINE_TOO_LONG) {
+            Printf("Line too long in file '%s'!\n", file_name);
+            ret_code = 6;
+            break;
+        }
+        else if(res == LINE_IO_ERROR) {
+            PrintFault(IoErr(), "ReadError");
+            ret_code = 4;
+            break;
+        }
+
+        int num_args = find_args_in_line(&line, args_buf, max_args);
+        if(num_args > 0) {
+            char **result = cmd_exec_cmd_line(args_buf, cmd_table, func);
+            if(result != NULL) {
+                Printf("Error parsing in file '%s': cmd=%s\n", file_name, *result);
+                ret_code = 3;
                 break;
             }
+        } else if(num_args < 0) {
+            Printf("Error finding commands!\n");
+            ret_code = 5;
+            break;
         }
-
-    } else {
-        PrintFault(IoErr(), "ReadError");
-        ret_code = 4;
     }
 
-    FreeVec(data);
+    FreeVec(lr.buf);
     FreeVec(args_buf);
 
-    Close(fh);
+    Close(lr.fh);
     return ret_code;
 }
+
+void cmd_set_max_args(int num)
+{
+    if(num < CMD_MIN_MAX_ARGS) {
+        Printf("MAXARGS too small. Using %ld\n", (LONG)CMD_MIN_MAX_ARGS);
+        num = CMD_MIN_MAX_ARGS;
+    }
+    max_args = num;
+}
+
+void cmd_set_line_buf_size(ULONG size)
+{
+    if(size < CMD_MIN_LINE_BUF_SIZE) {
+        Printf("LINEBUFSIZE too small. Using %ld\n", (LONG)CMD_MIN_LINE_BUF_SIZE);
+        size = CMD_MIN_LINE_BUF_SIZE;
+    }
+    line_buf_size = size;
+}
@@ -10,7 +10,17 @@ typedef struct {
 
 typedef char ** (*handle_other_func_t)(char **args);
 
+#define CMD_DEFAULT_MAX_ARGS        256
+#define CMD_DEFAULT_LINE_BUF_SIZE   4096
+/* smaller values are raised to these */
+#define CMD_MIN_MAX_ARGS            16
+#define CMD_MIN_LINE_BUF_SIZE       256
+
 extern char **cmd_exec_cmd_line(char **args, cmd_t *cmd_table, handle_other_func_t f);
 extern int cmd_exec_file(char *file_name, cmd_t *cmd_table, handle_other_func_t f);
 
+/* limits of command files: max args per line and max line size */
+extern void cmd_set_max_args(int num);
+extern void cmd_set_line_buf_size(ULONG size);
+
 #endif
\ No newline at end of file
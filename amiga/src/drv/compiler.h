@@ -2,6 +2,12 @@
 #define COMPILER_H
 
 /* compiler specific switches */
+#ifdef MIDI_HOST
+/* native build against the simulated host in amiga/sim */
+#define REG(r,t) t
+#define SAVEDS
+#define ASM
+#else
 #ifdef __VBCC__
 #define REG(r,t) __reg( #r ) t
 #define SAVEDS __saveds
@@ -16,5 +22,6 @@
 #error unsupported compiler
 #endif /* GNUC */
 #endif /* VBCC */
+#endif /* MIDI_HOST */
 
 #endif /* COMPILER_H */
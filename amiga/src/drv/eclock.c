@@ -0,0 +1,144 @@
+/*
+ * eclock.c - time stamps from the E-clock
+ */
+
+/* the users may have their own timer */
+#define TimerBase eclock_timer_base
+
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+
+#include "eclock.h"
+
+struct Library *eclock_timer_base;
+ULONG eclock_freq;
+
+static struct timerequest eclock_ior;
+static ULONG eclock_users;
+
+int eclock_init(void)
+{
+    struct EClockVal ev;
+
+    if(eclock_users == 0) {
+        /* only the device base is needed for ReadEClock() */
+        if(OpenDevice(TIMERNAME, UNIT_ECLOCK, (struct IORequest *)&eclock_ior, 0L) != 0) {
+            return 1;
+        }
+        eclock_timer_base = (struct Library *)eclock_ior.tr_node.io_Device;
+        eclock_freq = ReadEClock(&ev);
+    }
+    eclock_users++;
+    return 0;
+}
+
+void eclock_exit(void)
+{
+    if(eclock_users == 0) {
+        return;
+    }
+    eclock_users--;
+    if(eclock_users == 0) {
+        CloseDevice((struct IORequest *)&eclock_ior);
+        eclock_timer_base = NULL;
+    }
+}
+
+void eclock_read(struct EClockVal *ev)
+{
+    ReadEClock(ev);
+}
+
+ULONG eclock_stamp(void)
+{
+    struct EClockVal ev;
+    ReadEClock(&ev);
+    return ev.ev_lo;
+}
+
+void eclock_add(struct EClockVal *ev, ULONG ticks)
+{
+    ULONG lo = ev->ev_lo + ticks;
+    if(lo < ev->ev_lo) {
+        ev->ev_hi++;
+    }
+    ev->ev_lo = lo;
+}
+
+void eclock_sub(struct EClockVal *ev, ULONG ticks)
+{
+    if(ev->ev_lo < ticks) {
+        ev->ev_hi--;
+    }
+    ev->ev_lo -= ticks;
+}
+
+void eclock_diff(struct EClockVal *res, struct EClockVal *a, struct EClockVal *b)
+{
+    res->ev_hi = a->ev_hi - b->ev_hi;
+    if(a->ev_lo < b->ev_lo) {
+        res->ev_hi--;
+    }
+    res->ev_lo = a->ev_lo - b->ev_lo;
+}
+
+/* without overflowing 32 bits */
+ULONG eclock_ticks_to_us(ULONG ticks, ULONG freq)
+{
+    ULONG secs = ticks / freq;
+    ULONG rem = (ticks % freq) * 1000;
+    ULONG ms = rem / freq;
+    ULONG us = ((rem % freq) * 1000) / freq;
+    return secs * 1000000 + ms * 1000 + us;
+}
+
+ULONG eclock_to_us(ULONG ticks)
+{
+    return eclock_ticks_to_us(ticks, eclock_freq);
+}
+
+ULONG eclock_us_to_ticks(ULONG us)
+{
+    ULONG secs = us / 1000000;
+    ULONG rem = us % 1000000;
+    /* rem * freq would overflow: split into ms and us */
+    return secs * eclock_freq
+        + (rem / 1000) * eclock_freq / 1000
+        + ((rem % 1000) * (eclock_freq / 1000)) / 1000;
+}
+
+/* three divisions: the remainder is taken by a multiplication */
+void eclock_ticks_to_timeval(ULONG ticks, struct timeval *tv)
+{
+    ULONG secs = ticks / eclock_freq;
+    ULONG rem = (ticks - secs * eclock_freq) * 1000;
+    ULONG ms = rem / eclock_freq;
+    ULONG us = ((rem - ms * eclock_freq) * 1000) / eclock_freq;
+
+    tv->tv_secs = secs;
+    tv->tv_micro = ms * 1000 + us;
+}
+
+/* divide the 64 bit value by the frequency in 8 bit steps: the remainder
+   stays below the frequency, i.e. below 2^24 */
+void eclock_to_timeval(struct EClockVal *ev, struct timeval *tv)
+{
+    if(ev->ev_hi == 0) {
+        eclock_ticks_to_timeval(ev->ev_lo, tv);
+        return;
+    }
+
+    ULONG rem = 0;
+    ULONG secs = 0;
+
+    for(int i=7;i>=0;i--) {
+        ULONG word = (i >= 4) ? ev->ev_hi : ev->ev_lo;
+        rem = (rem << 8) | ((word >> ((i & 3) * 8)) & 0xff);
+        secs = (secs << 8) | (rem / eclock_freq);
+        rem %= eclock_freq;
+    }
+
+    tv->tv_secs = secs;
+    tv->tv_micro = eclock_to_us(rem);
+}
@@ -0,0 +1,43 @@
+#ifndef ECLOCK_H
+#define ECLOCK_H
+
+/*
+ * time stamps from the E-clock
+ *
+ * ReadEClock() is a plain library call without any I/O and counts at
+ * about 700 kHz. The frequency is read once at init. Keep stamps in ticks
+ * and convert them to us only where they are shown or sent.
+ *
+ * The 64 bit values are kept in a struct EClockVal as the compiler has no
+ * cheap 64 bit math on the 68k. The low 32 bits alone wrap after about
+ * 1.6 hours: enough for intervals.
+ */
+
+#include <devices/timer.h>
+
+/* ticks per second. valid after eclock_init() */
+extern ULONG eclock_freq;
+
+/* the first init opens timer.device. calls nest */
+extern int eclock_init(void);
+extern void eclock_exit(void);
+
+extern void eclock_read(struct EClockVal *ev);
+/* low 32 bits of the E-clock */
+extern ULONG eclock_stamp(void);
+
+/* 64 bit arithmetic */
+extern void eclock_add(struct EClockVal *ev, ULONG ticks);
+extern void eclock_sub(struct EClockVal *ev, ULONG ticks);
+/* res = a - b */
+extern void eclock_diff(struct EClockVal *res, struct EClockVal *a, struct EClockVal *b);
+
+/* conversion. ticks_to_us works without init, e.g. for stamps of a driver */
+extern ULONG eclock_ticks_to_us(ULONG ticks, ULONG freq);
+extern ULONG eclock_to_us(ULONG ticks);
+extern ULONG eclock_us_to_ticks(ULONG us);
+/* ticks below 2^32 take the short way */
+extern void eclock_ticks_to_timeval(ULONG ticks, struct timeval *tv);
+extern void eclock_to_timeval(struct EClockVal *ev, struct timeval *tv);
+
+#endif /* ECLOCK_H */
@@ -28,6 +28,11 @@ static struct MidiDeviceData my_dev = {
     .Flags = 1, // new style driver
 };
 
+#ifdef MIDI_HOST
+/* the simulated camd.library finds the driver by this symbol */
+struct MidiDeviceData *midi_drv_device = &my_dev;
+#endif
+
 extern struct ExecBase *SysBase;
 static struct MsgPort *port;
 
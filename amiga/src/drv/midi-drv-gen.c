@@ -0,0 +1,429 @@
+/*
+ * a CAMD midi driver for classic Amigas
+ *
+ * The gen driver synthesises reproducible MIDI traffic on its inputs to
+ * load test CAMD applications: clock, notes, controller sweeps and sysex
+ * blocks at configured rates. Notes, controllers and sysex carry a
+ * sequence number to detect losses on the receiving side.
+ */
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <clib/alib_protos.h>
+#include <devices/timer.h>
+#include <midi/camddevices.h>
+#include <midi/camd.h>
+#include <midi/mididefs.h>
+
+#include "debug.h"
+#include "compiler.h"
+#include "midi-msg.h"
+#include "midi-drv.h"
+
+/* midi driver structure */
+static struct MidiDeviceData my_dev = {
+    .Magic = MDD_Magic,
+    .Name = "gen",
+    .IDString = "Traffic generator driver",
+    .Version = 0,
+    .Revision = 1,
+    .Init = midi_drv_init,
+    .Expunge = midi_drv_expunge,
+    .OpenPort = midi_drv_open_port,
+    .ClosePort = midi_drv_close_port,
+    .NPorts = MIDI_DRV_NUM_PORTS,
+    .Flags = 1, // new style driver
+};
+
+#ifdef MIDI_HOST
+/* the simulated camd.library finds the driver by this symbol */
+struct MidiDeviceData *midi_drv_device = &my_dev;
+#endif
+
+extern struct ExecBase *SysBase;
+struct Library *TimerBase;
+static struct timerequest *ior_time;
+static ULONG timer_mask;
+static struct MsgPort *timer_port;
+
+// sysex manufacturer id for non-commercial use
+#define GEN_SYSEX_ID        0x7d
+// status, id, port, 4 bytes sequence and EOX
+#define GEN_SYSEX_MIN_LEN   8
+
+#define STREAM_CLOCK    0
+#define STREAM_NOTE     1
+#define STREAM_CC       2
+#define STREAM_SYSEX    3
+#define NUM_STREAMS     4
+
+/* a stream emits num/den events per second on each port of its mask */
+struct gen_stream {
+    ULONG   ports;
+    ULONG   num;
+    ULONG   den;
+    ULONG   acc;
+    ULONG   pending;
+    int     port;       // next port of the pending event
+    ULONG   seq;
+    ULONG   dropped;
+};
+
+// config
+static ULONG tick_ms = 5;
+static UBYTE channel;
+static UBYTE cc_num = 1;
+static ULONG sysex_len = 16;
+static struct gen_stream streams[NUM_STREAMS];
+
+// state
+static struct timeval next_tick;
+static struct timeval tick_time;
+static midi_drv_msg_t rx_msg;
+static UBYTE *sysex_buf;
+
+/* Config Driver */
+
+#define CONFIG_FILE "ENV:midi/gen.config"
+#define ARG_TEMPLATE \
+    "TICK/K/N,CHANNEL/K/N," \
+    "CLOCK_BPM/K/N,CLOCK_PORTS/K/N," \
+    "NOTE_RATE/K/N,NOTE_PORTS/K/N," \
+    "CC_RATE/K/N,CC_NUM/K/N,CC_PORTS/K/N," \
+    "SYSEX_RATE/K/N,SYSEX_LEN/K/N,SYSEX_PORTS/K/N," \
+    "SYSEX_SIZE/K/N"
+struct midi_drv_config_param {
+    ULONG *tick;
+    ULONG *channel;
+    ULONG *clock_bpm;
+    ULONG *clock_ports;
+    ULONG *note_rate;
+    ULONG *note_ports;
+    ULONG *cc_rate;
+    ULONG *cc_num;
+    ULONG *cc_ports;
+    ULONG *sysex_rate;
+    ULONG *sysex_len;
+    ULONG *sysex_ports;
+    ULONG *sysex_size;
+};
+
+static void set_stream(int stream, ULONG *rate, ULONG den, ULONG *ports)
+{
+    struct gen_stream *s = &streams[stream];
+    if(rate != NULL) {
+        s->num = *rate;
+        s->den = den;
+    }
+    if(ports != NULL) {
+        s->ports = *ports & ((1 << MIDI_DRV_NUM_PORTS) - 1);
+    }
+    D(("gen: stream %ld: rate=%ld/%ld ports=%02lx\n", stream, s->num, s->den, s->ports));
+}
+
+static int parse_args(struct midi_drv_config_param *param)
+{
+    if(param->tick != NULL) {
+        D(("set tick: %ld\n", *param->tick));
+        if(*param->tick > 0) {
+            tick_ms = *param->tick;
+        }
+    }
+    if(param->channel != NULL) {
+        D(("set channel: %ld\n", *param->channel));
+        if((*param->channel >= 1) && (*param->channel <= 16)) {
+            channel = (UBYTE)(*param->channel - 1);
+        }
+    }
+    if(param->cc_num != NULL) {
+        D(("set cc num: %ld\n", *param->cc_num));
+        cc_num = (UBYTE)(*param->cc_num & 0x7f);
+    }
+    if(param->sysex_len != NULL) {
+        D(("set sysex len: %ld\n", *param->sysex_len));
+        sysex_len = *param->sysex_len;
+    }
+    if(param->sysex_size != NULL) {
+        D(("set sysex size: %ld\n", *param->sysex_size));
+        midi_drv_sysex_max_size = *param->sysex_size;
+    }
+    // 24 clocks per quarter note
+    set_stream(STREAM_CLOCK, param->clock_bpm, 60, param->clock_ports);
+    streams[STREAM_CLOCK].num *= 24;
+    set_stream(STREAM_NOTE, param->note_rate, 1, param->note_ports);
+    set_stream(STREAM_CC, param->cc_rate, 1, param->cc_ports);
+    set_stream(STREAM_SYSEX, param->sysex_rate, 1, param->sysex_ports);
+    return MIDI_DRV_RET_OK;
+}
+
+STRPTR midi_drv_api_config(void)
+{
+    struct midi_drv_config_param param = {
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, NULL, NULL
+    };
+    for(int i=0;i<NUM_STREAMS;i++) {
+        streams[i].ports = 1;
+        streams[i].den = 1;
+    }
+    midi_drv_config(CONFIG_FILE, ARG_TEMPLATE, &param, parse_args);
+    return "midi.gen";
+}
+
+/* TX */
+
+void midi_drv_api_tx_msg(midi_drv_msg_t *msg)
+{
+    // outputs discard all data
+}
+
+/* Streams */
+
+static void timer_set_next(void)
+{
+    AddTime(&next_tick, &tick_time);
+
+    ior_time->tr_node.io_Command = TR_ADDREQUEST;
+    ior_time->tr_time = next_tick;
+
+    SendIO((struct IORequest *)ior_time);
+}
+
+static void handle_tick(void)
+{
+    for(int i=0;i<NUM_STREAMS;i++) {
+        struct gen_stream *s = &streams[i];
+        if((s->num == 0) || (s->ports == 0)) {
+            continue;
+        }
+
+        // the application did not absorb the last tick
+        if(s->pending > 0) {
+            s->dropped += s->pending;
+            s->seq += s->pending;
+        }
+
+        // events due in this tick
+        s->acc += s->num * tick_ms;
+        s->pending = s->acc / (s->den * 1000);
+        s->acc %= s->den * 1000;
+        s->port = 0;
+    }
+
+    timer_set_next();
+}
+
+static void make_msg(int stream, struct gen_stream *s, int port)
+{
+    ULONG seq = s->seq;
+    midi_msg_t *msg = &rx_msg.midi_msg;
+
+    rx_msg.port = port;
+    rx_msg.sysex_data = NULL;
+    rx_msg.sysex_size = 0;
+    msg->b[MIDI_MSG_SIZE] = 3;
+
+    switch(stream) {
+        case STREAM_CLOCK:
+            msg->b[MIDI_MSG_STATUS] = MS_Clock;
+            msg->b[MIDI_MSG_DATA1] = 0;
+            msg->b[MIDI_MSG_DATA2] = 0;
+            msg->b[MIDI_MSG_SIZE] = 1;
+            break;
+        case STREAM_NOTE:
+            // even: note on tagged with the sequence, odd: its note off
+            msg->b[MIDI_MSG_STATUS] = ((seq & 1) ? MS_NoteOff : MS_NoteOn) | channel;
+            msg->b[MIDI_MSG_DATA1] = (UBYTE)((seq >> 1) & 0x7f);
+            msg->b[MIDI_MSG_DATA2] = (UBYTE)(((seq >> 8) % 127) + 1);
+            break;
+        case STREAM_CC:
+            // saw tooth sweep
+            msg->b[MIDI_MSG_STATUS] = MS_Ctrl | channel;
+            msg->b[MIDI_MSG_DATA1] = cc_num;
+            msg->b[MIDI_MSG_DATA2] = (UBYTE)(seq & 0x7f);
+            break;
+        case STREAM_SYSEX:
+            msg->b[MIDI_MSG_STATUS] = MS_SysEx;
+            msg->b[MIDI_MSG_DATA1] = 0;
+            msg->b[MIDI_MSG_DATA2] = 0;
+            msg->b[MIDI_MSG_SIZE] = 0;
+            sysex_buf[2] = (UBYTE)port;
+            sysex_buf[3] = (UBYTE)((seq >> 21) & 0x7f);
+            sysex_buf[4] = (UBYTE)((seq >> 14) & 0x7f);
+            sysex_buf[5] = (UBYTE)((seq >> 7) & 0x7f);
+            sysex_buf[6] = (UBYTE)(seq & 0x7f);
+            rx_msg.sysex_data = sysex_buf;
+            rx_msg.sysex_size = sysex_len;
+            break;
+    }
+}
+
+/* next pending event. the clock goes first to keep its timing */
+static midi_drv_msg_t *next_rx_msg(void)
+{
+    for(int i=0;i<NUM_STREAMS;i++) {
+        struct gen_stream *s = &streams[i];
+        if(s->pending == 0) {
+            continue;
+        }
+
+        // emit the event on each port of the stream
+        while((s->ports & (1 << s->port)) == 0) {
+            s->port++;
+        }
+        make_msg(i, s, s->port);
+
+        s->port++;
+        if((s->ports >> s->port) == 0) {
+            s->port = 0;
+            s->pending--;
+            s->seq++;
+        }
+        return &rx_msg;
+    }
+    return NULL;
+}
+
+static BOOL is_pending(void)
+{
+    for(int i=0;i<NUM_STREAMS;i++) {
+        if(streams[i].pending > 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+int midi_drv_api_rx_msg(midi_drv_msg_t **msg, ULONG *got_mask)
+{
+    ULONG start_mask = *got_mask;
+    ULONG wait_mask = start_mask | timer_mask;
+    ULONG my_mask;
+
+    // events are pending: only poll the signals
+    if(is_pending()) {
+        my_mask = SetSignal(0, wait_mask) & wait_mask;
+    } else {
+        my_mask = Wait(wait_mask);
+    }
+
+    if((my_mask & timer_mask) != 0) {
+        GetMsg(timer_port);
+        handle_tick();
+    }
+    *msg = next_rx_msg();
+
+    *got_mask = my_mask & start_mask;
+    return MIDI_DRV_RET_OK;
+}
+
+void midi_drv_api_rx_msg_done(midi_drv_msg_t *msg)
+{
+    // nothing to do
+}
+
+/* Setup */
+
+static int timer_init(void)
+{
+    struct MsgPort *port;
+    LONG error;
+
+    port = CreatePort(NULL, 0);
+    if(port == NULL) {
+        return 1;
+    }
+
+    ior_time = (struct timerequest *)CreateExtIO(port, sizeof(struct timerequest));
+    if(ior_time == NULL) {
+        DeletePort(port);
+        return 2;
+    }
+
+    // absolute wake up times do not drift
+    error = OpenDevice(TIMERNAME, UNIT_WAITUNTIL, (struct IORequest *)ior_time, 0L);
+    if(error != 0) {
+        DeleteExtIO((struct IORequest *)ior_time);
+        DeletePort(port);
+        return 3;
+    }
+
+    TimerBase = (struct Library *)ior_time->tr_node.io_Device;
+    timer_mask = 1 << port->mp_SigBit;
+    timer_port = port;
+    return 0;
+}
+
+static void timer_exit(void)
+{
+    struct MsgPort *port;
+
+    if(ior_time == NULL) {
+        return;
+    }
+
+    port = timer_port;
+
+    AbortIO((struct IORequest *)ior_time);
+    WaitIO((struct IORequest *)ior_time);
+
+    CloseDevice((struct IORequest *)ior_time);
+    DeleteExtIO((struct IORequest *)ior_time);
+    DeletePort(port);
+
+    TimerBase = NULL;
+    timer_port = NULL;
+    timer_mask = 0;
+    ior_time = NULL;
+}
+
+int midi_drv_api_init(struct ExecBase *SysBase)
+{
+    if(sysex_len < GEN_SYSEX_MIN_LEN) {
+        sysex_len = GEN_SYSEX_MIN_LEN;
+    }
+    if(streams[STREAM_SYSEX].num > 0) {
+        sysex_buf = (UBYTE *)AllocVec(sysex_len, 0);
+        if(sysex_buf == NULL) {
+            return MIDI_DRV_RET_MEMORY_ERROR;
+        }
+        sysex_buf[0] = MS_SysEx;
+        sysex_buf[1] = GEN_SYSEX_ID;
+        for(ULONG i=GEN_SYSEX_MIN_LEN-1;i<sysex_len-1;i++) {
+            sysex_buf[i] = (UBYTE)(i & 0x7f);
+        }
+        sysex_buf[sysex_len-1] = MS_EOX;
+    }
+
+    int error = timer_init();
+    if(error != 0) {
+        D(("midi-gen: timer init failed!\n"));
+        if(sysex_buf != NULL) {
+            FreeVec(sysex_buf);
+            sysex_buf = NULL;
+        }
+        return MIDI_DRV_RET_FATAL_ERROR;
+    }
+
+    // start ticking
+    tick_time.tv_secs = tick_ms / 1000;
+    tick_time.tv_micro = (tick_ms % 1000) * 1000;
+    GetSysTime(&next_tick);
+    timer_set_next();
+    return MIDI_DRV_RET_OK;
+}
+
+void midi_drv_api_exit(void)
+{
+    for(int i=0;i<NUM_STREAMS;i++) {
+        D(("gen: stream %ld: seq=%ld dropped=%ld\n", i, streams[i].seq, streams[i].dropped));
+    }
+
+    timer_exit();
+
+    if(sysex_buf != NULL) {
+        FreeVec(sysex_buf);
+        sysex_buf = NULL;
+    }
+}
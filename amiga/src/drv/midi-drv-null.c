@@ -0,0 +1,392 @@
+/*
+ * a CAMD midi driver for classic Amigas
+ *
+ * The null driver discards all transmitted data and can synthesise
+ * receive traffic at a given rate. It has no transport at all and thus
+ * shows the cost of the generic driver framework.
+ */
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <clib/alib_protos.h>
+#include <devices/timer.h>
+#include <midi/camddevices.h>
+#include <midi/camd.h>
+#include <midi/mididefs.h>
+#include <string.h>
+
+#include "debug.h"
+#include "compiler.h"
+#include "midi-msg.h"
+#include "midi-drv.h"
+#include "eclock.h"
+
+static SAVEDS ASM void null_close_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum)
+        );
+
+/* midi driver structure */
+static struct MidiDeviceData my_dev = {
+    .Magic = MDD_Magic,
+    .Name = "null",
+    .IDString = "Null driver",
+    .Version = 0,
+    .Revision = 1,
+    .Init = midi_drv_init,
+    .Expunge = midi_drv_expunge,
+    .OpenPort = midi_drv_open_port,
+    .ClosePort = null_close_port,
+    .NPorts = MIDI_DRV_NUM_PORTS,
+    .Flags = 1, // new style driver
+};
+
+#ifdef MIDI_HOST
+/* the simulated camd.library finds the driver by this symbol */
+struct MidiDeviceData *midi_drv_device = &my_dev;
+#endif
+
+extern struct ExecBase *SysBase;
+extern struct DosLibrary *DOSBase;
+static struct timerequest *ior_time;
+static ULONG timer_mask;
+static struct MsgPort *timer_port;
+
+// rx config
+#define STATS_LEN 80
+static ULONG rx_rate;           // messages per second, 0 = no rx
+static ULONG rx_port;
+static ULONG rx_sysex;          // sysex size instead of notes
+static ULONG rx_interval = 10;  // timer interval in ms
+static char stats_file[STATS_LEN];
+
+// rx state
+static midi_drv_msg_t rx_msg;
+static UBYTE *rx_sysex_buf;
+static ULONG rx_pending;
+static ULONG rx_frac;
+static UBYTE rx_note;
+
+// stats in E-clock ticks
+struct null_stats {
+    ULONG   num;
+    ULONG   bytes;
+    ULONG   ticks;
+    ULONG   max_ticks;
+};
+static struct null_stats tx_stats;
+static struct null_stats rx_stats;
+static ULONG rx_dropped;
+static ULONG last_stamp;
+
+/* Config Driver */
+
+#define CONFIG_FILE "ENV:midi/null.config"
+#define ARG_TEMPLATE \
+    "RX_RATE/K/N,RX_PORT/K/N,RX_SYSEX/K/N," \
+    "RX_INTERVAL/K/N,STATS/K,SYSEX_SIZE/K/N"
+struct midi_drv_config_param {
+    ULONG *rx_rate;
+    ULONG *rx_port;
+    ULONG *rx_sysex;
+    ULONG *rx_interval;
+    STRPTR stats;
+    ULONG *sysex_size;
+};
+
+static int parse_args(struct midi_drv_config_param *param)
+{
+    if(param->rx_rate != NULL) {
+        D(("set rx rate: %ld\n", *param->rx_rate));
+        rx_rate = *param->rx_rate;
+    }
+    if(param->rx_port != NULL) {
+        D(("set rx port: %ld\n", *param->rx_port));
+        if(*param->rx_port < MIDI_DRV_NUM_PORTS) {
+            rx_port = *param->rx_port;
+        }
+    }
+    if(param->rx_sysex != NULL) {
+        D(("set rx sysex: %ld\n", *param->rx_sysex));
+        rx_sysex = *param->rx_sysex;
+    }
+    if(param->rx_interval != NULL) {
+        D(("set rx interval: %ld\n", *param->rx_interval));
+        if(*param->rx_interval > 0) {
+            rx_interval = *param->rx_interval;
+        }
+    }
+    if(param->stats != NULL) {
+        D(("set stats file: %s\n", param->stats));
+        strncpy(stats_file, param->stats, STATS_LEN - 1);
+    }
+    if(param->sysex_size != NULL) {
+        D(("set sysex size: %ld\n", *param->sysex_size));
+        midi_drv_sysex_max_size = *param->sysex_size;
+    }
+    return MIDI_DRV_RET_OK;
+}
+
+STRPTR midi_drv_api_config(void)
+{
+    struct midi_drv_config_param param = { NULL, NULL, NULL, NULL, NULL, NULL };
+    midi_drv_config(CONFIG_FILE, ARG_TEMPLATE, &param, parse_args);
+    return "midi.null";
+}
+
+/* Stats */
+
+static void add_stats(struct null_stats *stats, ULONG bytes)
+{
+    ULONG now = eclock_stamp();
+    ULONG delta = now - last_stamp;
+    last_stamp = now;
+
+    stats->num++;
+    stats->bytes += bytes;
+    stats->ticks += delta;
+    if(delta > stats->max_ticks) {
+        stats->max_ticks = delta;
+    }
+}
+
+static void write_stats(BPTR fh, const char *what, struct null_stats *stats)
+{
+    // average with two fractional digits
+    ULONG avg = 0;
+    ULONG frac = 0;
+    if(stats->num > 0) {
+        avg = stats->ticks / stats->num;
+        frac = (stats->ticks % stats->num) * 100 / stats->num;
+    }
+    FPrintf(fh, "%s: %ld msgs, %ld bytes, %ld ticks, ticks/msg: avg=%ld.%02ld max=%ld\n",
+            what, stats->num, stats->bytes, stats->ticks, avg, frac, stats->max_ticks);
+}
+
+/* called in the context of the closing client: the worker is no process */
+static void dump_stats(void)
+{
+    if(stats_file[0] == '\0') {
+        return;
+    }
+    BPTR fh = Open(stats_file, MODE_NEWFILE);
+    if(fh == NULL) {
+        D(("null: can't write stats: %s\n", stats_file));
+        return;
+    }
+    FPrintf(fh, "null: E-clock %ld Hz\n", eclock_freq);
+    write_stats(fh, "tx", &tx_stats);
+    write_stats(fh, "rx", &rx_stats);
+    FPrintf(fh, "rx: %ld msgs dropped\n", rx_dropped);
+    Close(fh);
+}
+
+static SAVEDS ASM void null_close_port(
+        REG(a3, struct MidiDeviceData *data),
+        REG(d0, LONG portnum)
+        )
+{
+    midi_drv_close_port(data, portnum);
+    dump_stats();
+}
+
+/* TX */
+
+void midi_drv_api_tx_msg(midi_drv_msg_t *msg)
+{
+    // the time since the last stamp was spent in the framework
+    ULONG bytes = (msg->sysex_data != NULL) ? msg->sysex_size : msg->midi_msg.b[MIDI_MSG_SIZE];
+    add_stats(&tx_stats, bytes);
+}
+
+/* RX */
+
+static void timer_set(ULONG secs, ULONG micro)
+{
+    ior_time->tr_node.io_Command = TR_ADDREQUEST;
+    ior_time->tr_time.tv_secs = secs;
+    ior_time->tr_time.tv_micro = micro;
+
+    SendIO((struct IORequest *)ior_time);
+}
+
+static void handle_timer(void)
+{
+    // messages due in this interval
+    ULONG num = rx_rate * rx_interval + rx_frac;
+    rx_frac = num % 1000;
+    num /= 1000;
+
+    // the framework did not keep up with the last interval
+    if(rx_pending > 0) {
+        rx_dropped += rx_pending;
+    }
+    rx_pending = num;
+
+    timer_set(rx_interval / 1000, (rx_interval % 1000) * 1000);
+}
+
+static midi_drv_msg_t *next_rx_msg(void)
+{
+    rx_pending--;
+    rx_msg.port = rx_port;
+    if(rx_sysex_buf != NULL) {
+        rx_msg.midi_msg.b[MIDI_MSG_STATUS] = MS_SysEx;
+        rx_msg.midi_msg.b[MIDI_MSG_DATA1] = 0;
+        rx_msg.midi_msg.b[MIDI_MSG_DATA2] = 0;
+        rx_msg.midi_msg.b[MIDI_MSG_SIZE] = 0;
+        rx_msg.sysex_data = rx_sysex_buf;
+        rx_msg.sysex_size = rx_sysex;
+    } else {
+        // note on/off sweep
+        UBYTE note = rx_note >> 1;
+        rx_msg.midi_msg.b[MIDI_MSG_STATUS] = (rx_note & 1) ? MS_NoteOff : MS_NoteOn;
+        rx_msg.midi_msg.b[MIDI_MSG_DATA1] = note;
+        rx_msg.midi_msg.b[MIDI_MSG_DATA2] = 0x40;
+        rx_msg.midi_msg.b[MIDI_MSG_SIZE] = 3;
+        rx_msg.sysex_data = NULL;
+        rx_msg.sysex_size = 0;
+        rx_note++;
+    }
+    return &rx_msg;
+}
+
+int midi_drv_api_rx_msg(midi_drv_msg_t **msg, ULONG *got_mask)
+{
+    ULONG start_mask = *got_mask;
+    ULONG my_mask;
+
+    // synthesised messages are pending: only poll the signals
+    if(rx_pending > 0) {
+        my_mask = SetSignal(0, start_mask | timer_mask) & (start_mask | timer_mask);
+    } else {
+        my_mask = Wait(start_mask | timer_mask);
+    }
+
+    if((my_mask & timer_mask) != 0) {
+        GetMsg(timer_port);
+        handle_timer();
+    }
+    if(rx_pending > 0) {
+        *msg = next_rx_msg();
+    }
+
+    *got_mask = my_mask & start_mask;
+    last_stamp = eclock_stamp();
+    return MIDI_DRV_RET_OK;
+}
+
+void midi_drv_api_rx_msg_done(midi_drv_msg_t *msg)
+{
+    ULONG bytes = (msg->sysex_data != NULL) ? msg->sysex_size : msg->midi_msg.b[MIDI_MSG_SIZE];
+    add_stats(&rx_stats, bytes);
+}
+
+/* Setup */
+
+static int timer_init(void)
+{
+    struct MsgPort *port;
+    LONG error;
+
+    port = CreatePort(NULL, 0);
+    if(port == NULL) {
+        return 1;
+    }
+
+    ior_time = (struct timerequest *)CreateExtIO(port, sizeof(struct timerequest));
+    if(ior_time == NULL) {
+        DeletePort(port);
+        return 2;
+    }
+
+    error = OpenDevice(TIMERNAME, UNIT_MICROHZ, (struct IORequest *)ior_time, 0L);
+    if(error != 0) {
+        DeleteExtIO((struct IORequest *)ior_time);
+        DeletePort(port);
+        return 3;
+    }
+
+    timer_port = port;
+    return 0;
+}
+
+static void timer_exit(void)
+{
+    struct MsgPort *port;
+
+    if(ior_time == NULL) {
+        return;
+    }
+
+    port = timer_port;
+
+    if(timer_mask != 0) {
+        AbortIO((struct IORequest *)ior_time);
+        WaitIO((struct IORequest *)ior_time);
+    }
+
+    CloseDevice((struct IORequest *)ior_time);
+    DeleteExtIO((struct IORequest *)ior_time);
+    DeletePort(port);
+
+    timer_port = NULL;
+    timer_mask = 0;
+    ior_time = NULL;
+}
+
+int midi_drv_api_init(struct ExecBase *SysBase)
+{
+    // timer is used for rx
+    int error = timer_init();
+    if(error != 0) {
+        D(("midi-null: timer init failed!\n"));
+        return MIDI_DRV_RET_FATAL_ERROR;
+    }
+    if(eclock_init() != 0) {
+        timer_exit();
+        return MIDI_DRV_RET_FATAL_ERROR;
+    }
+
+    if((rx_sysex > 0) && (rx_sysex < 3)) {
+        rx_sysex = 3;
+    }
+    if(rx_sysex > midi_drv_sysex_max_size) {
+        rx_sysex = midi_drv_sysex_max_size;
+    }
+    if((rx_rate > 0) && (rx_sysex > 0)) {
+        rx_sysex_buf = (UBYTE *)AllocVec(rx_sysex, 0);
+        if(rx_sysex_buf == NULL) {
+            eclock_exit();
+            timer_exit();
+            return MIDI_DRV_RET_MEMORY_ERROR;
+        }
+        rx_sysex_buf[0] = MS_SysEx;
+        for(ULONG i=1;i<rx_sysex-1;i++) {
+            rx_sysex_buf[i] = (UBYTE)(i & 0x7f);
+        }
+        rx_sysex_buf[rx_sysex-1] = MS_EOX;
+    }
+
+    // start rx ticks
+    if(rx_rate > 0) {
+        timer_mask = 1 << timer_port->mp_SigBit;
+        timer_set(rx_interval / 1000, (rx_interval % 1000) * 1000);
+    }
+
+    last_stamp = eclock_stamp();
+    return MIDI_DRV_RET_OK;
+}
+
+void midi_drv_api_exit(void)
+{
+    D(("null: tx=%ld rx=%ld dropped=%ld\n", tx_stats.num, rx_stats.num, rx_dropped));
+
+    timer_exit();
+    eclock_exit();
+
+    if(rx_sysex_buf != NULL) {
+        FreeVec(rx_sysex_buf);
+        rx_sysex_buf = NULL;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef MIDI_DRV_STATS_H
+#define MIDI_DRV_STATS_H
+
+/*
+ * counters of a driver
+ *
+ * The driver publishes them with a public port named "<task name>.stats".
+ * Readers look at them under Forbid(). The counters are only incremented
+ * and never locked: a reset may lose a concurrent increment.
+ */
+
+#include <exec/ports.h>
+#include <stddef.h>
+
+#define MIDI_DRV_STATS_PORT_POSTFIX ".stats"
+#define MIDI_DRV_STATS_MAGIC        0x4d445354  /* MDST */
+#define MIDI_DRV_STATS_PORT_MAGIC   0x4d445350  /* MDSP */
+#define MIDI_DRV_STATS_VERSION      1
+#define MIDI_DRV_STATS_NUM_PORTS    8
+
+struct midi_drv_port_stats {
+    ULONG   tx_msgs;
+    ULONG   tx_bytes;
+    ULONG   tx_sysex;
+    ULONG   rx_msgs;
+    ULONG   rx_bytes;
+    ULONG   rx_sysex;
+    ULONG   parse_errors;       /* invalid bytes in the tx stream */
+    ULONG   sysex_truncated;    /* larger than the sysex buffer */
+};
+
+struct midi_drv_stats {
+    ULONG   magic;
+    UWORD   version;
+    UWORD   num_ports;
+    ULONG   eclock_freq;
+
+    /* from here on cleared by a reset */
+    ULONG   wakeups;            /* worker task returned from rx */
+    ULONG   xmit_runs;          /* tx buffers drained */
+    ULONG   max_drain;          /* longest drain in E-clock ticks */
+    ULONG   net_drops;          /* rejected packets */
+    ULONG   net_tx_errors;
+    ULONG   seq_gaps;           /* packets missing in the peer stream */
+    struct midi_drv_port_stats ports[MIDI_DRV_STATS_NUM_PORTS];
+};
+
+#define MIDI_DRV_STATS_RESET_OFFSET  offsetof(struct midi_drv_stats, wakeups)
+
+/* other public ports may share the postfix: check magic before stats */
+struct midi_drv_stats_port {
+    struct MsgPort          port;
+    ULONG                   magic;      /* MIDI_DRV_STATS_PORT_MAGIC */
+    struct midi_drv_stats   *stats;
+    char                    name[32];
+};
+
+#endif /* MIDI_DRV_STATS_H */
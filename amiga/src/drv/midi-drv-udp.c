@@ -14,6 +14,7 @@
 #include "compiler.h"
 #include "midi-msg.h"
 #include "midi-drv.h"
+#include "eclock.h"
 #include "udp.h"
 #include "proto.h"
 
@@ -36,6 +37,11 @@ static struct MidiDeviceData my_dev = {
     .Flags = 1, // new style driver
 };
 
+#ifdef MIDI_HOST
+/* the simulated camd.library finds the driver by this symbol */
+struct MidiDeviceData *midi_drv_device = &my_dev;
+#endif
+
 extern struct ExecBase *SysBase;
 struct Library *TimerBase;
 static struct timerequest *ior_time;
@@ -94,6 +100,18 @@ STRPTR midi_drv_api_config(void)
     return "midi.udp";
 }
 
+/* the E-clock since init: monotonic and much finer than GetSysTime().
+   below 2^32 ticks the conversion takes only a few divisions */
+static struct EClockVal stamp_base;
+
+static void stamp_packet(struct proto_packet *pkt)
+{
+    struct EClockVal ev;
+    eclock_read(&ev);
+    eclock_diff(&ev, &ev, &stamp_base);
+    eclock_to_timeval(&ev, &pkt->time_stamp);
+}
+
 void midi_drv_api_tx_msg(midi_drv_msg_t *msg)
 {
     struct proto_packet *pkt;
@@ -108,7 +126,7 @@ void midi_drv_api_tx_msg(midi_drv_msg_t *msg)
 
     pkt->port = msg->port;
     pkt->seq_num = ++peer_tx_seq_num;
-    GetSysTime(&pkt->time_stamp);
+    stamp_packet(pkt);
 
     ULONG sysex_size = msg->sysex_size;
     if(sysex_size > 0) {
@@ -125,6 +143,7 @@ void midi_drv_api_tx_msg(midi_drv_msg_t *msg)
     int res = proto_send_packet(&proto, &peer_addr);
     if(res != 0) {
         D(("midi-udp: tx err: %ld\n", res));
+        midi_drv_stats.net_tx_errors++;
     } else {
         D(("midi-udp: tx OK\n"));
     }
@@ -150,6 +169,21 @@ static void handle_timer(void)
 #define check_peer_addr(addr) \
     (addr->sin_addr.s_addr == peer_addr.sin_addr.s_addr)
 
+/* the peer numbers all packets following its invitation */
+static void check_peer_seq_num(struct proto_packet *pkt)
+{
+    ULONG expect = peer_rx_seq_num + 1;
+    LONG delta = (LONG)(pkt->seq_num - expect);
+    if(delta > 0) {
+        D(("midi-udp: seq gap: want=%08lx got=%08lx\n", expect, pkt->seq_num));
+        midi_drv_stats.seq_gaps += delta;
+    }
+    // ignore late packets
+    if(delta >= 0) {
+        peer_rx_seq_num = pkt->seq_num;
+    }
+}
+
 static void handle_peer_invitation(struct sockaddr_in *this_peer_addr,
                                    struct proto_packet *pkt)
 {
@@ -164,7 +198,7 @@ static void handle_peer_invitation(struct sockaddr_in *this_peer_addr,
 
     ret_pkt->magic = PROTO_MAGIC | cmd;
     ret_pkt->port = pkt->port;
-    GetSysTime(&ret_pkt->time_stamp);
+    stamp_packet(ret_pkt);
     ret_pkt->seq_num = pkt->time_stamp.tv_micro;
     ret_pkt->data_size = 0;
 
@@ -209,6 +243,10 @@ static void handle_peer_exit(struct sockaddr_in *this_peer_addr,
 static void handle_peer_clock(struct sockaddr_in *this_peer_addr,
                               struct proto_packet *pkt, UBYTE *data_buf)
 {
+    if(peer_connected && check_peer_addr(this_peer_addr)) {
+        check_peer_seq_num(pkt);
+    }
+
     // reply
     struct proto_packet *ret_pkt;
     UBYTE *ret_data_buf;
@@ -216,13 +254,14 @@ static void handle_peer_clock(struct sockaddr_in *this_peer_addr,
 
     ret_pkt->magic = PROTO_MAGIC | PROTO_MAGIC_CMD_CLOCK;
     ret_pkt->port = pkt->port;
-    GetSysTime(&ret_pkt->time_stamp);
+    stamp_packet(ret_pkt);
     ret_pkt->seq_num = ++peer_tx_seq_num;
     ret_pkt->data_size = 0;
 
     int res = proto_send_packet(&proto, this_peer_addr);
     if(res != 0) {
         D(("midi-udp: tx err: %ld\n", res));
+        midi_drv_stats.net_tx_errors++;
     }
 
     D(("peer clock: %ld, %ld\n", pkt->time_stamp.tv_secs, pkt->time_stamp.tv_micro));
@@ -237,15 +276,19 @@ static midi_drv_msg_t *handle_peer_midi_msg(struct sockaddr_in *this_peer_addr,
     // check addr
     if(!check_peer_addr(this_peer_addr)) {
         D(("midi-udp: midi_msg: peer wrong addr!\n"));
+        midi_drv_stats.net_drops++;
         return NULL;
     }
 
     // check size
     if(pkt->data_size != sizeof(midi_msg_t)) {
         D(("midi.udp: midi_msg: wrong size!\n"));
+        midi_drv_stats.net_drops++;
         return NULL;
     }
 
+    check_peer_seq_num(pkt);
+
     my_msg.port = pkt->port;
     my_msg.midi_msg = *((midi_msg_t *)data_buf);
     my_msg.sysex_data = NULL;
@@ -259,15 +302,19 @@ static midi_drv_msg_t *handle_peer_midi_sysex(struct sockaddr_in *this_peer_addr
     // check addr
     if(!check_peer_addr(this_peer_addr)) {
         D(("midi-udp: midi sysex: peer wrong addr!\n"));
+        midi_drv_stats.net_drops++;
         return NULL;
     }
 
     // check size
     if(pkt->data_size < 3) {
         D(("midi.udp: midi sysex: wrong size!\n"));
+        midi_drv_stats.net_drops++;
         return NULL;
     }
 
+    check_peer_seq_num(pkt);
+
     my_msg.port = pkt->port;
     my_msg.midi_msg = *((midi_msg_t *)data_buf);
     my_msg.sysex_data = data_buf;
@@ -345,6 +392,7 @@ int midi_drv_api_rx_msg(midi_drv_msg_t **msg, ULONG *got_mask)
                         break;
                     default:
                         D(("ERROR invalid cmd!\n"));
+                        midi_drv_stats.net_drops++;
                         break;
                 }
             } else {
@@ -453,6 +501,8 @@ int midi_drv_api_init(struct ExecBase *SysBase)
         return MIDI_DRV_RET_FATAL_ERROR;
     }
 
+    eclock_read(&stamp_base);
+
     return MIDI_DRV_RET_OK;
 }
 
@@ -8,8 +8,11 @@
 #include <midi/camddevices.h>
 #include <midi/camd.h>
 #include <midi/mididefs.h>
+#include <string.h>
 
 #include "debug.h"
+#include "eclock.h"
+#include "trace.h"
 #include "compiler.h"
 #include "midi-msg.h"
 #include "midi-parser.h"
@@ -44,11 +47,13 @@ static xmit_func_t xmit_funcs[] = {
     XMIT_FUNC(7)
 };
 
+#ifndef MIDI_HOST
 int main()
 {
     /* do not run driver */
     return -1;
 }
+#endif
 
 struct ExecBase *SysBase;
 struct DosLibrary *DOSBase;
@@ -63,6 +68,10 @@ static struct SignalSemaphore sem_mask;
 // driver config
 ULONG midi_drv_sysex_max_size = MIDI_DRV_DEFAULT_SYSEX_SIZE;
 
+// stats
+struct midi_drv_stats midi_drv_stats;
+static struct midi_drv_stats_port stats_port;
+
 // port data
 struct port_data {
     midi_drv_tx_func_t tx_func;
@@ -119,6 +128,7 @@ static void port_xmit(int portnum)
 {
     D(("port xmit %ld\n", portnum));
     struct port_data *pd = &ports[portnum];
+    struct midi_drv_port_stats *ps = &midi_drv_stats.ports[portnum];
 
     ObtainSemaphore(&pd->sem_port);
     while(1) {
@@ -133,6 +143,7 @@ static void port_xmit(int portnum)
             break;
         }
         D(("TX: %02lx\n", data));
+        ps->tx_bytes++;
         int res = midi_parser_feed(&pd->parser, data);
         // send regular message
         if(res == MIDI_PARSER_RET_MSG) {
@@ -142,11 +153,14 @@ static void port_xmit(int portnum)
                 .midi_msg = msg
             };
             D(("TX: #%ld msg %08lx\n", portnum, msg));
+            T(TRACE_TX_MSG, portnum, msg.l)
+            ps->tx_msgs++;
             midi_drv_api_tx_msg(&dmsg);
         }
         // send sysex
         else if(res == MIDI_PARSER_RET_SYSEX_OK) {
             D(("TX: sysex %ld\n", pd->parser.sysex_bytes));
+            T(TRACE_TX_SYSEX, portnum, pd->parser.sysex_bytes)
             midi_msg_t msg = pd->parser.msg;
             midi_drv_msg_t dmsg = {
                 .port = portnum,
@@ -154,8 +168,16 @@ static void port_xmit(int portnum)
                 .sysex_data = pd->parser.sysex_buf,
                 .sysex_size = pd->parser.sysex_bytes
             };
+            ps->tx_sysex++;
             midi_drv_api_tx_msg(&dmsg);
         }
+        else if(res == MIDI_PARSER_RET_SYSEX_TOO_LARGE) {
+            D(("TX: sysex too large %ld\n", pd->parser.sysex_bytes));
+            ps->sysex_truncated++;
+        }
+        else if(res == MIDI_PARSER_RET_ERROR) {
+            ps->parse_errors++;
+        }
     }
     ReleaseSemaphore(&pd->sem_port);
 }
@@ -164,6 +186,7 @@ static void port_recv(midi_drv_msg_t *msg)
 {
     if(msg->port < MIDI_DRV_NUM_PORTS) {
         struct port_data *pd = &ports[msg->port];
+        struct midi_drv_port_stats *ps = &midi_drv_stats.ports[msg->port];
 
         ObtainSemaphore(&pd->sem_port);
 
@@ -179,6 +202,9 @@ static void port_recv(midi_drv_msg_t *msg)
                 }
                 ULONG num_bytes = msg->sysex_size;
                 UBYTE *data = msg->sysex_data;
+                T(TRACE_RX_SYSEX, msg->port, num_bytes)
+                ps->rx_sysex++;
+                ps->rx_bytes += num_bytes;
                 for(ULONG i=0;i<num_bytes;i++) {
                     D(("RXs: #%ld %02lx\n", msg->port, data[i]));
                     pd->rx_func(data[i], pd->user_data);
@@ -187,6 +213,9 @@ static void port_recv(midi_drv_msg_t *msg)
             // regular message
             else {
                 int num_bytes = msg->midi_msg.b[MIDI_MSG_SIZE];
+                T(TRACE_RX_MSG, msg->port, msg->midi_msg.l)
+                ps->rx_msgs++;
+                ps->rx_bytes += num_bytes;
                 for(int i=0;i<num_bytes;i++) {
                     D(("RX: #%ld %02lx\n", msg->port, msg->midi_msg.b[i]));
                     pd->rx_func(msg->midi_msg.b[i], pd->user_data);
@@ -216,12 +245,15 @@ static void notify_end_task(int portnum, struct port_data *port)
 static void do_transmit(void)
 {
     ULONG mask;
+    ULONG start;
 
     // fetch current mask
     ObtainSemaphore(&sem_mask);
     mask = activate_portmask;
+    start = eclock_stamp();
 
     D(("midi: activate port mask: %08lx\n", mask));
+    T(TRACE_XMIT_BEGIN, mask, 0)
     for(int i=0;i<MIDI_DRV_NUM_PORTS;i++) {
         if(mask & (1<<i)) {
             port_xmit(i);
@@ -231,6 +263,13 @@ static void do_transmit(void)
 
     activate_portmask = 0;
     ReleaseSemaphore(&sem_mask);
+    T(TRACE_XMIT_END, mask, 0)
+
+    ULONG ticks = eclock_stamp() - start;
+    if(ticks > midi_drv_stats.max_drain) {
+        midi_drv_stats.max_drain = ticks;
+    }
+    midi_drv_stats.xmit_runs++;
 }
 
 static void main_loop(void)
@@ -246,6 +285,8 @@ static void main_loop(void)
         // block and get next message or return with signal
         int res = midi_drv_api_rx_msg(&msg, &got_sig);
         D(("midi: rx_msg res=%ld, mask=%08lx\n", res, got_sig));
+        T(TRACE_RX_WAKE, got_sig, msg != NULL)
+        midi_drv_stats.wakeups++;
         if(res != MIDI_DRV_RET_OK) {
             break;
         }
@@ -263,6 +304,7 @@ static void main_loop(void)
         // a message was received (rx)
         if(msg != NULL) {
             port_recv(msg);
+            T(TRACE_RX_DONE, msg->port, 0)
             midi_drv_api_rx_msg_done(msg);
         }
     }
@@ -308,11 +350,50 @@ SAVEDS static void task_main(void)
     Signal(main_task, 1 << main_sig);
 }
 
+/* Stats */
+
+static int stats_init(STRPTR name)
+{
+    if(eclock_init() != 0) {
+        return 1;
+    }
+
+    memset(&midi_drv_stats, 0, sizeof(midi_drv_stats));
+    midi_drv_stats.magic = MIDI_DRV_STATS_MAGIC;
+    midi_drv_stats.version = MIDI_DRV_STATS_VERSION;
+    midi_drv_stats.num_ports = MIDI_DRV_NUM_PORTS;
+    midi_drv_stats.eclock_freq = eclock_freq;
+
+    // the port never gets messages: readers only look at the stats
+    strncpy(stats_port.name, name, sizeof(stats_port.name) - sizeof(MIDI_DRV_STATS_PORT_POSTFIX));
+    strcat(stats_port.name, MIDI_DRV_STATS_PORT_POSTFIX);
+    stats_port.port.mp_Node.ln_Name = stats_port.name;
+    stats_port.port.mp_Flags = PA_IGNORE;
+    stats_port.magic = MIDI_DRV_STATS_PORT_MAGIC;
+    stats_port.stats = &midi_drv_stats;
+    AddPort(&stats_port.port);
+    return 0;
+}
+
+static void stats_exit(void)
+{
+    // readers only look at the stats under Forbid()
+    Forbid();
+    RemPort(&stats_port.port);
+    Permit();
+
+    eclock_exit();
+}
+
 /* Driver Functions */
 
 SAVEDS BOOL ASM midi_drv_init(void)
 {
+#ifdef MIDI_HOST
+    SysBase = sim_exec_base();
+#else
     SysBase = *(struct ExecBase **)4;
+#endif
     D(("midi: Init: Sysbase=%lx\n", SysBase));
 
     // open dos
@@ -323,6 +404,12 @@ SAVEDS BOOL ASM midi_drv_init(void)
     }
 
     STRPTR name = midi_drv_api_config();
+    T_INIT(name)
+
+    if(stats_init(name) != 0) {
+        D(("midi: stats init failed!\n"));
+        return FALSE;
+    }
 
     InitSemaphore(&sem_mask);
     D(("acti: %lx\n", &activate_portmask));
@@ -340,6 +427,8 @@ SAVEDS BOOL ASM midi_drv_init(void)
     main_sig = AllocSignal(-1);
     if(main_sig == -1) {
         D(("midi: main sig alloc failed!\n"));
+        stats_exit();
+        T_EXIT()
         return FALSE;
     }
 
@@ -349,6 +438,9 @@ SAVEDS BOOL ASM midi_drv_init(void)
     worker_task = CreateTask(name, 0L, (void *)task_main, 6000L);
     if(worker_task == NULL) {
         D(("midi: create task failed!\n"));
+        FreeSignal(main_sig);
+        stats_exit();
+        T_EXIT()
         return FALSE;
     }
     D(("worker task: %lx\n", worker_task));
@@ -357,6 +449,12 @@ SAVEDS BOOL ASM midi_drv_init(void)
     Wait(1 << main_sig);
 
     D(("midi: Init done: status=%ld\n", (ULONG)worker_status));
+    if(!worker_status) {
+        // no expunge will follow
+        FreeSignal(main_sig);
+        stats_exit();
+        T_EXIT()
+    }
     return worker_status;
 }
 
@@ -370,6 +468,9 @@ SAVEDS ASM void midi_drv_expunge(void)
 
     FreeSignal(main_sig);
 
+    stats_exit();
+    T_EXIT()
+
     CloseLibrary((struct Library *)DOSBase);
 
     D(("midi: Expunge done\n"));
@@ -396,6 +497,7 @@ SAVEDS ASM struct MidiPortData *midi_drv_open_port(
         port->rx_func = rx_func;
         port->user_data = user_data;
         ReleaseSemaphore(&port->sem_port);
+        T(TRACE_OPEN_PORT, portnum, FindTask(NULL))
         D(("midi: OpenPort(%ld): done user data=%lx\n", portnum, user_data));
         return &port->port_data;
     } else {
@@ -444,6 +546,7 @@ SAVEDS ASM void midi_drv_close_port(
         port->rx_func = NULL;
         ReleaseSemaphore(&port->sem_port);
         midi_parser_exit(&port->parser);
+        T(TRACE_CLOSE_PORT, portnum, FindTask(NULL))
     }
     D(("midi: ClosePort(%ld): done\n", portnum));
 }
@@ -452,6 +555,7 @@ SAVEDS ASM void midi_drv_xmit(REG(d0, LONG portnum))
 {
     D(("midi: ActivateXMit(%ld): task=%lx mask=%lx\n", portnum, FindTask(NULL), &activate_portmask));
     if(portnum < MIDI_DRV_NUM_PORTS) {
+        T(TRACE_ACTIVATE, portnum, FindTask(NULL))
         ObtainSemaphore(&sem_mask);
         activate_portmask |= 1 << portnum;
         ReleaseSemaphore(&sem_mask);
@@ -1,6 +1,8 @@
 #ifndef MIDI_DRV_H
 #define MIDI_DRV_H
 
+#include "midi-drv-stats.h"
+
 #define MIDI_DRV_NUM_PORTS  8
 #define MIDI_DRV_DEFAULT_SYSEX_SIZE 2048
 
@@ -43,6 +45,9 @@ SAVEDS ASM void midi_drv_close_port(
 /* config option */
 extern ULONG midi_drv_sysex_max_size;
 
+/* counters. drivers may update the net fields */
+extern struct midi_drv_stats midi_drv_stats;
+
 struct midi_drv_config_param;
 typedef int (*midi_config_func_t)(struct midi_drv_config_param *cfg);
 
@@ -5,6 +5,7 @@
 
 #include "compiler.h"
 #include "debug.h"
+#include "trace.h"
 #include "udp.h"
 #include "midi-msg.h"
 #include "proto.h"
@@ -74,6 +75,27 @@ void proto_exit(struct proto_handle *ph)
     FreeVec(ph->tx_buf);
 }
 
+/* the packet header is sent in network (big endian) byte order like on
+   the Amiga. this is a no-op there but required on little endian hosts */
+static void pkt_swap(struct proto_packet *pkt, int to_net)
+{
+    if(to_net) {
+        pkt->magic = htonl(pkt->magic);
+        pkt->port = htonl(pkt->port);
+        pkt->seq_num = htonl(pkt->seq_num);
+        pkt->time_stamp.tv_secs = htonl(pkt->time_stamp.tv_secs);
+        pkt->time_stamp.tv_micro = htonl(pkt->time_stamp.tv_micro);
+        pkt->data_size = htonl(pkt->data_size);
+    } else {
+        pkt->magic = ntohl(pkt->magic);
+        pkt->port = ntohl(pkt->port);
+        pkt->seq_num = ntohl(pkt->seq_num);
+        pkt->time_stamp.tv_secs = ntohl(pkt->time_stamp.tv_secs);
+        pkt->time_stamp.tv_micro = ntohl(pkt->time_stamp.tv_micro);
+        pkt->data_size = ntohl(pkt->data_size);
+    }
+}
+
 void proto_send_prepare(struct proto_handle *ph,
                         struct proto_packet **ret_pkt,
                         UBYTE **ret_data)
@@ -89,7 +111,14 @@ int proto_send_packet(struct proto_handle *ph,
     ULONG  data_size = pkt->data_size;
     ULONG  raw_size = sizeof(struct proto_packet) + data_size;
 
-    if(!udp_send(&ph->udp, ph->udp_fd, peer_addr, ph->tx_buf, raw_size)) {
+    T(TRACE_UDP_TX_PKT, pkt->magic & PROTO_MAGIC_CMD_MASK, pkt->seq_num)
+
+    // callers may still read the header after sending
+    pkt_swap(pkt, TRUE);
+    int res = udp_send(&ph->udp, ph->udp_fd, peer_addr, ph->tx_buf, raw_size);
+    pkt_swap(pkt, FALSE);
+
+    if(!res) {
         return PROTO_RET_OK;
     } else {
         return PROTO_RET_ERROR_UDP_IO;
@@ -108,6 +137,7 @@ int proto_recv_packet(struct proto_handle *ph,
     }
 
     struct proto_packet *pkt = (struct proto_packet *)ph->rx_buf;
+    pkt_swap(pkt, FALSE);
 
     // check magic
     ULONG magic = pkt->magic;
@@ -137,6 +167,8 @@ int proto_recv_packet(struct proto_handle *ph,
         return PROTO_RET_ERROR_WRONG_SIZE;
     }
 
+    T(TRACE_UDP_RX_PKT, cmd, pkt->seq_num)
+
     // setip data
     *ret_pkt = pkt;
     *ret_data = ph->rx_buf + sizeof(struct proto_packet);
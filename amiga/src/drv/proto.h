@@ -38,7 +38,7 @@ struct proto_packet {
     ULONG  magic;
     ULONG  port;
     ULONG  seq_num;
-    struct timeval  time_stamp;
+    struct timeval  time_stamp;     /* Amiga: E-clock time since init */
     ULONG  data_size;
 };
 
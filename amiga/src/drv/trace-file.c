@@ -0,0 +1,74 @@
+/*
+ * trace-file.c - read and save the records of a trace ring
+ */
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <string.h>
+
+#include "trace.h"
+
+static const char *event_names[TRACE_NUM_EVENTS] = TRACE_EVENT_NAMES;
+
+/* copy the records in the order they were written. records written
+   right now are skipped. Forbid() on the Amiga while calling this */
+ULONG trace_snapshot(struct trace_ring *ring, struct trace_rec *recs, ULONG max_recs)
+{
+    ULONG pos = ring->pos;
+    ULONG num = pos;
+    ULONG i;
+    ULONG out = 0;
+
+    if(num > ring->size) {
+        num = ring->size;
+    }
+    if(num > max_recs) {
+        num = max_recs;
+    }
+
+    for(i = pos - num; i != pos; i++) {
+        struct trace_rec *rec = &ring->recs[i & (ring->size - 1)];
+        if((rec->id == TRACE_NONE) || (rec->id == TRACE_BUSY)) {
+            continue;
+        }
+        recs[out] = *rec;
+        out++;
+    }
+    return out;
+}
+
+int trace_save(BPTR fh, ULONG eclock_freq, struct trace_rec *recs, ULONG num_recs)
+{
+    struct trace_file_header hdr;
+    static const UBYTE pad[4] = { 0, 0, 0, 0 };
+    ULONG names_size = 0;
+    LONG pad_size;
+    int i;
+
+    hdr.magic = TRACE_FILE_MAGIC;
+    hdr.version = TRACE_FILE_VERSION;
+    hdr.num_events = TRACE_NUM_EVENTS;
+    hdr.eclock_freq = eclock_freq;
+    hdr.num_recs = num_recs;
+    if(Write(fh, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        return 1;
+    }
+
+    for(i=0;i<TRACE_NUM_EVENTS;i++) {
+        LONG len = strlen(event_names[i]) + 1;
+        if(Write(fh, (APTR)event_names[i], len) != len) {
+            return 1;
+        }
+        names_size += len;
+    }
+    pad_size = (4 - (names_size & 3)) & 3;
+    if((pad_size > 0) && (Write(fh, (APTR)pad, pad_size) != pad_size)) {
+        return 1;
+    }
+
+    LONG size = num_recs * sizeof(struct trace_rec);
+    if(Write(fh, recs, size) != size) {
+        return 1;
+    }
+    return 0;
+}
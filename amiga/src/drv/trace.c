@@ -0,0 +1,141 @@
+/*
+ * trace.c - binary trace ring of a driver
+ */
+
+#ifdef KTRACE
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <string.h>
+
+#include "debug.h"
+#include "compiler.h"
+#include "eclock.h"
+#include "trace.h"
+
+static BOOL trace_eclock;
+static struct trace_port *trace_port;
+static struct trace_ring *trace_ring;
+
+int trace_init(STRPTR name)
+{
+    if(eclock_init() != 0) {
+        D(("trace: no timer!\n"));
+        return 1;
+    }
+    trace_eclock = TRUE;
+
+    trace_port = AllocVec(sizeof(struct trace_port), MEMF_PUBLIC | MEMF_CLEAR);
+    trace_ring = AllocVec(sizeof(struct trace_ring), MEMF_PUBLIC | MEMF_CLEAR);
+    if((trace_port == NULL) || (trace_ring == NULL)) {
+        D(("trace: no memory!\n"));
+        trace_exit();
+        return 2;
+    }
+
+    trace_ring->magic = TRACE_RING_MAGIC;
+    trace_ring->size = TRACE_RING_SIZE;
+    trace_ring->eclock_freq = eclock_freq;
+
+    /* the port only carries the ring and never gets messages */
+    strncpy(trace_port->name, name, sizeof(trace_port->name) - sizeof(TRACE_PORT_POSTFIX));
+    strcat(trace_port->name, TRACE_PORT_POSTFIX);
+    trace_port->port.mp_Node.ln_Name = trace_port->name;
+    trace_port->port.mp_Flags = PA_IGNORE;
+    trace_port->ring = trace_ring;
+    AddPort(&trace_port->port);
+
+    D(("trace: ring=%lx port=%s\n", trace_ring, trace_port->name));
+    trace_add(TRACE_INIT, trace_ring->eclock_freq, TRACE_RING_SIZE);
+    return 0;
+}
+
+#ifdef MIDI_HOST
+/* tools run in their own process on the host and can't find the port:
+   keep the ring in a dump file in T: */
+static void trace_save_file(void)
+{
+    char file_name[48];
+    struct trace_rec *recs = AllocVec(sizeof(trace_ring->recs), MEMF_ANY);
+    if(recs == NULL) {
+        return;
+    }
+    strcpy(file_name, "T:");
+    strcat(file_name, trace_port->name);
+
+    ULONG num = trace_snapshot(trace_ring, recs, TRACE_RING_SIZE);
+    BPTR fh = Open(file_name, MODE_NEWFILE);
+    if(fh != 0) {
+        trace_save(fh, trace_ring->eclock_freq, recs, num);
+        Close(fh);
+    }
+    FreeVec(recs);
+}
+#endif
+
+void trace_exit(void)
+{
+    if(trace_port != NULL) {
+        /* the ring is only set once the port was added */
+        if(trace_port->ring != NULL) {
+            trace_add(TRACE_EXIT, trace_ring->pos, 0);
+#ifdef MIDI_HOST
+            trace_save_file();
+#endif
+            /* no dumper may look at the ring while it goes away */
+            Forbid();
+            RemPort(&trace_port->port);
+            Permit();
+        }
+        FreeVec(trace_port);
+        trace_port = NULL;
+    }
+
+    if(trace_ring != NULL) {
+        FreeVec(trace_ring);
+        trace_ring = NULL;
+    }
+
+    if(trace_eclock) {
+        eclock_exit();
+        trace_eclock = FALSE;
+    }
+}
+
+void trace_add(UWORD id, ULONG arg1, ULONG arg2)
+{
+    struct trace_ring *ring = trace_ring;
+    ULONG stamp;
+    ULONG pos;
+
+    if(ring == NULL) {
+        return;
+    }
+
+    stamp = eclock_stamp();
+
+    /* claim a slot. the 68000 has no atomic fetch and add but a task
+       switch is all that can get in between */
+#ifdef MIDI_HOST
+    pos = __atomic_fetch_add(&ring->pos, 1, __ATOMIC_RELAXED);
+#else
+    Forbid();
+    pos = ring->pos++;
+    Permit();
+#endif
+
+    /* the id is written last: a reader skips busy records */
+    struct trace_rec *rec = &ring->recs[pos & (TRACE_RING_SIZE - 1)];
+    rec->id = TRACE_BUSY;
+    rec->stamp = stamp;
+    rec->seq = (UWORD)pos;
+    rec->arg1 = arg1;
+    rec->arg2 = arg2;
+#ifdef MIDI_HOST
+    __atomic_store_n(&rec->id, id, __ATOMIC_RELEASE);
+#else
+    rec->id = id;
+#endif
+}
+
+#endif /* KTRACE */
@@ -0,0 +1,115 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * binary trace ring for the drivers
+ *
+ * Unlike D() a trace point only stores a fixed size record with an E-clock
+ * stamp and two args in memory. The ring is published with a public port
+ * and dumped by the midi-trace tool. Enable with KTRACE.
+ */
+
+#include <exec/ports.h>
+#include <dos/dos.h>
+
+/* records in the ring: must be a power of 2 */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE     2048
+#endif
+
+/* public port of the ring: "<driver name>.trace" */
+#define TRACE_PORT_POSTFIX  ".trace"
+
+#define TRACE_RING_MAGIC    0x4d545252  /* MTRR */
+#define TRACE_FILE_MAGIC    0x4d545244  /* MTRD */
+#define TRACE_FILE_VERSION  1
+
+/* events */
+#define TRACE_NONE          0
+#define TRACE_INIT          1   /* eclock freq, ring size */
+#define TRACE_EXIT          2   /* records written */
+#define TRACE_OPEN_PORT     3   /* port, task */
+#define TRACE_CLOSE_PORT    4   /* port, task */
+#define TRACE_ACTIVATE      5   /* port, task */
+#define TRACE_XMIT_BEGIN    6   /* port mask */
+#define TRACE_XMIT_END      7   /* port mask */
+#define TRACE_TX_MSG        8   /* port, msg */
+#define TRACE_TX_SYSEX      9   /* port, size */
+#define TRACE_RX_WAKE       10  /* got signals, got msg */
+#define TRACE_RX_MSG        11  /* port, msg */
+#define TRACE_RX_SYSEX      12  /* port, size */
+#define TRACE_RX_DONE       13  /* port */
+#define TRACE_UDP_TX_PKT    14  /* cmd, seq num */
+#define TRACE_UDP_RX_PKT    15  /* cmd, seq num */
+#define TRACE_NUM_EVENTS    16
+
+/* the id of a record that is still written */
+#define TRACE_BUSY          0xffff
+
+#define TRACE_EVENT_NAMES { \
+    "none", "init", "exit", "open_port", "close_port", "activate", \
+    "xmit_begin", "xmit_end", "tx_msg", "tx_sysex", "rx_wake", \
+    "rx_msg", "rx_sysex", "rx_done", "udp_tx_pkt", "udp_rx_pkt" }
+
+struct trace_rec {
+    ULONG   stamp;  /* E-clock ev_lo */
+    UWORD   id;
+    UWORD   seq;    /* low word of the ring position */
+    ULONG   arg1;
+    ULONG   arg2;
+};
+
+struct trace_ring {
+    ULONG           magic;
+    ULONG           size;
+    ULONG           eclock_freq;
+    volatile ULONG  pos;            /* records ever written */
+    struct trace_rec recs[TRACE_RING_SIZE];
+};
+
+struct trace_port {
+    struct MsgPort      port;
+    struct trace_ring   *ring;
+    char                name[32];
+};
+
+/* dump file: header, event names (NUL terminated, padded to 4 bytes)
+   and records. all in the byte order of the writer */
+struct trace_file_header {
+    ULONG   magic;
+    UWORD   version;
+    UWORD   num_events;
+    ULONG   eclock_freq;
+    ULONG   num_recs;
+};
+
+/* trace-file.c */
+extern ULONG trace_snapshot(struct trace_ring *ring, struct trace_rec *recs, ULONG max_recs);
+extern int trace_save(BPTR fh, ULONG eclock_freq, struct trace_rec *recs, ULONG num_recs);
+
+#ifdef KTRACE
+
+extern int  trace_init(STRPTR name);
+extern void trace_exit(void);
+extern void trace_add(UWORD id, ULONG arg1, ULONG arg2);
+
+/* args may be pointers: they are truncated on the host */
+#ifdef MIDI_HOST
+#define TRACE_ARG(x)    ((ULONG)(IPTR)(x))
+#else
+#define TRACE_ARG(x)    ((ULONG)(x))
+#endif
+
+#define T(id, a, b)     trace_add(id, TRACE_ARG(a), TRACE_ARG(b));
+#define T_INIT(name)    trace_init(name);
+#define T_EXIT()        trace_exit();
+
+#else
+
+#define T(id, a, b)
+#define T_INIT(name)
+#define T_EXIT()
+
+#endif /* KTRACE */
+
+#endif /* TRACE_H */
@@ -0,0 +1,104 @@
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <devices/timer.h>
+
+#include "midi-capture.h"
+
+int midi_capture_open_write(struct midi_capture *mc, char *file_name)
+{
+    mc->num_records = 0;
+    mc->fh = Open((STRPTR)file_name, MODE_NEWFILE);
+    if(mc->fh == NULL) {
+        return MIDI_CAPTURE_ERROR_OPEN;
+    }
+
+    struct midi_capture_header hdr = {
+        .magic = MIDI_CAPTURE_MAGIC,
+        .version = MIDI_CAPTURE_VERSION
+    };
+    if(FWrite(mc->fh, &hdr, sizeof(hdr), 1) != 1) {
+        midi_capture_close(mc);
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+    return MIDI_CAPTURE_OK;
+}
+
+int midi_capture_open_read(struct midi_capture *mc, char *file_name)
+{
+    mc->num_records = 0;
+    mc->fh = Open((STRPTR)file_name, MODE_OLDFILE);
+    if(mc->fh == NULL) {
+        return MIDI_CAPTURE_ERROR_OPEN;
+    }
+
+    struct midi_capture_header hdr;
+    if(FRead(mc->fh, &hdr, sizeof(hdr), 1) != 1) {
+        midi_capture_close(mc);
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+    if((hdr.magic != MIDI_CAPTURE_MAGIC) || (hdr.version != MIDI_CAPTURE_VERSION)) {
+        midi_capture_close(mc);
+        return MIDI_CAPTURE_ERROR_FORMAT;
+    }
+    return MIDI_CAPTURE_OK;
+}
+
+void midi_capture_close(struct midi_capture *mc)
+{
+    if(mc->fh != NULL) {
+        Close(mc->fh);
+        mc->fh = NULL;
+    }
+}
+
+int midi_capture_write(struct midi_capture *mc, struct timeval *tv,
+                       UBYTE port, UBYTE flags,
+                       UBYTE *data, ULONG size)
+{
+    struct midi_capture_record rec = {
+        .time_stamp = *tv,
+        .port = port,
+        .flags = flags,
+        .pad = 0,
+        .size = size
+    };
+
+    /* buffered write: only hits the disk when the dos buffer is full */
+    if(FWrite(mc->fh, &rec, sizeof(rec), 1) != 1) {
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+    if(FWrite(mc->fh, data, size, 1) != 1) {
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+    mc->num_records++;
+    return MIDI_CAPTURE_OK;
+}
+
+int midi_capture_read(struct midi_capture *mc,
+                      struct midi_capture_record *rec,
+                      UBYTE *buf, ULONG buf_size)
+{
+    LONG got = FRead(mc->fh, rec, sizeof(*rec), 1);
+    if(got == 0) {
+        return MIDI_CAPTURE_EOF;
+    }
+    else if(got != 1) {
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+
+    /* record does not fit: skip its data */
+    if(rec->size > buf_size) {
+        Flush(mc->fh);
+        if(Seek(mc->fh, rec->size, OFFSET_CURRENT) == -1) {
+            return MIDI_CAPTURE_ERROR_IO;
+        }
+        return MIDI_CAPTURE_ERROR_SIZE;
+    }
+
+    if(FRead(mc->fh, buf, rec->size, 1) != 1) {
+        return MIDI_CAPTURE_ERROR_IO;
+    }
+    mc->num_records++;
+    return MIDI_CAPTURE_OK;
+}
@@ -0,0 +1,58 @@
+#ifndef MIDI_CAPTURE_H
+#define MIDI_CAPTURE_H
+
+#include <devices/timer.h>
+
+/*
+ * capture file format (native byte order, i.e. big endian on the Amiga.
+ * a file of the other byte order fails the magic check):
+ *
+ * header: magic 'MCAP', version
+ * record: time stamp (secs, micros), port, flags, size, data bytes
+ *
+ * regular messages store 1..3 raw bytes. sysex stores the whole
+ * block including F0 and F7.
+ */
+
+#define MIDI_CAPTURE_MAGIC      0x4d434150 /* MCAP */
+#define MIDI_CAPTURE_VERSION    1
+
+#define MIDI_CAPTURE_FLAG_SYSEX 1
+
+#define MIDI_CAPTURE_OK             0
+#define MIDI_CAPTURE_EOF            1
+#define MIDI_CAPTURE_ERROR_OPEN     2
+#define MIDI_CAPTURE_ERROR_IO       3
+#define MIDI_CAPTURE_ERROR_FORMAT   4
+#define MIDI_CAPTURE_ERROR_SIZE     5
+
+struct midi_capture_header {
+    ULONG   magic;
+    ULONG   version;
+};
+
+struct midi_capture_record {
+    struct timeval  time_stamp;
+    UBYTE           port;
+    UBYTE           flags;
+    UWORD           pad;
+    ULONG           size;
+};
+
+struct midi_capture {
+    BPTR    fh;
+    ULONG   num_records;
+};
+
+extern int midi_capture_open_write(struct midi_capture *mc, char *file_name);
+extern int midi_capture_open_read(struct midi_capture *mc, char *file_name);
+extern void midi_capture_close(struct midi_capture *mc);
+
+extern int midi_capture_write(struct midi_capture *mc, struct timeval *tv,
+                              UBYTE port, UBYTE flags,
+                              UBYTE *data, ULONG size);
+extern int midi_capture_read(struct midi_capture *mc,
+                             struct midi_capture_record *rec,
+                             UBYTE *buf, ULONG buf_size);
+
+#endif
@@ -0,0 +1,389 @@
+#define USE_INLINE_STDARG
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/camd.h>
+#include <clib/alib_protos.h>
+
+#include <devices/timer.h>
+#include <midi/camd.h>
+#include <midi/mididefs.h>
+
+#include "drv/eclock.h"
+#include "midi-setup.h"
+#include "midi-tools.h"
+
+static const char *TEMPLATE =
+    "OUTDEV/A,"
+    "BPM/K,"
+    "TO=RAMPTO/K,"
+    "RB=RAMPBEATS/K/N,"
+    "SPP=SONGPOS/K/N,"
+    "CONT=CONTINUE/S,"
+    "BEATS/K/N,"
+    "PRI=PRIORITY/K/N,"
+    "V=VERBOSE/S";
+typedef struct {
+    char *out_dev;
+    char *bpm;
+    char *ramp_to;
+    ULONG *ramp_beats;
+    ULONG *song_pos;
+    LONG *cont;
+    ULONG *beats;
+    LONG *priority;
+    LONG *verbose;
+} params_t;
+static params_t params;
+
+struct DosLibrary *DOSBase;
+
+typedef union {
+    LONG  cmd;
+    UBYTE b[4];
+} MidiCmd;
+
+/* tempo is given in 0.1 BPM */
+#define TEMPO_MIN           100
+#define TEMPO_MAX           3000
+#define TEMPO_DEFAULT       1200
+#define CLOCKS_PER_BEAT     24
+#define CLOCKS_PER_SPP      6
+#define CLOCKS_PER_BAR      (4 * CLOCKS_PER_BEAT)
+/* the first clock leaves some time to set up */
+#define START_DELAY_US      10000
+#define DEFAULT_PRIORITY    20
+
+static BOOL verbose;
+static struct MidiSetup midi_setup;
+static struct MsgPort *clock_port;
+static struct timerequest *clock_req;
+
+/* schedule: absolute E-clock deadline of the next clock */
+static struct EClockVal deadline;
+static ULONG tempo;
+static ULONG period_ticks;
+static ULONG period_rem;
+static ULONG rem_acc;
+/* the timer wakes late by about this many ticks: ask earlier */
+static LONG lead;
+
+/* tempo ramp */
+static ULONG ramp_from;
+static ULONG ramp_to;
+static ULONG ramp_clocks;
+static ULONG ramp_pos;
+
+/* results */
+static ULONG num_clocks;
+static ULONG num_late;
+static LONG max_late;
+
+/* "120" or "120.5" to 0.1 BPM. 0 if invalid */
+static ULONG parse_tempo(char *str)
+{
+    ULONG val = 0;
+    int frac = -1;
+
+    while(*str != '\0') {
+        char c = *str++;
+        if((c == '.') && (frac < 0)) {
+            frac = 0;
+        }
+        else if((c >= '0') && (c <= '9') && (frac < 1) && (val < 100000)) {
+            val = val * 10 + (c - '0');
+            if(frac == 0) {
+                frac = 1;
+            }
+        }
+        else {
+            return 0;
+        }
+    }
+    if(frac != 1) {
+        val *= 10;
+    }
+    if((val < TEMPO_MIN) || (val > TEMPO_MAX)) {
+        return 0;
+    }
+    return val;
+}
+
+/* a clock lasts 60 / (24 * bpm) secs = freq * 25 / tempo ticks. the
+   remainder is carried over so no rounding error adds up */
+static void set_tempo(ULONG t)
+{
+    tempo = t;
+    period_ticks = (eclock_freq * 25) / t;
+    period_rem = (eclock_freq * 25) % t;
+    rem_acc %= t;
+}
+
+static void next_deadline(void)
+{
+    ULONG ticks = period_ticks;
+    rem_acc += period_rem;
+    if(rem_acc >= tempo) {
+        rem_acc -= tempo;
+        ticks++;
+    }
+    eclock_add(&deadline, ticks);
+
+    /* linear ramp in steps of a clock */
+    if(ramp_pos < ramp_clocks) {
+        ramp_pos++;
+        LONG delta = (LONG)ramp_to - (LONG)ramp_from;
+        set_tempo(ramp_from + (delta * (LONG)ramp_pos) / (LONG)ramp_clocks);
+    }
+}
+
+static void restart_schedule(void)
+{
+    eclock_read(&deadline);
+    eclock_add(&deadline, eclock_us_to_ticks(START_DELAY_US));
+    rem_acc = 0;
+}
+
+/* wait for the next deadline. returns the break signals received */
+static ULONG wait_deadline(void)
+{
+    ULONG port_mask = 1UL << clock_port->mp_SigBit;
+    ULONG break_mask = SIGBREAKF_CTRL_C | SIGBREAKF_CTRL_D;
+
+    struct EClockVal when = deadline;
+    eclock_sub(&when, (ULONG)lead);
+    clock_req->tr_node.io_Command = TR_ADDREQUEST;
+    clock_req->tr_time.tv_secs = when.ev_hi;
+    clock_req->tr_time.tv_micro = when.ev_lo;
+    SendIO((struct IORequest *)clock_req);
+
+    ULONG mask = Wait(port_mask | break_mask);
+    if(!CheckIO((struct IORequest *)clock_req)) {
+        AbortIO((struct IORequest *)clock_req);
+    }
+    WaitIO((struct IORequest *)clock_req);
+    return mask & break_mask;
+}
+
+/* measure how late the clock is and adapt the lead of the requests */
+static void update_lead(void)
+{
+    LONG late = (LONG)(eclock_stamp() - deadline.ev_lo);
+
+    if(late > max_late) {
+        max_late = late;
+    }
+    if(late > (LONG)(period_ticks / 2)) {
+        num_late++;
+    }
+
+    lead += late / 8;
+    if(lead < 0) {
+        lead = 0;
+    }
+    else if(lead > (LONG)(period_ticks / 4)) {
+        lead = period_ticks / 4;
+    }
+}
+
+static void put_msg(UBYTE status, UBYTE data1, UBYTE data2)
+{
+    MidiCmd mc;
+    mc.cmd = 0;
+    mc.mm_Status = status;
+    mc.mm_Data1 = data1;
+    mc.mm_Data2 = data2;
+    PutMidi(midi_setup.tx_link, mc.cmd);
+}
+
+static void show_pos(ULONG pos)
+{
+    ULONG bar = pos / CLOCKS_PER_BAR + 1;
+    ULONG beat = (pos % CLOCKS_PER_BAR) / CLOCKS_PER_BEAT + 1;
+    Printf("%4ld.%ld  tempo %3ld.%ld  lead %4ld us\n", bar, beat,
+        tempo / 10, tempo % 10, eclock_to_us((ULONG)lead));
+}
+
+static void run(ULONG song_pos, BOOL cont, ULONG max_clocks)
+{
+    /* position in clocks */
+    ULONG pos = song_pos * CLOCKS_PER_SPP;
+    BOOL paused = FALSE;
+
+    restart_schedule();
+    if(wait_deadline() & SIGBREAKF_CTRL_C) {
+        return;
+    }
+
+    /* Continue starts at the song position. Start always at the beginning */
+    if(song_pos > 0) {
+        put_msg(MS_SongPos, song_pos & 0x7f, (song_pos >> 7) & 0x7f);
+        put_msg(MS_Continue, 0, 0);
+    } else if(cont) {
+        put_msg(MS_Continue, 0, 0);
+    } else {
+        put_msg(MS_Start, 0, 0);
+    }
+
+    while(1) {
+        put_msg(MS_Clock, 0, 0);
+        update_lead();
+        num_clocks++;
+
+        if(verbose && ((pos % CLOCKS_PER_BAR) == 0)) {
+            show_pos(pos);
+        }
+        pos++;
+
+        if((max_clocks > 0) && (num_clocks >= max_clocks)) {
+            break;
+        }
+
+        next_deadline();
+        ULONG brk = wait_deadline();
+        if(brk & SIGBREAKF_CTRL_C) {
+            break;
+        }
+
+        /* pause: Stop keeps the position for the next Continue */
+        if(brk & SIGBREAKF_CTRL_D) {
+            put_msg(MS_Stop, 0, 0);
+            paused = TRUE;
+            PutStr("paused. ctrl-d to continue\n");
+            ULONG mask = Wait(SIGBREAKF_CTRL_C | SIGBREAKF_CTRL_D);
+            if(mask & SIGBREAKF_CTRL_C) {
+                break;
+            }
+            paused = FALSE;
+            restart_schedule();
+            if(wait_deadline() & SIGBREAKF_CTRL_C) {
+                break;
+            }
+            put_msg(MS_Continue, 0, 0);
+        }
+    }
+
+    if(!paused) {
+        put_msg(MS_Stop, 0, 0);
+    }
+}
+
+static int open_clock(void)
+{
+    clock_port = CreatePort(NULL, 0);
+    if(clock_port == NULL) {
+        return 1;
+    }
+    clock_req = (struct timerequest *)CreateExtIO(clock_port, sizeof(struct timerequest));
+    if(clock_req == NULL) {
+        DeletePort(clock_port);
+        return 2;
+    }
+    if(OpenDevice(TIMERNAME, UNIT_WAITECLOCK, (struct IORequest *)clock_req, 0L) != 0) {
+        DeleteExtIO((struct IORequest *)clock_req);
+        DeletePort(clock_port);
+        return 3;
+    }
+    return 0;
+}
+
+static void close_clock(void)
+{
+    CloseDevice((struct IORequest *)clock_req);
+    DeleteExtIO((struct IORequest *)clock_req);
+    DeletePort(clock_port);
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+    int result = RETURN_OK;
+
+    DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
+
+    /* First parse args */
+    args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+    if(args == NULL) {
+        PrintFault(IoErr(), "Args Error");
+        CloseLibrary((struct Library *)DOSBase);
+        return RETURN_ERROR;
+    }
+
+    ULONG start_tempo = TEMPO_DEFAULT;
+    if(params.bpm != NULL) {
+        start_tempo = parse_tempo(params.bpm);
+    }
+    ULONG end_tempo = start_tempo;
+    if(params.ramp_to != NULL) {
+        end_tempo = parse_tempo(params.ramp_to);
+    }
+    if((start_tempo == 0) || (end_tempo == 0)) {
+        PutStr("Invalid tempo! Give 10 to 300 BPM, e.g. 120 or 97.5\n");
+        FreeArgs(args);
+        CloseLibrary((struct Library *)DOSBase);
+        return RETURN_ERROR;
+    }
+    ULONG ramp_beats = 16;
+    if(params.ramp_beats != NULL) {
+        ramp_beats = *params.ramp_beats;
+    }
+    ULONG song_pos = 0;
+    if(params.song_pos != NULL) {
+        song_pos = *params.song_pos & 0x3fff;
+    }
+    ULONG max_clocks = 0;
+    if(params.beats != NULL) {
+        max_clocks = *params.beats * CLOCKS_PER_BEAT;
+    }
+    LONG priority = DEFAULT_PRIORITY;
+    if(params.priority != NULL) {
+        priority = *params.priority;
+    }
+    verbose = (params.verbose != NULL);
+
+    if(midi_tools_init_time() != 0) {
+        PutStr("ERROR: setting up timer!\n");
+        result = RETURN_FAIL;
+    }
+    else if(open_clock() != 0) {
+        PutStr("ERROR: opening E-clock timer!\n");
+        midi_tools_exit_time();
+        result = RETURN_FAIL;
+    }
+    else {
+        set_tempo(start_tempo);
+        if(end_tempo != start_tempo) {
+            ramp_from = start_tempo;
+            ramp_to = end_tempo;
+            ramp_clocks = ramp_beats * CLOCKS_PER_BEAT;
+        }
+
+        midi_setup.tx_name = params.out_dev;
+        midi_setup.midi_name = "midi-clock";
+        midi_setup.sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
+        if(midi_open(&midi_setup) == 0) {
+            Printf("midi-clock: out_dev='%s' tempo %ld.%ld BPM. ctrl-c to stop, ctrl-d to pause\n",
+                params.out_dev, start_tempo / 10, start_tempo % 10);
+
+            struct Task *me = FindTask(NULL);
+            BYTE old_pri = SetTaskPri(me, priority);
+
+            run(song_pos, params.cont != NULL, max_clocks);
+
+            SetTaskPri(me, old_pri);
+
+            Printf("%ld clocks, %ld late, max late %ld us\n",
+                num_clocks, num_late, eclock_to_us(max_late > 0 ? (ULONG)max_late : 0));
+        } else {
+            result = RETURN_ERROR;
+        }
+        midi_close(&midi_setup);
+
+        close_clock();
+        midi_tools_exit_time();
+    }
+
+    FreeArgs(args);
+    CloseLibrary((struct Library *)DOSBase);
+    return result;
+}
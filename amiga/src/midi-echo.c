@@ -5,32 +5,189 @@
 #include <proto/camd.h>
 
 #include <midi/camd.h>
+#include <midi/mididefs.h>
 #include <utility/tagitem.h>
+#include <utility/hooks.h>
 
+#include "drv/compiler.h"
 #include "midi-setup.h"
 
 static const char *TEMPLATE = 
    "IN/A,OUT/A,"
    "SMS/SYSEXMAXSIZE/K/N,"
+   "SBS=SYSEXBUFSIZE/K/N,"
+   "MQ=MSGQUEUE/K/N,"
+   "H=HOOK/S,"
    "V/VERBOSE/S";
 typedef struct {
     char *in_cluster;
     char *out_cluster;
     ULONG *sysex_max_size;
+    ULONG *sysex_buf_size;
+    ULONG *msg_queue;
+    LONG *hook;
     LONG *verbose;
 } params_t;
 static params_t params;
 
 struct DosLibrary *DOSBase;
 
-int main(int argc, char **argv)
+/* statistics */
+static volatile ULONG num_msgs;
+static volatile ULONG num_sysex;
+static volatile ULONG num_sysex_chunked;
+
+/* forward the current sysex of the node. it is staged in the sysex buffer
+   and sent as a whole if it fits. larger ones are passed in buffer sized
+   chunks through the parser of the tx link. */
+static void forward_sysex(struct MidiSetup *ms)
+{
+    ULONG size = QuerySysEx(ms->node);
+    if(size == 0) {
+        return;
+    }
+
+    if(size <= ms->sysex_buf_size) {
+        if(GetSysEx(ms->node, ms->sysex_buf, ms->sysex_buf_size) > 0) {
+            PutSysEx(ms->tx_link, ms->sysex_buf);
+            num_sysex++;
+        }
+        return;
+    }
+
+    while(size > 0) {
+        ULONG got = GetSysEx(ms->node, ms->sysex_buf, ms->sysex_buf_size);
+        if(got == 0) {
+            break;
+        }
+        ParseMidi(ms->tx_link, ms->sysex_buf, got);
+        size -= got;
+    }
+    num_sysex++;
+    num_sysex_chunked++;
+}
+
+/* forward in task: wake up on each batch of messages */
+static void echo_task(struct MidiSetup *ms)
 {
-    struct RDArgs *args;
-    struct MidiSetup ms;
     MidiMsg msg;
     BOOL alive = TRUE;
     ULONG sigmask;
 
+    while(alive) {
+        sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<ms->rx_sig);
+        if(sigmask & SIGBREAKF_CTRL_C)
+            alive=FALSE;
+        while(GetMidi(ms->node, &msg)) {
+            if(params.verbose) {
+                Printf("%08ld: %08lx\n", msg.mm_Time, msg.mm_Msg);
+            }
+            if(msg.mm_Status == MS_SysEx) {
+                forward_sysex(ms);
+            } else {
+                PutMidi(ms->tx_link, msg.mm_Msg);
+                num_msgs++;
+            }
+        }
+
+        /* report lost messages of the node */
+        UBYTE err = midi_check_errors(ms);
+        if(err != 0) {
+            midi_show_errors(err);
+        }
+    }
+}
+
+/* forward in receive hook: called in the context of the sender. messages
+   are sent directly while nothing is staged. sysex is bound to the queue
+   of the node and left to the task: its mark and all later messages are
+   staged in a ring until the task has sent it, which keeps the order */
+#define STAGE_RING_SIZE     256
+#define STAGE_RING_MASK     (STAGE_RING_SIZE - 1)
+
+static struct Hook hook;
+static struct Task *main_task;
+static MidiMsg stage_ring[STAGE_RING_SIZE];
+static volatile UWORD stage_put;
+static volatile UWORD stage_get;
+static volatile ULONG stage_overflows;
+
+static SAVEDS ASM ULONG echo_hook_func(REG(a0, struct Hook *hook),
+                                       REG(a2, struct MidiLink *link),
+                                       REG(a1, MidiMsg *msg))
+{
+    struct MidiSetup *ms = (struct MidiSetup *)hook->h_Data;
+
+    UWORD put = stage_put;
+    if((msg->mm_Status != MS_SysEx) && (put == stage_get)) {
+        PutMidi(ms->tx_link, msg->mm_Msg);
+        num_msgs++;
+        return 0;
+    }
+
+    UWORD next = (put + 1) & STAGE_RING_MASK;
+    if(next == stage_get) {
+        stage_overflows++;
+        return 0;
+    }
+    stage_ring[put] = *msg;
+    stage_put = next;
+
+    Signal(main_task, 1L << ms->rx_sig);
+    return 0;
+}
+
+/* an entry leaves the ring only after it was sent: until then the hook
+   keeps staging */
+static void flush_stage(struct MidiSetup *ms)
+{
+    MidiMsg msg;
+    UWORD get;
+
+    while((get = stage_get) != stage_put) {
+        if(stage_ring[get].mm_Status == MS_SysEx) {
+            if(GetMidi(ms->node, &msg)) {
+                forward_sysex(ms);
+            }
+        } else {
+            PutMidi(ms->tx_link, stage_ring[get].mm_Msg);
+            num_msgs++;
+        }
+        stage_get = (get + 1) & STAGE_RING_MASK;
+    }
+
+    /* sysex whose mark was lost to a ring overflow */
+    while(GetMidi(ms->node, &msg)) {
+        forward_sysex(ms);
+    }
+}
+
+/* forward in hook: the task only wakes up for sysex, node errors and
+   Ctrl-C */
+static void echo_hook(struct MidiSetup *ms)
+{
+    BOOL alive = TRUE;
+    ULONG sigmask;
+
+    while(alive) {
+        sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<ms->rx_sig);
+        if(sigmask & SIGBREAKF_CTRL_C)
+            alive=FALSE;
+        flush_stage(ms);
+
+        /* report lost messages of the node */
+        UBYTE err = midi_check_errors(ms);
+        if(err != 0) {
+            midi_show_errors(err);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+    struct MidiSetup ms;
+
     DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
 
     /* First parse args */
@@ -41,16 +198,41 @@ int main(int argc, char **argv)
     }
 
     /* max size for sysex */
-    ULONG sysex_max_size = 2048;
+    ULONG sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
     if(params.sysex_max_size != NULL) {
         sysex_max_size = *params.sysex_max_size;
     }
 
+    /* staging buffer for sysex. 0 for sysex_max_size */
+    ULONG sysex_buf_size = 0;
+    if(params.sysex_buf_size != NULL) {
+        sysex_buf_size = *params.sysex_buf_size;
+    }
+
+    /* depth of the node's message queue. 0 for default */
+    ULONG msg_queue = 0;
+    if(params.msg_queue != NULL) {
+        msg_queue = *params.msg_queue;
+    }
+
     /* midi open */
     ms.tx_name = params.out_cluster;
     ms.rx_name = params.in_cluster;
     ms.midi_name = "midi-echo";
     ms.sysex_max_size = sysex_max_size;
+    ms.msg_queue_size = msg_queue;
+    ms.sysex_buf_size = sysex_buf_size;
+    ms.rx_hook = NULL;
+    ms.rx_hook_only = FALSE;
+    ms.tx_parse = TRUE;
+    if(params.hook) {
+        main_task = FindTask(NULL);
+        hook.h_Entry = (HOOKFUNC)echo_hook_func;
+        hook.h_SubEntry = NULL;
+        hook.h_Data = &ms;
+        ms.rx_hook = &hook;
+        ms.rx_hook_only = TRUE;
+    }
     int res = midi_open(&ms);
     if(res != 0) {
         midi_close(&ms);
@@ -60,16 +242,22 @@ int main(int argc, char **argv)
     /* main loop */
     Printf("midi-echo: from '%s' to '%s' running. Press Ctrl+C to abort.\n",
         params.in_cluster, params.out_cluster);
-    while(alive) {
-        sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<ms.rx_sig);
-        if(sigmask & SIGBREAKF_CTRL_C)
-            alive=FALSE;
-        while(GetMidi(ms.node, &msg)) {
-            if(params.verbose) {
-                Printf("%08ld: %08lx\n", msg.mm_Time, msg.mm_Msg);
-            }
-            PutMidi(ms.tx_link, msg.mm_Msg);
-        }
+    if(params.hook) {
+        echo_hook(&ms);
+    } else {
+        echo_task(&ms);
+    }
+
+    if(params.verbose) {
+        Printf("forwarded %ld messages, %ld sysex (%ld in chunks)\n",
+               num_msgs, num_sysex, num_sysex_chunked);
+    }
+    if(stage_overflows > 0) {
+        Printf("hook buffer overflows: %ld\n", stage_overflows);
+    }
+    if(midi_num_errors(&ms) > 0) {
+        PutStr("CAMD node errors:\n");
+        midi_print_errors(&ms);
     }
 
     midi_close(&ms);
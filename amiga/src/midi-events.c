@@ -0,0 +1,243 @@
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <string.h>
+
+#include "midi-events.h"
+
+void midi_events_init(struct midi_events *me)
+{
+    me->first = NULL;
+    me->last = NULL;
+    me->num_events = 0;
+}
+
+void midi_events_free(struct midi_events *me)
+{
+    struct midi_event_block *block = me->first;
+    while(block != NULL) {
+        struct midi_event_block *next = block->next;
+        for(ULONG i=0;i<block->num;i++) {
+            if(block->events[i].sysex != NULL) {
+                FreeVec(block->events[i].sysex);
+            }
+        }
+        FreeVec(block);
+        block = next;
+    }
+    midi_events_init(me);
+}
+
+static struct midi_event *alloc_event(struct midi_events *me)
+{
+    struct midi_event_block *block = me->last;
+
+    /* need a new block? */
+    if((block == NULL) || (block->num == MIDI_EVENTS_BLOCK_SIZE)) {
+        block = AllocVec(sizeof(struct midi_event_block), MEMF_ANY);
+        if(block == NULL) {
+            return NULL;
+        }
+        block->next = NULL;
+        block->num = 0;
+        if(me->last != NULL) {
+            me->last->next = block;
+        } else {
+            me->first = block;
+        }
+        me->last = block;
+    }
+
+    struct midi_event *ev = &block->events[block->num];
+    block->num++;
+    me->num_events++;
+    return ev;
+}
+
+int midi_events_add_msg(struct midi_events *me, struct timeval *tv, ULONG msg)
+{
+    struct midi_event *ev = alloc_event(me);
+    if(ev == NULL) {
+        return 1;
+    }
+    ev->time = *tv;
+    ev->msg = msg;
+    ev->sysex = NULL;
+    ev->sysex_size = 0;
+    return 0;
+}
+
+int midi_events_add_sysex(struct midi_events *me, struct timeval *tv,
+                          UBYTE *data, ULONG size)
+{
+    UBYTE *copy = AllocVec(size, MEMF_ANY);
+    if(copy == NULL) {
+        return 1;
+    }
+    CopyMem(data, copy, size);
+
+    struct midi_event *ev = alloc_event(me);
+    if(ev == NULL) {
+        FreeVec(copy);
+        return 1;
+    }
+    ev->time = *tv;
+    ev->msg = 0;
+    ev->sysex = copy;
+    ev->sysex_size = size;
+    return 0;
+}
+
+/* move all events of other to the end of me and shift them by offset */
+void midi_events_append(struct midi_events *me, struct midi_events *other,
+                        struct timeval *offset)
+{
+    struct midi_event_block *block = other->first;
+    if(block == NULL) {
+        return;
+    }
+
+    while(block != NULL) {
+        struct midi_event *ev = block->events;
+        for(ULONG i=0;i<block->num;i++) {
+            AddTime(&ev->time, offset);
+            ev++;
+        }
+        block = block->next;
+    }
+
+    if(me->last != NULL) {
+        me->last->next = other->first;
+    } else {
+        me->first = other->first;
+    }
+    me->last = other->last;
+    me->num_events += other->num_events;
+
+    midi_events_init(other);
+}
+
+int midi_events_save(struct midi_events *me, char *file_name,
+                     struct timeval *end_time,
+                     struct midi_events_state *enter,
+                     struct midi_events_state *leave)
+{
+    BPTR fh = Open((STRPTR)file_name, MODE_NEWFILE);
+    if(fh == NULL) {
+        return MIDI_EVENTS_ERROR_OPEN;
+    }
+
+    int ret_code = MIDI_EVENTS_OK;
+    struct midi_events_header hdr = {
+        .magic = MIDI_EVENTS_MAGIC,
+        .version = MIDI_EVENTS_VERSION,
+        .num_events = me->num_events,
+        .end_time = *end_time,
+        .enter = *enter,
+        .leave = *leave
+    };
+    if(FWrite(fh, &hdr, sizeof(hdr), 1) != 1) {
+        ret_code = MIDI_EVENTS_ERROR_IO;
+    }
+
+    struct midi_event_block *block = me->first;
+    while((block != NULL) && (ret_code == MIDI_EVENTS_OK)) {
+        struct midi_event *ev = block->events;
+        for(ULONG i=0;i<block->num;i++) {
+            struct midi_events_record rec = {
+                .time = ev->time,
+                .msg = ev->msg,
+                .sysex_size = ev->sysex_size
+            };
+            if(FWrite(fh, &rec, sizeof(rec), 1) != 1) {
+                ret_code = MIDI_EVENTS_ERROR_IO;
+                break;
+            }
+            if(ev->sysex_size > 0) {
+                if(FWrite(fh, ev->sysex, ev->sysex_size, 1) != 1) {
+                    ret_code = MIDI_EVENTS_ERROR_IO;
+                    break;
+                }
+            }
+            ev++;
+        }
+        block = block->next;
+    }
+
+    Close(fh);
+
+    /* do not leave a broken file behind */
+    if(ret_code != MIDI_EVENTS_OK) {
+        DeleteFile((STRPTR)file_name);
+    }
+    return ret_code;
+}
+
+int midi_events_load(struct midi_events *me, char *file_name,
+                     struct timeval *end_time,
+                     struct midi_events_state *enter,
+                     struct midi_events_state *leave)
+{
+    BPTR fh = Open((STRPTR)file_name, MODE_OLDFILE);
+    if(fh == NULL) {
+        return MIDI_EVENTS_ERROR_OPEN;
+    }
+
+    struct midi_events_header hdr;
+    if(FRead(fh, &hdr, sizeof(hdr), 1) != 1) {
+        Close(fh);
+        return MIDI_EVENTS_ERROR_IO;
+    }
+    if((hdr.magic != MIDI_EVENTS_MAGIC) || (hdr.version != MIDI_EVENTS_VERSION)) {
+        Close(fh);
+        return MIDI_EVENTS_ERROR_FORMAT;
+    }
+    if(memcmp(&hdr.enter, enter, sizeof(hdr.enter)) != 0) {
+        Close(fh);
+        return MIDI_EVENTS_ERROR_STATE;
+    }
+
+    int ret_code = MIDI_EVENTS_OK;
+    for(ULONG i=0;i<hdr.num_events;i++) {
+        struct midi_events_record rec;
+        if(FRead(fh, &rec, sizeof(rec), 1) != 1) {
+            ret_code = MIDI_EVENTS_ERROR_IO;
+            break;
+        }
+
+        struct midi_event *ev = alloc_event(me);
+        if(ev == NULL) {
+            ret_code = MIDI_EVENTS_ERROR_NO_MEM;
+            break;
+        }
+        ev->time = rec.time;
+        ev->msg = rec.msg;
+        ev->sysex = NULL;
+        ev->sysex_size = 0;
+
+        if(rec.sysex_size > 0) {
+            ev->sysex = AllocVec(rec.sysex_size, MEMF_ANY);
+            if(ev->sysex == NULL) {
+                ret_code = MIDI_EVENTS_ERROR_NO_MEM;
+                break;
+            }
+            ev->sysex_size = rec.sysex_size;
+            if(FRead(fh, ev->sysex, rec.sysex_size, 1) != 1) {
+                ret_code = MIDI_EVENTS_ERROR_IO;
+                break;
+            }
+        }
+    }
+
+    Close(fh);
+
+    if(ret_code == MIDI_EVENTS_OK) {
+        *end_time = hdr.end_time;
+        *leave = hdr.leave;
+    } else {
+        midi_events_free(me);
+    }
+    return ret_code;
+}
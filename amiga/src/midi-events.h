@@ -0,0 +1,90 @@
+#ifndef MIDI_EVENTS_H
+#define MIDI_EVENTS_H
+
+#include <devices/timer.h>
+
+/* a list of timed midi events that can be built up front and played later */
+
+#define MIDI_EVENTS_BLOCK_SIZE  256
+
+/*
+ * compiled event file (native byte order):
+ *
+ * header: magic 'MEVT', version, number of events, end time of schedule,
+ *         command state before and after the commands
+ * event:  time stamp (secs, micros), midi msg, sysex size, sysex bytes
+ */
+#define MIDI_EVENTS_MAGIC       0x4d455654 /* MEVT */
+#define MIDI_EVENTS_VERSION     3
+
+#define MIDI_EVENTS_OK              0
+#define MIDI_EVENTS_ERROR_NO_MEM    1
+#define MIDI_EVENTS_ERROR_OPEN      2
+#define MIDI_EVENTS_ERROR_IO        3
+#define MIDI_EVENTS_ERROR_FORMAT    4
+#define MIDI_EVENTS_ERROR_STATE     5
+
+/* command state the events were compiled with. absolute time stamps
+   are scheduled from the last time stamp */
+struct midi_events_state {
+    ULONG   channel;
+    ULONG   hex_mode;
+    ULONG   octave_middle_c;
+    LONG    last_timestamp;
+};
+
+struct midi_events_header {
+    ULONG                       magic;
+    ULONG                       version;
+    ULONG                       num_events;
+    struct timeval              end_time;
+    struct midi_events_state    enter;
+    struct midi_events_state    leave;
+};
+
+struct midi_events_record {
+    struct timeval  time;
+    ULONG           msg;
+    ULONG           sysex_size;
+};
+
+struct midi_event {
+    struct timeval  time;
+    ULONG           msg;
+    UBYTE          *sysex;
+    ULONG           sysex_size;
+};
+
+struct midi_event_block {
+    struct midi_event_block *next;
+    ULONG                    num;
+    struct midi_event        events[MIDI_EVENTS_BLOCK_SIZE];
+};
+
+struct midi_events {
+    struct midi_event_block *first;
+    struct midi_event_block *last;
+    ULONG                    num_events;
+};
+
+extern void midi_events_init(struct midi_events *me);
+extern void midi_events_free(struct midi_events *me);
+
+extern int midi_events_add_msg(struct midi_events *me, struct timeval *tv, ULONG msg);
+extern int midi_events_add_sysex(struct midi_events *me, struct timeval *tv,
+                                 UBYTE *data, ULONG size);
+extern void midi_events_append(struct midi_events *me, struct midi_events *other,
+                               struct timeval *offset);
+
+extern int midi_events_save(struct midi_events *me, char *file_name,
+                            struct timeval *end_time,
+                            struct midi_events_state *enter,
+                            struct midi_events_state *leave);
+/* fails with MIDI_EVENTS_ERROR_STATE if the file was compiled with another
+   enter state. returns the leave state */
+extern int midi_events_load(struct midi_events *me, char *file_name,
+                            struct timeval *end_time,
+                            struct midi_events_state *enter,
+                            struct midi_events_state *leave);
+
+#endif
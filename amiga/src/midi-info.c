@@ -2,14 +2,162 @@
 #include <proto/dos.h>
 #include <proto/camd.h>
 
+#include <exec/execbase.h>
 #include <midi/camd.h>
 
+#include <string.h>
+
+#include "drv/eclock.h"
+#include "drv/midi-drv-stats.h"
+
+static const char *TEMPLATE =
+   "DRV=DRIVER,"
+   "S=STATS/S,"
+   "R=RESET/S";
+typedef struct {
+  char *driver;
+  LONG stats;
+  LONG reset;
+} params_t;
+static params_t params;
+
 struct Library *CamdBase;
 struct DosLibrary *DOSBase;
 
+#define MAX_DRIVERS 8
+
+struct drv_stats {
+    char name[32];
+    struct midi_drv_stats stats;
+};
+static struct drv_stats drv_stats[MAX_DRIVERS];
+
+/* DRIVER is the task name of the driver, e.g. 'midi.udp', or just 'udp' */
+static BOOL match_driver(const char *task_name, const char *driver)
+{
+    if(driver == NULL) {
+        return TRUE;
+    }
+    if(strcmp(task_name, driver) == 0) {
+        return TRUE;
+    }
+    if((strncmp(task_name, "midi.", 5) == 0) && (strcmp(task_name + 5, driver) == 0)) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* copy the stats of all matching drivers. the drivers remove their port
+   under Forbid() so no printing in here */
+static int collect_stats(const char *driver, BOOL reset)
+{
+    struct Node *node;
+    int num = 0;
+    int postfix_len = strlen(MIDI_DRV_STATS_PORT_POSTFIX);
+
+    Forbid();
+    for(node = SysBase->PortList.lh_Head; node->ln_Succ != NULL; node = node->ln_Succ) {
+        if(node->ln_Name == NULL) {
+            continue;
+        }
+        int len = strlen(node->ln_Name) - postfix_len;
+        if((len <= 0) || (len >= sizeof(drv_stats[0].name)) ||
+           (strcmp(node->ln_Name + len, MIDI_DRV_STATS_PORT_POSTFIX) != 0)) {
+            continue;
+        }
+
+        struct midi_drv_stats_port *sp = (struct midi_drv_stats_port *)node;
+        if(sp->magic != MIDI_DRV_STATS_PORT_MAGIC) {
+            continue;
+        }
+        struct midi_drv_stats *stats = sp->stats;
+        if((stats->magic != MIDI_DRV_STATS_MAGIC) || (stats->version != MIDI_DRV_STATS_VERSION)) {
+            continue;
+        }
+
+        struct drv_stats *ds = &drv_stats[num];
+        CopyMem(node->ln_Name, ds->name, len);
+        ds->name[len] = '\0';
+        if(!match_driver(ds->name, driver)) {
+            continue;
+        }
+
+        CopyMem(stats, &ds->stats, sizeof(struct midi_drv_stats));
+        if(reset) {
+            memset((UBYTE *)stats + MIDI_DRV_STATS_RESET_OFFSET, 0,
+                   sizeof(struct midi_drv_stats) - MIDI_DRV_STATS_RESET_OFFSET);
+        }
+
+        num++;
+        if(num == MAX_DRIVERS) {
+            break;
+        }
+    }
+    Permit();
+
+    return num;
+}
+
+static void print_stats(struct drv_stats *ds)
+{
+    struct midi_drv_stats *s = &ds->stats;
+    int i;
+
+    Printf("Driver: %s\n", ds->name);
+    Printf("  Wakeups: %lu  Xmit runs: %lu  Max drain: %lu us\n",
+        s->wakeups, s->xmit_runs, eclock_ticks_to_us(s->max_drain, s->eclock_freq));
+    Printf("  Net drops: %lu  Net tx errors: %lu  Seq gaps: %lu\n",
+        s->net_drops, s->net_tx_errors, s->seq_gaps);
+    PutStr("  Port     TxMsg   TxBytes TxSysEx     RxMsg   RxBytes RxSysEx ParseErr  Trunc\n");
+    for(i=0;(i<s->num_ports) && (i<MIDI_DRV_STATS_NUM_PORTS);i++) {
+        struct midi_drv_port_stats *ps = &s->ports[i];
+        if((ps->tx_bytes == 0) && (ps->rx_bytes == 0)) {
+            continue;
+        }
+        Printf("  %4ld %9lu %9lu %7lu %9lu %9lu %7lu %8lu %6lu\n",
+            (LONG)i, ps->tx_msgs, ps->tx_bytes, ps->tx_sysex,
+            ps->rx_msgs, ps->rx_bytes, ps->rx_sysex,
+            ps->parse_errors, ps->sysex_truncated);
+    }
+}
+
+static void show_stats(const char *driver, BOOL reset)
+{
+    int num = collect_stats(driver, reset);
+    if(num == 0) {
+        PutStr("No driver stats found.\n");
+        return;
+    }
+    for(int i=0;i<num;i++) {
+        print_stats(&drv_stats[i]);
+    }
+    if(reset) {
+        PutStr("Stats reset.\n");
+    }
+}
+
 int main(int argc, char **argv)
 {
+    struct RDArgs *args;
+
     DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
+
+    /* First parse args */
+    args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+    if(args == NULL) {
+        PrintFault(IoErr(), "Args Error");
+        CloseLibrary((struct Library *)DOSBase);
+        return RETURN_ERROR;
+    }
+
+    /* only the driver stats */
+    if(params.stats || params.reset) {
+        show_stats(params.driver, params.reset);
+        FreeArgs(args);
+        CloseLibrary((struct Library *)DOSBase);
+        return 0;
+    }
+
     CamdBase = OpenLibrary((UBYTE *)"camd.library", 0L);
     if(CamdBase != NULL) {
         struct MidiCluster *cluster;
@@ -76,6 +224,7 @@ int main(int argc, char **argv)
     } else {
         PutStr("Error opening 'camd.library'!\n");
     }
+    FreeArgs(args);
     CloseLibrary((struct Library *)DOSBase);
     return 0;
 }
\ No newline at end of file
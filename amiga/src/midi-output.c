@@ -0,0 +1,96 @@
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <devices/timer.h>
+#include <stdarg.h>
+
+#include "drv/compiler.h"
+#include "midi-output.h"
+
+static UBYTE *out_buf;
+static ULONG  out_size;
+static ULONG  out_pos;
+
+int midi_output_init(ULONG buf_size)
+{
+    out_pos = 0;
+    out_size = buf_size;
+    if(buf_size == 0) {
+        return 1;
+    }
+    out_buf = AllocVec(buf_size, 0);
+    if(out_buf == NULL) {
+        return 1;
+    }
+    return 0;
+}
+
+void midi_output_exit(void)
+{
+    if(out_buf != NULL) {
+        midi_output_flush();
+        FreeVec(out_buf);
+        out_buf = NULL;
+    }
+}
+
+void midi_output_flush(void)
+{
+    if(out_pos > 0) {
+        Write(Output(), out_buf, out_pos);
+        out_pos = 0;
+    }
+}
+
+static void put_char(char ch)
+{
+    if(out_pos == out_size) {
+        midi_output_flush();
+    }
+    out_buf[out_pos++] = ch;
+}
+
+SAVEDS ASM static void fmt_putch(REG(d0, char ch), REG(a3, APTR data))
+{
+    /* RawDoFmt also emits the terminating zero */
+    if(ch != '\0') {
+        put_char(ch);
+    }
+}
+
+void midi_output_str(char *str)
+{
+    if(out_buf == NULL) {
+        PutStr(str);
+        return;
+    }
+    while(*str != '\0') {
+        put_char(*str++);
+    }
+}
+
+void midi_output_printf(char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    if(out_buf == NULL) {
+        VPrintf(fmt, (LONG *)ap);
+    } else {
+        RawDoFmt(fmt, ap, fmt_putch, NULL);
+    }
+    va_end(ap);
+}
+
+void midi_output_time(struct timeval *tv)
+{
+    ULONG secs = tv->tv_secs;
+    ULONG mins = secs / 60;
+    secs -= mins * 60;
+    ULONG hours = mins / 60;
+    mins -= hours * 60;
+
+    ULONG us = tv->tv_micro;
+    ULONG ms = us / 1000;
+    midi_output_printf("%02ld:%02ld:%02ld.%03ld", hours, mins, secs, ms);
+}
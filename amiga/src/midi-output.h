@@ -0,0 +1,21 @@
+#ifndef MIDI_OUTPUT_H
+#define MIDI_OUTPUT_H
+
+#include <devices/timer.h>
+
+/*
+ * buffered console output: text is rendered into a memory buffer and
+ * written with a single Write() on flush or if the buffer is full.
+ */
+
+#define MIDI_OUTPUT_DEFAULT_BUF_SIZE    4096
+
+extern int  midi_output_init(ULONG buf_size);
+extern void midi_output_exit(void);
+
+extern void midi_output_str(char *str);
+extern void midi_output_printf(char *fmt, ...);
+extern void midi_output_time(struct timeval *tv);
+extern void midi_output_flush(void);
+
+#endif
@@ -8,9 +8,11 @@
 
 #include <midi/camd.h>
 #include <midi/mididefs.h>
+#include <utility/hooks.h>
 
 #include "drv/compiler.h"
 #include "drv/debug.h"
+#include "drv/eclock.h"
 #include "midi-setup.h"
 #include "midi-tools.h"
 
@@ -20,19 +22,27 @@ static void task_shutdown(void);
 static const char *TEMPLATE =
     "V=VERBOSE/S,"
     "SMS=SYSEXMAXSIZE/K/N,"
-    "OUTDEV/A,"
+    "MQ=MSGQUEUE/K/N,"
+    "OUTDEV,"
     "INDEV/A,"
     "LD=LOOPDELAY/K/N,"
     "SD=SAMPLEDELAY/K/N,"
-    "NUM/K/N";
+    "NUM/K/N,"
+    "C=CLOCK/S,"
+    "BPM/K/N,"
+    "L=LISTEN/S";
 typedef struct {
     LONG *verbose;
     ULONG *sysex_max_size;
+    ULONG *msg_queue;
     char *out_dev;
     char *in_dev;
     ULONG *loop_delay;
     ULONG *sample_delay;
     ULONG *num_msgs;
+    LONG *clock;
+    ULONG *bpm;
+    LONG *listen;
 } params_t;
 
 extern struct ExecBase *SysBase;
@@ -42,7 +52,8 @@ static params_t params;
 static BOOL verbose = FALSE;
 static struct MidiSetup midi_setup_tx;
 static struct MidiSetup midi_setup_rx;
-static ULONG sysex_max_size = 2048;
+static ULONG sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
+static ULONG msg_queue = 0; /* 0 for default */
 
 // task
 static BYTE main_sig;
@@ -58,9 +69,10 @@ typedef union {
 
 typedef struct {
     MidiCmd    cmd;
-    struct timeval  ts_send;
-    struct timeval  ts_recv;
-    ULONG           delta_us;
+    ULONG      ts_send;     /* E-clock ticks */
+    ULONG      ts_recv;
+    ULONG      delta_us;
+    BOOL       received;
 } Sample;
 
 typedef struct {
@@ -74,8 +86,26 @@ static ULONG loop_delay = 1; // in seconds
 static ULONG sample_delay = 1000; // in us
 static ULONG num_msgs = 256;
 static ULONG num_lost;
+static ULONG num_node_errors;
 static Sample *samples;
 
+// clock jitter
+typedef struct {
+    ULONG       num;        /* number of intervals */
+    ULONG       period;     /* mean interval in us */
+    ULONG       stddev;
+    ULONG       max_dev;    /* largest distance of an interval to the mean */
+    LONG        drift;      /* total time minus the ideal time in us */
+} ClockStats;
+
+static BOOL clock_mode = FALSE;
+static BOOL listen_mode = FALSE;
+static ULONG bpm = 0; /* 0 in listen mode: not known */
+static ULONG *clock_tx;
+static ULONG *clock_rx;
+static volatile ULONG clock_rx_num;
+static struct Hook clock_hook;
+
 
 static Sample *create_samples_note_sweep(void)
 {
@@ -112,8 +142,8 @@ static void reset_samples(Sample *samples)
 {
     Sample *smp= samples;
     for(ULONG i=0;i<num_msgs;i++) {
-        smp->ts_recv.tv_secs = 0;
-        smp->ts_recv.tv_micro = 0;
+        smp->received = FALSE;
+        smp++;
     }
 }
 
@@ -126,16 +156,8 @@ static void calc_sample_delta(Sample *samples, ULONG num)
 {
     Sample *smp = samples;
     for(ULONG i=0;i<num;i++) {
-        struct timeval delta = smp->ts_recv;
-        // valid sample rx time?
-        if((delta.tv_secs > 0) && (delta.tv_micro > 0)) {
-            SubTime(&delta, &smp->ts_send);
-
-            // limit to micros
-            smp->delta_us = delta.tv_micro;
-            if(delta.tv_secs > 0) {
-                smp->delta_us += delta.tv_secs * 1000000UL;
-            }
+        if(smp->received) {
+            smp->delta_us = eclock_to_us(smp->ts_recv - smp->ts_send);
         } else {
             smp->delta_us = 0;
         }
@@ -153,7 +175,7 @@ static void calc_sample_stats(Sample *samples, ULONG num_msgs, Statistics *stats
     Sample *smp = samples;
     for(ULONG i=0;i<num_msgs;i++) {
         ULONG delta = smp->delta_us;
-        if(delta > 0) {
+        if(smp->received) {
             if(delta < min) {
                 min = delta;
             }
@@ -185,7 +207,7 @@ static int benchmark_samples(Sample *samples, ULONG num_samples)
 
     Sample *smp = samples;
     for(int i=0;i<num_samples;i++) {
-        GetSysTime(&smp->ts_send);
+        smp->ts_send = eclock_stamp();
         PutMidi(midi_setup_tx.tx_link, smp->cmd.l);
         smp++;
         if(sample_delay > 0) {
@@ -211,9 +233,256 @@ static int benchmark_samples(Sample *samples, ULONG num_samples)
     Printf("min=%6ld, max=%6ld, avg=%6ld  (#%ld)\n",
         stats.min, stats.max, stats.avg, stats.num);
 
+    // show new errors of the rx node to tell apart node and driver losses
+    ULONG node_errors = midi_num_errors(&midi_setup_rx);
+    if(node_errors != num_node_errors) {
+        num_node_errors = node_errors;
+        PutStr("rx node errors:\n");
+        midi_print_errors(&midi_setup_rx);
+    }
+
+    return 0;
+}
+
+static ULONG isqrt(ULONG val)
+{
+    ULONG res = 0;
+    ULONG bit = 1UL << 30;
+    while(bit > val) {
+        bit >>= 2;
+    }
+    while(bit != 0) {
+        if(val >= res + bit) {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+/* ideal time of num clocks at 24 PPQN in us. split to avoid rounding
+   errors that would show up as drift */
+static ULONG clock_ideal_us(ULONG num)
+{
+    return (num / bpm) * 2500000UL + ((num % bpm) * 2500000UL) / bpm;
+}
+
+/* receive hook: stamp each clock in the context of the sender */
+static SAVEDS ASM ULONG clock_hook_func(REG(a0, struct Hook *hook),
+                                        REG(a2, struct MidiLink *link),
+                                        REG(a1, MidiMsg *msg))
+{
+    if(msg->mm_Status != MS_Clock) {
+        return 0;
+    }
+
+    ULONG stamp = eclock_stamp();
+
+    ULONG num = clock_rx_num;
+    if(num >= num_msgs) {
+        return 0;
+    }
+    /* a pause of a passive clock source starts over */
+    if(listen_mode && (num > 0) && (stamp - clock_rx[num - 1] > eclock_freq)) {
+        num = 0;
+    }
+    clock_rx[num++] = stamp;
+    clock_rx_num = num;
+    if(num == num_msgs) {
+        Signal(main_task, 1 << main_sig);
+    }
     return 0;
 }
 
+static void calc_clock_stats(ULONG *stamps, ULONG num, ClockStats *stats)
+{
+    stats->num = 0;
+    if(num < 2) {
+        return;
+    }
+
+    ULONG num_iv = num - 1;
+    ULONG total = eclock_to_us(stamps[num - 1] - stamps[0]);
+    ULONG mean = total / num_iv;
+    ULONG var = 0;
+    ULONG max_dev = 0;
+    for(ULONG i=0;i<num_iv;i++) {
+        ULONG delta = eclock_to_us(stamps[i + 1] - stamps[i]);
+        ULONG dev = (delta > mean) ? delta - mean : mean - delta;
+        if(dev > max_dev) {
+            max_dev = dev;
+        }
+        if(dev > 0xffff) {
+            dev = 0xffff;
+        }
+        var += (dev * dev) / num_iv;
+    }
+
+    stats->num = num_iv;
+    stats->period = mean;
+    stats->stddev = isqrt(var);
+    stats->max_dev = max_dev;
+    stats->drift = 0;
+    if(bpm > 0) {
+        stats->drift = (LONG)total - (LONG)clock_ideal_us(num_iv);
+    }
+}
+
+static void print_clock_stats(const char *prefix, ClockStats *stats)
+{
+    if(stats->num == 0) {
+        Printf("%s: too few clocks\n", prefix);
+        return;
+    }
+
+    ULONG tempo = 0;
+    if(stats->period > 0) {
+        tempo = 25000000UL / stats->period;
+    }
+    Printf("%s: tempo=%3ld.%ld period=%6ld stddev=%6ld maxdev=%6ld",
+        prefix, tempo / 10, tempo % 10, stats->period, stats->stddev, stats->max_dev);
+    if(bpm > 0) {
+        LONG drift = stats->drift;
+        char *sign = "+";
+        if(drift < 0) {
+            drift = -drift;
+            sign = "-";
+        }
+        ULONG ideal_ms = clock_ideal_us(stats->num) / 1000;
+        ULONG ppm = 0;
+        if(ideal_ms > 0) {
+            ppm = ((ULONG)drift * 1000) / ideal_ms;
+        }
+        Printf(" drift=%s%ld (%s%ld ppm)", sign, drift, sign, ppm);
+    }
+    Printf("  (#%ld)\n", stats->num);
+}
+
+static int clock_round(void)
+{
+    ULONG main_mask = 1 << main_sig;
+    ULONG num_sent = 0;
+
+    SetSignal(0, main_mask);
+    clock_rx_num = 0;
+
+    if(!listen_mode) {
+        if(verbose)
+            Printf("sending %ld clocks at %ld BPM...\n", num_msgs, bpm);
+
+        /* absolute deadlines: a late clock does not delay the next ones */
+        struct timeval start;
+        midi_tools_get_time(&start);
+        for(num_sent=0;num_sent<num_msgs;num_sent++) {
+            ULONG off = clock_ideal_us(num_sent);
+            struct timeval tv = start;
+            struct timeval delta = { off / 1000000, off % 1000000 };
+            AddTime(&tv, &delta);
+            midi_tools_wait_until(&tv);
+
+            MidiCmd cmd;
+            cmd.l = 0;
+            cmd.mm_Status = MS_Clock;
+            PutMidi(midi_setup_tx.tx_link, cmd.l);
+
+            clock_tx[num_sent] = eclock_stamp();
+
+            if(SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C) {
+                return 2;
+            }
+        }
+        if(verbose)
+            PutStr("waiting for incoming clocks...\n");
+    }
+
+    /* the sender gives the late clocks some time. a passive source
+       has all the time it needs */
+    ULONG tick_mask = 0;
+    if(!listen_mode) {
+        tick_mask = midi_tools_start_tick(500000);
+    }
+    ULONG mask = Wait(main_mask | tick_mask | SIGBREAKF_CTRL_C);
+    midi_tools_stop_tick();
+    if((mask & SIGBREAKF_CTRL_C) == SIGBREAKF_CTRL_C) {
+        return 2;
+    }
+
+    /* stop the hook */
+    ULONG num_rx = clock_rx_num;
+    clock_rx_num = num_msgs;
+
+    ClockStats stats;
+    if(!listen_mode) {
+        calc_clock_stats(clock_tx, num_sent, &stats);
+        print_clock_stats("tx", &stats);
+        if(num_rx == 0) {
+            PutStr("All clocks lost... aborting!\n");
+            return 1;
+        }
+    }
+    calc_clock_stats(clock_rx, num_rx, &stats);
+    print_clock_stats("rx", &stats);
+    if(num_rx < num_sent) {
+        Printf("lost: %ld\n", num_sent - num_rx);
+    }
+
+    ULONG node_errors = midi_num_errors(&midi_setup_rx);
+    if(node_errors != num_node_errors) {
+        num_node_errors = node_errors;
+        PutStr("rx node errors:\n");
+        midi_print_errors(&midi_setup_rx);
+    }
+
+    return 0;
+}
+
+static void clock_loop(void)
+{
+    if(num_msgs < 2) {
+        num_msgs = 2;
+    }
+    clock_tx = (ULONG *)AllocVec(num_msgs * sizeof(ULONG) * 2, MEMF_ANY | MEMF_CLEAR);
+    if(clock_tx == NULL) {
+        PutStr("Error allocating clock samples!\n");
+        return;
+    }
+    clock_rx = clock_tx + num_msgs;
+
+    /* the hook stays idle until a round starts */
+    clock_rx_num = num_msgs;
+    clock_hook.h_Entry = (HOOKFUNC)clock_hook_func;
+    midi_setup_rx.rx_hook = &clock_hook;
+
+    if(task_setup()!=0) {
+        PutStr("Error setting up worker!\n");
+        FreeVec(clock_tx);
+        return;
+    }
+
+    while(1) {
+        int result = clock_round();
+        if(result != 0) {
+            PutStr("stopping...\n");
+            break;
+        }
+
+        if((loop_delay > 0) && !listen_mode) {
+            midi_tools_wait_time(loop_delay, 0);
+        }
+    }
+
+    /* a break leaves the hook running: stop it and drop its signal so
+       it is not taken for the worker shutdown */
+    clock_rx_num = num_msgs;
+    SetSignal(0, 1 << main_sig);
+
+    task_shutdown();
+    FreeVec(clock_tx);
+}
+
 static void main_loop(void)
 {
     // create samples
@@ -265,8 +534,18 @@ static void worker_loop(void)
         if((got_sig & midi_mask) == midi_mask) {
             // get midi messages
             MidiMsg msg;
+            if(clock_mode) {
+                // the hook did the stamping
+                while(GetMidi(midi_setup_rx.node, &msg)) {
+                    if(msg.mm_Status == MS_SysEx) {
+                        SkipSysEx(midi_setup_rx.node);
+                    }
+                }
+                midi_check_errors(&midi_setup_rx);
+                continue;
+            }
             while(GetMidi(midi_setup_rx.node, &msg)) {
-                GetSysTime(&smp->ts_recv);
+                ULONG ts_recv = eclock_stamp();
                 //D(("#%ld RX: %08lx: %08lx\n", got_msgs, msg.mm_Time, msg.mm_Msg));
 
                 // search msg
@@ -274,6 +553,8 @@ static void worker_loop(void)
                     // check message
                     if(msg.l[0] == smp->cmd.l) {
                         //D(("match: %08lx\n", msg.l[0]))
+                        smp->ts_recv = ts_recv;
+                        smp->received = TRUE;
                         got_msgs++;
                         smp++;
                         break;
@@ -287,6 +568,7 @@ static void worker_loop(void)
                 // all done report back
                 if(got_msgs == num_msgs) {
                     num_lost = my_lost;
+                    midi_check_errors(&midi_setup_rx);
                     D(("worker: done: lost=%ld\n", num_lost));
                     Signal(main_task, 1 << main_sig);
 
@@ -298,6 +580,9 @@ static void worker_loop(void)
                     break;
                 }
             }
+
+            // count queue overflows and other errors of the node
+            midi_check_errors(&midi_setup_rx);
         }
     }
     D(("worker: done\n"));
@@ -312,6 +597,7 @@ SAVEDS static void task_main(void)
     midi_setup_rx.rx_name = params.in_dev;
     midi_setup_rx.midi_name = "midi-perf-rx";
     midi_setup_rx.sysex_max_size = sysex_max_size;
+    midi_setup_rx.msg_queue_size = msg_queue;
     if(midi_open(&midi_setup_rx) != 0) {
         midi_close(&midi_setup_rx);
         D(("midi_rx failed!\n"));
@@ -398,6 +684,9 @@ int main(int argc, char **argv)
                     if(params.sysex_max_size != NULL) {
                         sysex_max_size = *params.sysex_max_size;
                     }
+                    if(params.msg_queue != NULL) {
+                        msg_queue = *params.msg_queue;
+                    }
                     if(params.num_msgs != NULL) {
                         num_msgs = *params.num_msgs;
                     }
@@ -410,21 +699,55 @@ int main(int argc, char **argv)
                     if(params.sample_delay != NULL) {
                         sample_delay = *params.sample_delay;
                     }
-
-                    /* setup midi */
-                    Printf("midi-perf: out_dev='%s' in_dev='%s'\n",
-                        params.out_dev, params.in_dev);
-                    midi_setup_tx.tx_name = params.out_dev;
-                    midi_setup_tx.midi_name = "midi-perf-tx";
-                    midi_setup_tx.sysex_max_size = sysex_max_size;
-                    if(midi_open(&midi_setup_tx) == 0) {
-
-                        main_loop();
-
+                    if(params.clock != NULL) {
+                        clock_mode = TRUE;
+                        bpm = 120;
+                    }
+                    if(params.listen != NULL) {
+                        clock_mode = TRUE;
+                        listen_mode = TRUE;
+                        bpm = 0;
+                    }
+                    if(params.bpm != NULL) {
+                        bpm = *params.bpm;
+                        if(bpm < 1) {
+                            bpm = 1;
+                        } else if(bpm > 999) {
+                            bpm = 999;
+                        }
                     }
-                    midi_close(&midi_setup_tx);
 
-                    result = RETURN_OK;
+                    if(!listen_mode && (params.out_dev == NULL)) {
+                        PutStr("OUTDEV is missing!\n");
+                    } else {
+                        /* setup midi. open camd.library here even without a
+                           sender: it sets up the drivers in the context of
+                           the first opener, which must outlive the worker */
+                        if(listen_mode) {
+                            Printf("midi-perf: listen to clock on in_dev='%s'\n",
+                                params.in_dev);
+                            midi_setup_tx.tx_name = NULL;
+                        } else {
+                            Printf("midi-perf: out_dev='%s' in_dev='%s'\n",
+                                params.out_dev, params.in_dev);
+                            midi_setup_tx.tx_name = params.out_dev;
+                        }
+                        midi_setup_tx.midi_name = "midi-perf-tx";
+                        midi_setup_tx.sysex_max_size = sysex_max_size;
+                        midi_setup_tx.msg_queue_size = msg_queue;
+                        if(midi_open(&midi_setup_tx) == 0) {
+
+                            if(clock_mode) {
+                                clock_loop();
+                            } else {
+                                main_loop();
+                            }
+
+                        }
+                        midi_close(&midi_setup_tx);
+
+                        result = RETURN_OK;
+                    }
                 }
                 midi_tools_exit_time();
             }
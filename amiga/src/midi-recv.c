@@ -7,20 +7,36 @@
 #include <midi/camd.h>
 #include <midi/mididefs.h>
 #include <utility/tagitem.h>
+#include <utility/hooks.h>
 
+#include "drv/compiler.h"
 #include "midi-setup.h"
 #include "midi-tools.h"
+#include "midi-capture.h"
+#include "midi-output.h"
 #include "cmd.h"
 
 static int handle_file(char *file_name);
 
 static const char *TEMPLATE = 
     "V=VERBOSE/S,"
+    "H=HOOK/S,"
     "SMS=SYSEXMAXSIZE/K/N,"
+    "MQ=MSGQUEUE/K/N,"
+    "MA=MAXARGS/K/N,"
+    "LBS=LINEBUFSIZE/K/N,"
+    "OBS=OUTBUFSIZE/K/N,"
+    "ML=MAXLINES/K/N,"
     "CMDS/M";
 typedef struct {
     LONG *verbose;
+    LONG *hook;
     ULONG *sysex_max_size;
+    ULONG *msg_queue;
+    ULONG *max_args;
+    ULONG *line_buf_size;
+    ULONG *out_buf_size;
+    ULONG *max_lines;
     char **cmds;
 } params_t;
 
@@ -28,11 +44,18 @@ struct DosLibrary *DOSBase;
 struct UtilityBase *UtilityBase;
 static params_t params;
 static int verbose;
+static int use_hook;
 static struct MidiSetup midi_setup;
 static struct MidiLink *rx;
 /* command state */
 static int note_numbers = 0;
 static int show_timestamp = 0;
+static int quiet = 0;
+static int summary = 0;
+static ULONG max_lines = 0;    /* per second. 0=no limit */
+static ULONG num_lines;
+static ULONG skipped_lines;
+static struct midi_capture capture;
 
 /* filter input */
 #define FILTER_VOICE                0x00007f
@@ -74,38 +97,55 @@ static UBYTE filter_cc_val = NO_VALUE;
 static UBYTE filter_pc_val = NO_VALUE;
 static int filter_channel = NO_CHANNEL; /* 0..16 */
 
+/* compiled filter: one entry per status byte. data dependent entries
+   refer to a table indexed by the first data byte */
+#define FILTER_TAB_DROP             0
+#define FILTER_TAB_PASS             1
+#define FILTER_TAB_DATA             2   /* + data table index */
+
+#define FILTER_DATA_NOTE_OFF        0
+#define FILTER_DATA_NOTE_ON         1
+#define FILTER_DATA_POLY_PRESSURE   2
+#define FILTER_DATA_CONTROL_CHANGE  3
+#define FILTER_DATA_PROGRAM_CHANGE  4
+#define FILTER_DATA_NUM             5
+#define FILTER_DATA_NONE            (-1)
+
+static UBYTE filter_tab[256];
+static UBYTE filter_data_tab[FILTER_DATA_NUM][128];
+
 static int check_channel(UBYTE chn)
 {
     return ((chn + 1) == filter_channel) || (filter_channel == NO_CHANNEL);
 }
 
-static int filter_sys(UBYTE status)
+static ULONG filter_sys_bit(UBYTE status)
 {
     switch(status) {
         // System Common
         case MS_SysEx:
-            return (filter & FILTER_SYS_EX) == FILTER_SYS_EX;
+            return FILTER_SYS_EX;
         case MS_QtrFrame:
-            return (filter & FILTER_TIME_CODE) == FILTER_TIME_CODE;
+            return FILTER_TIME_CODE;
         case MS_SongPos:
-            return (filter & FILTER_SONG_POS) == FILTER_SONG_POS;
+            return FILTER_SONG_POS;
         case MS_SongSelect:
-            return (filter & FILTER_SONG_SELECT) == FILTER_SONG_SELECT;
+            return FILTER_SONG_SELECT;
         case MS_TuneReq:
-            return (filter & FILTER_TUNE_REQUEST) == FILTER_TUNE_REQUEST;
+            return FILTER_TUNE_REQUEST;
         // System Realtime
         case MS_Clock:
-            return (filter & FILTER_CLOCK) == FILTER_CLOCK;
+            return FILTER_CLOCK;
         case MS_Start:
-            return (filter & FILTER_START) == FILTER_START;
+            return FILTER_START;
         case MS_Continue:
-            return (filter & FILTER_CONTINUE) == FILTER_CONTINUE;
+            return FILTER_CONTINUE;
         case MS_Stop:
-            return (filter & FILTER_STOP) == FILTER_STOP;
+            return FILTER_STOP;
         case MS_ActvSense:
-            return (filter & FILTER_ACTIVE_SENSING) == FILTER_ACTIVE_SENSING;
+            return FILTER_ACTIVE_SENSING;
         case MS_Reset:
-            return (filter & FILTER_RESET) == FILTER_RESET;
+            return FILTER_RESET;
 
         default:
             break;
@@ -113,83 +153,179 @@ static int filter_sys(UBYTE status)
     return 0;
 }
 
-static int filter_msg(UBYTE status, UBYTE data1)
+static int filter_voice_bit(UBYTE grp, ULONG *bit)
 {
-    /* quick check */
-    if(filter == 0) {
-        return 0;
-    }
-    if(filter == FILTER_ALL) {
-        return 1;
+    switch(grp) {
+        case MS_NoteOff:
+            *bit = FILTER_NOTE_OFF;
+            return FILTER_DATA_NOTE_OFF;
+        case MS_NoteOn:
+            *bit = FILTER_NOTE_ON;
+            return FILTER_DATA_NOTE_ON;
+        case MS_PolyPress:
+            *bit = FILTER_POLY_PRESSURE;
+            return FILTER_DATA_POLY_PRESSURE;
+        case MS_Ctrl:
+            *bit = FILTER_CONTROL_CHANGE;
+            return FILTER_DATA_CONTROL_CHANGE;
+        case MS_Prog:
+            *bit = FILTER_PROGRAM_CHANGE;
+            return FILTER_DATA_PROGRAM_CHANGE;
+        case MS_ChanPress:
+            *bit = FILTER_CHANNEL_PRESSURE;
+            return FILTER_DATA_NONE;
+        case MS_PitchBend:
+            *bit = FILTER_PITCH_BEND;
+            return FILTER_DATA_NONE;
+        default:
+            *bit = 0;
+            return FILTER_DATA_NONE;
     }
+}
 
-    UBYTE grp = status & MS_StatBits;
-    UBYTE chn = status & MS_ChanBits;
+/* build the lookup tables from the filter commands */
+static void compile_filter(void)
+{
+    UBYTE data_val[FILTER_DATA_NUM];
+    data_val[FILTER_DATA_NOTE_OFF] = filter_off_note;
+    data_val[FILTER_DATA_NOTE_ON] = filter_on_note;
+    data_val[FILTER_DATA_POLY_PRESSURE] = filter_pp_note;
+    data_val[FILTER_DATA_CONTROL_CHANGE] = filter_cc_val;
+    data_val[FILTER_DATA_PROGRAM_CHANGE] = filter_pc_val;
+
+    for(int i=0;i<FILTER_DATA_NUM;i++) {
+        for(int j=0;j<128;j++) {
+            filter_data_tab[i][j] = (data_val[i] == j);
+        }
+    }
 
-    switch(grp) {
-        /* channel voice messages */
-        case MS_NoteOff: /* NoteOff */
-            if(check_channel(chn)) {
-                if((filter & FILTER_NOTE_OFF) == FILTER_NOTE_OFF) {
-                    return (filter_off_note == NO_NOTE) || (filter_off_note == data1);
-                }
-            }
-            break;
-        case MS_NoteOn: /* NoteOn */
-            if(check_channel(chn)) {
-                if((filter & FILTER_NOTE_ON) == FILTER_NOTE_ON) {
-                    return (filter_on_note == NO_NOTE) || (filter_on_note == data1);
-                }
-            }
-            break;
-        case MS_PolyPress: /* Key Pressure */
-            if(check_channel(chn)) {
-                if((filter & FILTER_POLY_PRESSURE) == FILTER_POLY_PRESSURE) {
-                    return (filter_pp_note == NO_NOTE) || (filter_pp_note == data1);
-                }
-            }
-            break;
-        case MS_Ctrl: /* Control Change */
-            if(check_channel(chn)) {
-                if((filter & FILTER_CONTROL_CHANGE) == FILTER_CONTROL_CHANGE) {
-                    return (filter_cc_val == NO_VALUE) || (filter_cc_val == data1);
-                }
+    for(int status=0;status<256;status++) {
+        UBYTE entry = FILTER_TAB_DROP;
+        if(filter == FILTER_ALL) {
+            entry = FILTER_TAB_PASS;
+        }
+        else if(status >= MS_System) {
+            if((filter & filter_sys_bit(status)) != 0) {
+                entry = FILTER_TAB_PASS;
             }
-            break;
-        case MS_Prog: /* Program Change */
-            if(check_channel(chn)) {
-                if((filter & FILTER_PROGRAM_CHANGE) == FILTER_PROGRAM_CHANGE) {
-                    return (filter_pc_val == NO_VALUE) || (filter_pc_val == data1);
+        }
+        else if(status >= MS_NoteOff) {
+            ULONG bit;
+            int data = filter_voice_bit(status & MS_StatBits, &bit);
+            if(check_channel(status & MS_ChanBits) && ((filter & bit) != 0)) {
+                if((data != FILTER_DATA_NONE) && (data_val[data] != NO_VALUE)) {
+                    entry = FILTER_TAB_DATA + data;
+                } else {
+                    entry = FILTER_TAB_PASS;
                 }
             }
-            break;
-        case MS_ChanPress: /* Channel Pressure */
-            if(check_channel(chn)) {
-                return (filter & FILTER_CHANNEL_PRESSURE) == FILTER_CHANNEL_PRESSURE;
-            }
-            break;
-        case MS_PitchBend:
-            if(check_channel(chn)) {
-                return (filter & FILTER_PITCH_BEND) == FILTER_PITCH_BEND;
-            }
-            break;
-        case MS_System:
-            return filter_sys(status);
-        default:
-            break;
+        }
+        filter_tab[status] = entry;
+    }
+}
+
+/* CAMD link masks that drop unwanted classes and channels before queueing */
+static void compile_link_masks(ULONG *event_mask, UWORD *channel_mask)
+{
+    ULONG mask = 0;
+
+    if(filter == FILTER_ALL) {
+        *event_mask = CMF_All;
+        *channel_mask = 0xffff;
+        return;
+    }
+
+    if(filter & FILTER_NOTE)
+        mask |= CMF_Note;
+    if(filter & FILTER_POLY_PRESSURE)
+        mask |= CMF_PolyPress;
+    if(filter & FILTER_CONTROL_CHANGE)
+        mask |= CMF_Ctrl | CMF_Mode;
+    if(filter & FILTER_PROGRAM_CHANGE)
+        mask |= CMF_Prog;
+    if(filter & FILTER_CHANNEL_PRESSURE)
+        mask |= CMF_ChanPress;
+    if(filter & FILTER_PITCH_BEND)
+        mask |= CMF_PitchBend;
+    if(filter & FILTER_SYS_REAL_TIME)
+        mask |= CMF_RealTime;
+    if(filter & (FILTER_SYS_COMMON & ~FILTER_SYS_EX))
+        mask |= CMF_SysCom;
+    if(filter & FILTER_SYS_EX)
+        mask |= CMF_SysEx;
+
+    *event_mask = mask;
+    if(filter_channel == NO_CHANNEL) {
+        *channel_mask = 0xffff;
+    } else {
+        *channel_mask = 1 << (filter_channel - 1);
+    }
+}
+
+/* one or two lookups per message */
+static int filter_msg(UBYTE status, UBYTE data1)
+{
+    UBYTE entry = filter_tab[status];
+    if(entry < FILTER_TAB_DATA) {
+        return entry;
     }
+    return filter_data_tab[entry - FILTER_TAB_DATA][data1 & 0x7f];
+}
 
+/* receive hook: filter in the context of the sender and only pass
+   accepted messages to the main task via a small ring buffer. only sysex
+   is queued in the node as its data is bound to the queue: it leaves a
+   mark in the ring to keep its place */
+#define HOOK_RING_SIZE      256
+#define HOOK_RING_MASK      (HOOK_RING_SIZE - 1)
+
+static struct Hook recv_hook;
+static struct Task *main_task;
+static MidiMsg hook_ring[HOOK_RING_SIZE];
+static volatile UWORD hook_put;
+static volatile UWORD hook_get;
+static volatile ULONG hook_overflows;
+
+static SAVEDS ASM ULONG recv_hook_func(REG(a0, struct Hook *hook),
+                                       REG(a2, struct MidiLink *link),
+                                       REG(a1, MidiMsg *msg))
+{
+    if((msg->mm_Status != MS_SysEx) && !filter_msg(msg->mm_Status, msg->mm_Data1)) {
+        return 0;
+    }
+
+    UWORD put = hook_put;
+    UWORD next = (put + 1) & HOOK_RING_MASK;
+    if(next == hook_get) {
+        hook_overflows++;
+        return 0;
+    }
+    hook_ring[put] = *msg;
+    hook_put = next;
+
+    Signal(main_task, 1L << midi_setup.rx_sig);
     return 0;
 }
 
+static BOOL get_hook_msg(MidiMsg *msg)
+{
+    UWORD get = hook_get;
+    if(get == hook_put) {
+        return FALSE;
+    }
+    *msg = hook_ring[get];
+    hook_get = (get + 1) & HOOK_RING_MASK;
+    return TRUE;
+}
+
 /* output tools */
 
 static void print_7bit(UBYTE val)
 {
     if(midi_tools_get_hex_mode()) {
-        Printf("%02lx", val);
+        midi_output_printf("%02lx", val);
     } else {
-        Printf("%3ld", val);
+        midi_output_printf("%3ld", val);
     }
 }
 
@@ -197,9 +333,9 @@ static void print_14bit(UBYTE lsb, UBYTE msb)
 {
     UWORD val = msb << 7 | lsb;
     if(midi_tools_get_hex_mode()) {
-        Printf("%04lx", val);
+        midi_output_printf("%04lx", val);
     } else {
-        Printf("%5ld", val);
+        midi_output_printf("%5ld", val);
     }
 }
 
@@ -210,121 +346,134 @@ static void print_note(UBYTE note)
     } else {
         char buf[16];
         midi_tools_print_note(buf, note, 1, 1);
-        PutStr(buf);
+        midi_output_str(buf);
     }
 }
 
 static void print_channel(UBYTE chn)
 {
-    PutStr("channel ");
+    midi_output_str("channel ");
     print_7bit(chn+1);
-    PutStr(" ");
+    midi_output_str(" ");
 }
 
 /* input handler */
 
 /* system common */
 
-static void handle_sysex(void)
+static ULONG recv_sysex(void)
 {
     struct MidiNode *node = midi_setup.node;
     UBYTE *buf = midi_setup.sysex_buf;
-    ULONG  buf_size = midi_setup.sysex_max_size;
+    ULONG  buf_size = midi_setup.sysex_buf_size;
 
     if(buf == NULL) {
-        PutStr("sysex: ERROR: no buffer!\n");
+        midi_output_str("sysex: ERROR: no buffer!\n");
         SkipSysEx(node);
-    } else {
-        ULONG size = QuerySysEx(node);
-        if(size > buf_size) {
-            Printf("sysex: ERROR: too large: %ld!\n", size);
-            SkipSysEx(node);
-        } else {
-            ULONG got_size = GetSysEx(node, buf, buf_size);
-            int hex = midi_tools_get_hex_mode();
-            if(!hex) {
-                PutStr("hex ");
-            }
-            PutStr("syx ");
-            for(ULONG i=1;i<(got_size-1);i++) {
-                Printf("%02lx ", (ULONG)buf[i]);
-            }
-            if(!hex) {
-                PutStr(" dec");
-            }
-            PutStr("\n");
-        }
+        return 0;
+    }
+
+    ULONG size = QuerySysEx(node);
+    if(size > buf_size) {
+        midi_output_printf("sysex: ERROR: too large: %ld!\n", size);
+        SkipSysEx(node);
+        return 0;
+    }
+
+    return GetSysEx(node, buf, buf_size);
+}
+
+static void handle_sysex(ULONG got_size)
+{
+    UBYTE *buf = midi_setup.sysex_buf;
+
+    if(got_size == 0) {
+        return;
+    }
+
+    int hex = midi_tools_get_hex_mode();
+    if(!hex) {
+        midi_output_str("hex ");
+    }
+    midi_output_str("syx ");
+    for(ULONG i=1;i<(got_size-1);i++) {
+        midi_output_printf("%02lx ", (ULONG)buf[i]);
     }
+    if(!hex) {
+        midi_output_str(" dec");
+    }
+    midi_output_str("\n");
 }
 
 static void handle_qtr_frame(UBYTE data)
 {
     UBYTE seq_num = data >> 4;
     UBYTE value   = data & 0x0f;
-    PutStr("time-code ");
+    midi_output_str("time-code ");
     print_7bit(seq_num);
-    PutStr(" ");
+    midi_output_str(" ");
     print_7bit(value);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_song_pos(UBYTE lsb, UBYTE msb)
 {
-    PutStr("song-position ");
+    midi_output_str("song-position ");
     print_14bit(lsb, msb);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_song_select(UBYTE sn)
 {
-    PutStr("song-select ");
+    midi_output_str("song-select ");
     print_7bit(sn);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_tune_req(void)
 {
-    PutStr("tune-request\n");
+    midi_output_str("tune-request\n");
 }
 
 /* system realtime */
 
 static void handle_clock(void)
 {
-    PutStr("midi-clock\n");
+    midi_output_str("midi-clock\n");
 }
 
 static void handle_start(void)
 {
-    PutStr("start\n");
+    midi_output_str("start\n");
 }
 
 static void handle_cont(void)
 {
-    PutStr("continue\n");
+    midi_output_str("continue\n");
 }
 
 static void handle_stop(void)
 {
-    PutStr("stop\n");
+    midi_output_str("stop\n");
 }
 
 static void handle_act_sense(void)
 {
-    PutStr("active-sensing\n");
+    midi_output_str("active-sensing\n");
 }
 
 static void handle_reset(void)
 {
-    PutStr("reset\n");
+    midi_output_str("reset\n");
 }
 
-static void handle_system_msg(UBYTE status, UBYTE data1, UBYTE data2)
+static void handle_system_msg(UBYTE status, UBYTE data1, UBYTE data2,
+                              ULONG sysex_size)
 { 
     switch(status) {
         // System Common
         case MS_SysEx:
-            handle_sysex();
+            handle_sysex(sysex_size);
             break;
         case MS_QtrFrame:
             handle_qtr_frame(data1);
@@ -359,7 +508,7 @@ static void handle_system_msg(UBYTE status, UBYTE data1, UBYTE data2)
             break;
 
         default:
-            Printf("Invalid System Msg: %02lx\n", status);
+            midi_output_printf("Invalid System Msg: %02lx\n", status);
             break;
     }
 }
@@ -369,79 +518,78 @@ static void handle_system_msg(UBYTE status, UBYTE data1, UBYTE data2)
 static void handle_note_on(UBYTE chn, UBYTE note, UBYTE vel)
 {
     print_channel(chn);
-    PutStr("note-on          ");
+    midi_output_str("note-on          ");
     print_note(note);
-    PutStr(" ");
+    midi_output_str(" ");
     print_7bit(vel);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_note_off(UBYTE chn, UBYTE note, UBYTE vel)
 {
     print_channel(chn);
-    PutStr("note-off         ");
+    midi_output_str("note-off         ");
     print_note(note);
-    PutStr(" ");
+    midi_output_str(" ");
     print_7bit(vel);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_poly_pressure(UBYTE chn, UBYTE note, UBYTE vel)
 {
     print_channel(chn);
-    PutStr("poly-pressure    ");
+    midi_output_str("poly-pressure    ");
     print_note(note);
-    PutStr(" ");
+    midi_output_str(" ");
     print_7bit(vel);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_control_change(UBYTE chn, UBYTE ctrl, UBYTE val)
 {
     print_channel(chn);
-    PutStr("control-change   ");
+    midi_output_str("control-change   ");
     print_7bit(ctrl);
-    PutStr(" ");
+    midi_output_str(" ");
     print_7bit(val);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_program_change(UBYTE chn, UBYTE prog)
 {
     print_channel(chn);
-    PutStr("program-change   ");
+    midi_output_str("program-change   ");
     print_7bit(prog);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_channel_pressure(UBYTE chn, UBYTE val)
 {
     print_channel(chn);
-    PutStr("channel-pressure ");
+    midi_output_str("channel-pressure ");
     print_7bit(val);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 static void handle_pitch_bend(UBYTE chn, UBYTE lsb, UBYTE msb)
 {
     print_channel(chn);
-    Printf("pitch-bend       ");
+    midi_output_printf("pitch-bend       ");
     print_14bit(lsb, msb);
-    PutStr("\n");
+    midi_output_str("\n");
 }
 
 /* handle midi message */
 
-static void handle_msg(UBYTE status, UBYTE data1, UBYTE data2)
+static void handle_msg(UBYTE status, UBYTE data1, UBYTE data2,
+                       ULONG sysex_size, struct timeval *tv)
 {
     UBYTE grp = status & MS_StatBits;
     UBYTE chn = status & MS_ChanBits;
 
     if(show_timestamp) {
-        struct timeval tv;
-        midi_tools_get_time(&tv);
-        midi_tools_print_time(&tv);
-        PutStr("  ");
+        midi_output_time(tv);
+        midi_output_str("  ");
     }
 
     switch(grp) {
@@ -468,14 +616,120 @@ static void handle_msg(UBYTE status, UBYTE data1, UBYTE data2)
             handle_pitch_bend(chn, data1, data2);
             break;
         case MS_System:
-            handle_system_msg(status, data1, data2);
+            handle_system_msg(status, data1, data2, sysex_size);
             break;
         default:
-            Printf("Invalid MIDI status: %02lx\n", status);
+            midi_output_printf("Invalid MIDI status: %02lx\n", status);
             break;
     }
 }
 
+/* summary: count messages per type and channel and show them once per second */
+
+static ULONG sum_voice[7][16];
+static ULONG sum_sys[16];
+static ULONG sum_total;
+
+static char *voice_names[7] = {
+    "note-off", "note-on", "poly-pressure", "control-change",
+    "program-change", "channel-pressure", "pitch-bend"
+};
+
+static char *sys_names[16] = {
+    "system-exclusive", "time-code", "song-position", "song-select",
+    "undefined-f4", "undefined-f5", "tune-request", "end-of-exclusive",
+    "midi-clock", "undefined-f9", "start", "continue",
+    "stop", "undefined-fd", "active-sensing", "reset"
+};
+
+static void count_msg(UBYTE status)
+{
+    if(status >= MS_System) {
+        sum_sys[status & 0x0f]++;
+    }
+    else if(status >= MS_NoteOff) {
+        sum_voice[(status >> 4) - 8][status & MS_ChanBits]++;
+    }
+    sum_total++;
+}
+
+static void show_summary(struct timeval *tv)
+{
+    if(sum_total == 0) {
+        return;
+    }
+
+    midi_output_time(tv);
+    midi_output_printf("  summary: %ld messages\n", sum_total);
+
+    for(int chn=0;chn<16;chn++) {
+        int first = 1;
+        for(int grp=0;grp<7;grp++) {
+            ULONG num = sum_voice[grp][chn];
+            if(num == 0) {
+                continue;
+            }
+            if(first) {
+                midi_output_str("  ");
+                print_channel(chn);
+                first = 0;
+            }
+            midi_output_printf(" %s %ld", voice_names[grp], num);
+            sum_voice[grp][chn] = 0;
+        }
+        if(!first) {
+            midi_output_str("\n");
+        }
+    }
+
+    for(int i=0;i<16;i++) {
+        if(sum_sys[i] > 0) {
+            midi_output_printf("  %s %ld\n", sys_names[i], sum_sys[i]);
+            sum_sys[i] = 0;
+        }
+    }
+
+    sum_total = 0;
+}
+
+static void handle_tick(void)
+{
+    struct timeval tv;
+    midi_tools_get_time(&tv);
+
+    if(summary) {
+        show_summary(&tv);
+    }
+    if(skipped_lines > 0) {
+        midi_output_printf("-- skipped %ld messages --\n", skipped_lines);
+        skipped_lines = 0;
+    }
+    num_lines = 0;
+}
+
+/* capture midi message */
+
+static void capture_msg(MidiMsg *msg, ULONG sysex_size, struct timeval *tv)
+{
+    int res;
+
+    if(msg->mm_Status == MS_SysEx) {
+        if(sysex_size == 0) {
+            return;
+        }
+        res = midi_capture_write(&capture, tv, msg->mm_Port,
+                                 MIDI_CAPTURE_FLAG_SYSEX,
+                                 midi_setup.sysex_buf, sysex_size);
+    } else {
+        res = midi_capture_write(&capture, tv, msg->mm_Port, 0,
+                                 msg->mm_Data, MidiMsgLen(msg->mm_Msg));
+    }
+    if(res != MIDI_CAPTURE_OK) {
+        PutStr("Error writing capture file! Stopping capture.\n");
+        midi_capture_close(&capture);
+    }
+}
+
 /* --- commands --- */
 
 static int cmd_ts(int num_args, char **args)
@@ -486,6 +740,36 @@ static int cmd_ts(int num_args, char **args)
     return 0;
 }
 
+static int cmd_q(int num_args, char **args)
+{
+    quiet = 1;
+    if(verbose)
+        PutStr("quiet\n");
+    return 0;
+}
+
+static int cmd_sum(int num_args, char **args)
+{
+    summary = 1;
+    if(verbose)
+        PutStr("summary\n");
+    return 0;
+}
+
+static int cmd_rec(int num_args, char **args)
+{
+    if(capture.fh != NULL) {
+        midi_capture_close(&capture);
+    }
+    if(midi_capture_open_write(&capture, *args) != MIDI_CAPTURE_OK) {
+        Printf("Error creating capture file: %s\n", *args);
+        return 1;
+    }
+    if(verbose)
+        Printf("record: %s\n", *args);
+    return 0;
+}
+
 static int cmd_nn(int num_args, char **args)
 {
     note_numbers = 1;
@@ -725,6 +1009,9 @@ static int cmd_dev(int num_args, char **args)
 static cmd_t command_table[] = {
     { "ts", "timestamp", 0, cmd_ts },
     { "nn", "note-numbers", 0, cmd_nn },
+    { "q", "quiet", 0, cmd_q },
+    { "sum", "summary", 0, cmd_sum },
+    { "rec", "record", 1, cmd_rec },
     { "hex", "hexadecimal", 0, cmd_hex },
     { "dec", "decimal", 0, cmd_dec },
     { "omc", "octave-middle-c", 1, cmd_omc },
@@ -788,7 +1075,43 @@ static int handle_file(char *file_name)
     return cmd_exec_file(file_name, command_table, handle_other);
 }
 
-static int run(char **cmd_line, ULONG sysex_max_size)
+static void recv_msg(MidiMsg *msg)
+{
+    struct timeval tv;
+
+    if(verbose)
+        midi_output_printf("%08ld: %08lx\n", msg->mm_Time, msg->mm_Msg);
+
+    /* the time is only needed for a capture or a shown time stamp */
+    BOOL show = !summary && !quiet
+        && !((max_lines > 0) && (num_lines >= max_lines));
+    if((capture.fh != NULL) || (show && show_timestamp)) {
+        midi_tools_get_time(&tv);
+    }
+
+    ULONG sysex_size = 0;
+    if(msg->mm_Status == MS_SysEx) {
+        sysex_size = recv_sysex();
+    }
+    if(capture.fh != NULL) {
+        capture_msg(msg, sysex_size, &tv);
+    }
+    if(summary) {
+        count_msg(msg->mm_Status);
+    }
+    else if(!show) {
+        if(!quiet) {
+            skipped_lines++;
+        }
+    }
+    else {
+        handle_msg(msg->mm_Status, msg->mm_Data1, msg->mm_Data2,
+                   sysex_size, &tv);
+        num_lines++;
+    }
+}
+
+static int run(char **cmd_line, ULONG sysex_max_size, ULONG out_buf_size)
 {
     MidiMsg msg;
     BOOL alive = TRUE;
@@ -798,6 +1121,14 @@ static int run(char **cmd_line, ULONG sysex_max_size)
     midi_setup.tx_name = NULL;
     rx = NULL;
 
+    /* filter in receive hook */
+    main_task = FindTask(NULL);
+    if(use_hook) {
+        recv_hook.h_Entry = (HOOKFUNC)recv_hook_func;
+        midi_setup.rx_hook = &recv_hook;
+        midi_setup.rx_hook_only = TRUE;
+    }
+
     /* parse commands */
     int retcode = 0;
     char **result = cmd_exec_cmd_line(cmd_line, command_table, handle_other);
@@ -808,6 +1139,7 @@ static int run(char **cmd_line, ULONG sysex_max_size)
 
     if(rx == NULL) {
         Printf("ERROR: no input midi device given! use 'dev'\n");
+        midi_capture_close(&capture);
         return 1;
     }
 
@@ -816,36 +1148,106 @@ static int run(char **cmd_line, ULONG sysex_max_size)
         filter = FILTER_ALL;
     }
 
-    if(verbose)
+    /* compile filter and let CAMD drop unwanted classes and channels */
+    ULONG event_mask;
+    UWORD channel_mask;
+    compile_filter();
+    compile_link_masks(&event_mask, &channel_mask);
+    midi_set_rx_masks(&midi_setup, event_mask, channel_mask);
+
+    if(verbose) {
         Printf("midi-recv: from '%s'. filter=%06lx\n", midi_setup.rx_name, filter);
+        Printf("link masks: events=%04lx channels=%04lx\n",
+               event_mask, (ULONG)channel_mask);
+    }
 
-    int rc = midi_tools_init_time();
+    int rc = midi_output_init(out_buf_size);
+    if(rc!=0) {
+        PutStr("ERROR: no memory for output buffer!\n");
+        midi_capture_close(&capture);
+        midi_close(&midi_setup);
+        return 1;
+    }
+
+    rc = midi_tools_init_time();
     if(rc!=0) {
         Printf("ERROR: setting up timer! (%ld)\n", rc);
     } else {
+        /* once per second tick for summary and line limit */
+        ULONG tick_mask = 0;
+        if(summary || (max_lines > 0)) {
+            tick_mask = midi_tools_start_tick(1000000);
+            if(tick_mask == 0) {
+                PutStr("ERROR: setting up tick timer!\n");
+            }
+        }
+
         /* main loop */
         struct MidiNode *node = midi_setup.node;
         while(alive) {
-            sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<midi_setup.rx_sig);
+            sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<midi_setup.rx_sig | tick_mask);
             if(sigmask & SIGBREAKF_CTRL_C)
                 alive=FALSE;
-            while(GetMidi(midi_setup.node, &msg)) {
-                if(verbose)
-                    Printf("%08ld: %08lx\n", msg.mm_Time, msg.mm_Msg);
-
-                int filter = filter_msg(msg.mm_Status, msg.mm_Data1);
-                if(filter) {
-                    handle_msg(msg.mm_Status, msg.mm_Data1, msg.mm_Data2);
-                } else {
-                    if(verbose)
-                        Printf("FILTERED by %06lx\n", filter);
+            if(use_hook) {
+                /* hook messages are already filtered. a sysex mark takes
+                   the next sysex of the node */
+                while(get_hook_msg(&msg)) {
+                    if(msg.mm_Status != MS_SysEx) {
+                        recv_msg(&msg);
+                    } else if(GetMidi(node, &msg)) {
+                        recv_msg(&msg);
+                    }
+                }
+                /* sysex whose mark was lost to a ring overflow */
+                while(GetMidi(node, &msg)) {
+                    recv_msg(&msg);
                 }
+            } else {
+                while(GetMidi(node, &msg)) {
+                    if(filter_msg(msg.mm_Status, msg.mm_Data1)) {
+                        recv_msg(&msg);
+                    } else if(verbose) {
+                        midi_output_printf("FILTERED by %06lx\n", filter);
+                    }
+                }
+            }
+
+            /* report lost messages of the node */
+            UBYTE err = midi_check_errors(&midi_setup);
+            if(err != 0) {
+                /* keep the order with the buffered messages */
+                midi_output_flush();
+                midi_show_errors(err);
             }
+
+            if(midi_tools_check_tick()) {
+                handle_tick();
+            }
+
+            /* write all output of this batch at once */
+            midi_output_flush();
         }
 
         midi_tools_exit_time();
     }
 
+    midi_output_exit();
+
+    if(midi_num_errors(&midi_setup) > 0) {
+        PutStr("CAMD node errors:\n");
+        midi_print_errors(&midi_setup);
+    }
+
+    if(use_hook && (hook_overflows > 0)) {
+        Printf("hook buffer overflows: %ld\n", hook_overflows);
+    }
+
+    if(capture.fh != NULL) {
+        if(verbose)
+            Printf("recorded %ld messages\n", capture.num_records);
+        midi_capture_close(&capture);
+    }
+
     midi_close(&midi_setup);
     return 0;
 }
@@ -877,14 +1279,38 @@ int main(int argc, char **argv)
                 if(params.verbose != NULL) {
                     verbose = 1;
                 }
+                if(params.hook != NULL) {
+                    use_hook = 1;
+                }
+
+                /* command file limits */
+                if(params.max_args != NULL) {
+                    cmd_set_max_args(*params.max_args);
+                }
+                if(params.line_buf_size != NULL) {
+                    cmd_set_line_buf_size(*params.line_buf_size);
+                }
 
                 /* max size for sysex */
-                ULONG sysex_max_size = 2048;
+                ULONG sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
                 if(params.sysex_max_size != NULL) {
                     sysex_max_size = *params.sysex_max_size;
                 }
+                /* depth of the node's message queue */
+                if(params.msg_queue != NULL) {
+                    midi_setup.msg_queue_size = *params.msg_queue;
+                }
+
+                /* output buffer and line limit */
+                ULONG out_buf_size = MIDI_OUTPUT_DEFAULT_BUF_SIZE;
+                if(params.out_buf_size != NULL) {
+                    out_buf_size = *params.out_buf_size;
+                }
+                if(params.max_lines != NULL) {
+                    max_lines = *params.max_lines;
+                }
 
-                result = run(cmds, sysex_max_size);
+                result = run(cmds, sysex_max_size, out_buf_size);
             }
 
             FreeArgs(args);
@@ -0,0 +1,651 @@
+#define USE_INLINE_STDARG
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/camd.h>
+#include <proto/utility.h>
+
+#include <midi/camd.h>
+#include <midi/mididefs.h>
+#include <utility/tagitem.h>
+#include <string.h>
+
+#include "midi-setup.h"
+#include "midi-tools.h"
+#include "cmd.h"
+
+static int handle_file(char *file_name);
+
+static const char *TEMPLATE =
+    "V=VERBOSE/S,"
+    "SMS=SYSEXMAXSIZE/K/N,"
+    "MQ=MSGQUEUE/K/N,"
+    "CMDS/M";
+typedef struct {
+    LONG *verbose;
+    ULONG *sysex_max_size;
+    ULONG *msg_queue;
+    char **cmds;
+} params_t;
+
+struct DosLibrary *DOSBase;
+struct UtilityBase *UtilityBase;
+static params_t params;
+static int verbose;
+static struct MidiSetup midi_setup;
+
+/* message types of a route */
+#define ROUTE_NOTE              0x001
+#define ROUTE_POLY_PRESSURE     0x002
+#define ROUTE_CONTROL_CHANGE    0x004
+#define ROUTE_PROGRAM_CHANGE    0x008
+#define ROUTE_CHANNEL_PRESSURE  0x010
+#define ROUTE_PITCH_BEND        0x020
+#define ROUTE_VOICE             0x03f
+#define ROUTE_SYS_REAL_TIME     0x040
+#define ROUTE_SYS_COMMON        0x080
+#define ROUTE_SYS_EX            0x100
+#define ROUTE_ALL               0x1ff
+
+#define MAX_INPUTS      16
+#define MAX_OUTPUTS     16
+#define MAX_ROUTES      64
+
+#define NO_NOTE         0xff
+#define MAX_NAME_LEN    64
+
+struct port {
+    char             name[MAX_NAME_LEN];
+    struct MidiLink *link;
+    struct route    *routes;    /* inputs only */
+};
+
+struct route {
+    struct route    *next;      /* next route of same input */
+    struct port     *out;
+    /* config */
+    ULONG            types;     /* 0 for all */
+    UBYTE            in_channel;    /* 1..16, 0 for all */
+    UBYTE            out_channel;   /* 1..16, 0 to keep */
+    BYTE             transpose;
+    /* compiled: output status per input status (0=drop) and note map */
+    UBYTE            status_map[256];
+    UBYTE            note_map[128];
+    ULONG            num_msgs;
+};
+
+static struct port inputs[MAX_INPUTS];
+static struct port outputs[MAX_OUTPUTS];
+static struct route routes[MAX_ROUTES];
+static int num_inputs;
+static int num_outputs;
+static int num_routes;
+/* command state */
+static struct port *cur_input;
+static struct route *cur_route;
+/* stats */
+static ULONG num_in_msgs;
+static ULONG num_dropped_sysex;
+
+/* --- compile routes --- */
+
+static ULONG voice_type(UBYTE grp)
+{
+    switch(grp) {
+        case MS_NoteOff:
+        case MS_NoteOn:
+            return ROUTE_NOTE;
+        case MS_PolyPress:
+            return ROUTE_POLY_PRESSURE;
+        case MS_Ctrl:
+            return ROUTE_CONTROL_CHANGE;
+        case MS_Prog:
+            return ROUTE_PROGRAM_CHANGE;
+        case MS_ChanPress:
+            return ROUTE_CHANNEL_PRESSURE;
+        case MS_PitchBend:
+            return ROUTE_PITCH_BEND;
+        default:
+            return 0;
+    }
+}
+
+static void compile_route(struct route *r)
+{
+    ULONG types = r->types;
+    if(types == 0) {
+        types = ROUTE_ALL;
+    }
+
+    for(int status=0;status<256;status++) {
+        UBYTE out = 0;
+        if(status >= MS_RealTime) {
+            if(types & ROUTE_SYS_REAL_TIME) {
+                out = status;
+            }
+        }
+        else if(status == MS_SysEx) {
+            if(types & ROUTE_SYS_EX) {
+                out = status;
+            }
+        }
+        else if(status >= MS_System) {
+            if(types & ROUTE_SYS_COMMON) {
+                out = status;
+            }
+        }
+        else if(status >= MS_NoteOff) {
+            UBYTE grp = status & MS_StatBits;
+            UBYTE chn = status & MS_ChanBits;
+            if((types & voice_type(grp)) &&
+               ((r->in_channel == 0) || (r->in_channel == chn + 1))) {
+                if(r->out_channel != 0) {
+                    chn = r->out_channel - 1;
+                }
+                out = grp | chn;
+            }
+        }
+        r->status_map[status] = out;
+    }
+
+    for(int note=0;note<128;note++) {
+        int out = note + r->transpose;
+        if((out < 0) || (out > 127)) {
+            r->note_map[note] = NO_NOTE;
+        } else {
+            r->note_map[note] = (UBYTE)out;
+        }
+    }
+}
+
+static void compile_routes(void)
+{
+    for(int i=0;i<num_routes;i++) {
+        compile_route(&routes[i]);
+    }
+}
+
+/* --- route messages --- */
+
+static void route_sysex(struct port *in)
+{
+    struct MidiNode *node = midi_setup.node;
+
+    ULONG size = QuerySysEx(node);
+    if(size > midi_setup.sysex_buf_size) {
+        SkipSysEx(node);
+        num_dropped_sysex++;
+        return;
+    }
+    if(GetSysEx(node, midi_setup.sysex_buf, midi_setup.sysex_buf_size) == 0) {
+        return;
+    }
+
+    for(struct route *r = in->routes; r != NULL; r = r->next) {
+        if(r->status_map[MS_SysEx] != 0) {
+            PutSysEx(r->out->link, midi_setup.sysex_buf);
+            r->num_msgs++;
+        }
+    }
+}
+
+static void route_msg(MidiMsg *msg)
+{
+    /* the port id of the rx link tells the input */
+    UBYTE port = msg->mm_Port;
+    if(port >= num_inputs) {
+        return;
+    }
+    struct port *in = &inputs[port];
+
+    if(msg->mm_Status == MS_SysEx) {
+        route_sysex(in);
+        return;
+    }
+
+    for(struct route *r = in->routes; r != NULL; r = r->next) {
+        UBYTE status = r->status_map[msg->mm_Status];
+        if(status == 0) {
+            continue;
+        }
+
+        MidiMsg out;
+        out.mm_Msg = msg->mm_Msg;
+        out.mm_Status = status;
+
+        /* transpose notes */
+        if(r->transpose != 0) {
+            UBYTE grp = status & MS_StatBits;
+            if((grp == MS_NoteOff) || (grp == MS_NoteOn) || (grp == MS_PolyPress)) {
+                UBYTE note = r->note_map[msg->mm_Data1 & 0x7f];
+                if(note == NO_NOTE) {
+                    continue;
+                }
+                out.mm_Data1 = note;
+            }
+        }
+
+        PutMidi(r->out->link, out.mm_Msg);
+        r->num_msgs++;
+    }
+}
+
+/* --- commands --- */
+
+static struct port *find_port(struct port *ports, int num, char *name)
+{
+    for(int i=0;i<num;i++) {
+        if(Stricmp(ports[i].name, name) == 0) {
+            return &ports[i];
+        }
+    }
+    return NULL;
+}
+
+static int cmd_in(int num_args, char **args)
+{
+    char *name = args[0];
+
+    if(strlen(name) >= MAX_NAME_LEN) {
+        Printf("Input name too long: %s\n", name);
+        return 1;
+    }
+
+    struct port *in = find_port(inputs, num_inputs, name);
+    if(in == NULL) {
+        if(num_inputs == MAX_INPUTS) {
+            Printf("Too many inputs: %s\n", name);
+            return 1;
+        }
+        in = &inputs[num_inputs];
+        /* args of command files do not live long */
+        strcpy(in->name, name);
+        in->routes = NULL;
+        /* tag messages of this input with its index */
+        in->link = AddMidiLink(midi_setup.node, MLTYPE_Receiver,
+            MLINK_Location, in->name,
+            MLINK_PortID, num_inputs,
+            TAG_END);
+        if(in->link == NULL) {
+            Printf("Error creating rx link to '%s'\n", name);
+            return 1;
+        }
+        num_inputs++;
+        if(verbose)
+            Printf("input #%ld: %s\n", num_inputs - 1, name);
+    }
+
+    cur_input = in;
+    cur_route = NULL;
+    return 0;
+}
+
+static int cmd_out(int num_args, char **args)
+{
+    char *name = args[0];
+
+    if(cur_input == NULL) {
+        Printf("No input given for output: %s! use 'in'\n", name);
+        return 1;
+    }
+    if(strlen(name) >= MAX_NAME_LEN) {
+        Printf("Output name too long: %s\n", name);
+        return 1;
+    }
+    if(num_routes == MAX_ROUTES) {
+        Printf("Too many routes: %s\n", name);
+        return 1;
+    }
+
+    struct port *out = find_port(outputs, num_outputs, name);
+    if(out == NULL) {
+        if(num_outputs == MAX_OUTPUTS) {
+            Printf("Too many outputs: %s\n", name);
+            return 1;
+        }
+        out = &outputs[num_outputs];
+        strcpy(out->name, name);
+        out->routes = NULL;
+        out->link = AddMidiLink(midi_setup.node, MLTYPE_Sender,
+            MLINK_Location, out->name,
+            TAG_END);
+        if(out->link == NULL) {
+            Printf("Error creating tx link to '%s'\n", name);
+            return 1;
+        }
+        num_outputs++;
+    }
+
+    /* append route to the input */
+    struct route *r = &routes[num_routes++];
+    r->next = NULL;
+    r->out = out;
+    r->types = 0;
+    r->in_channel = 0;
+    r->out_channel = 0;
+    r->transpose = 0;
+    r->num_msgs = 0;
+
+    struct route **ptr = &cur_input->routes;
+    while(*ptr != NULL) {
+        ptr = &(*ptr)->next;
+    }
+    *ptr = r;
+
+    cur_route = r;
+    if(verbose)
+        Printf("route: %s -> %s\n", cur_input->name, name);
+    return 0;
+}
+
+static struct route *get_route(char *cmd)
+{
+    if(cur_route == NULL) {
+        Printf("No route for '%s'! use 'out'\n", cmd);
+    }
+    return cur_route;
+}
+
+static int cmd_ch(int num_args, char **args)
+{
+    struct route *r = get_route("ch");
+    if(r == NULL) {
+        return 1;
+    }
+
+    LONG in_ch = midi_tools_parse_number(args[0]);
+    LONG out_ch = midi_tools_parse_number(args[1]);
+    if((in_ch < 0) || (in_ch > 16) || (out_ch < 0) || (out_ch > 16)) {
+        Printf("Invalid MIDI channels: %s %s\n", args[0], args[1]);
+        return 1;
+    }
+    r->in_channel = in_ch;
+    r->out_channel = out_ch;
+    if(verbose)
+        Printf("channel: %ld -> %ld\n", in_ch, out_ch);
+    return 0;
+}
+
+static int cmd_tr(int num_args, char **args)
+{
+    struct route *r = get_route("tr");
+    if(r == NULL) {
+        return 1;
+    }
+
+    char *str = args[0];
+    int neg = 0;
+    if(*str == '-') {
+        neg = 1;
+        str++;
+    }
+    LONG val = midi_tools_parse_number(str);
+    if((val < 0) || (val > 127)) {
+        Printf("Invalid transpose: %s\n", args[0]);
+        return 1;
+    }
+    r->transpose = neg ? -val : val;
+    if(verbose)
+        Printf("transpose: %ld\n", (LONG)r->transpose);
+    return 0;
+}
+
+static int add_type(char *cmd, ULONG type)
+{
+    struct route *r = get_route(cmd);
+    if(r == NULL) {
+        return 1;
+    }
+    r->types |= type;
+    return 0;
+}
+
+static int cmd_voice(int num_args, char **args)
+{
+    return add_type("voice", ROUTE_VOICE);
+}
+
+static int cmd_note(int num_args, char **args)
+{
+    return add_type("note", ROUTE_NOTE);
+}
+
+static int cmd_pp(int num_args, char **args)
+{
+    return add_type("pp", ROUTE_POLY_PRESSURE);
+}
+
+static int cmd_cc(int num_args, char **args)
+{
+    return add_type("cc", ROUTE_CONTROL_CHANGE);
+}
+
+static int cmd_pc(int num_args, char **args)
+{
+    return add_type("pc", ROUTE_PROGRAM_CHANGE);
+}
+
+static int cmd_cp(int num_args, char **args)
+{
+    return add_type("cp", ROUTE_CHANNEL_PRESSURE);
+}
+
+static int cmd_pb(int num_args, char **args)
+{
+    return add_type("pb", ROUTE_PITCH_BEND);
+}
+
+static int cmd_sr(int num_args, char **args)
+{
+    return add_type("sr", ROUTE_SYS_REAL_TIME);
+}
+
+static int cmd_sc(int num_args, char **args)
+{
+    return add_type("sc", ROUTE_SYS_COMMON);
+}
+
+static int cmd_syx(int num_args, char **args)
+{
+    return add_type("syx", ROUTE_SYS_EX);
+}
+
+static int cmd_file(int num_args, char **args)
+{
+    return handle_file(*args);
+}
+
+/* command table */
+static cmd_t command_table[] = {
+    { "in", "input", 1, cmd_in },
+    { "out", "output", 1, cmd_out },
+    { "ch", "channel", 2, cmd_ch },
+    { "tr", "transpose", 1, cmd_tr },
+    /* type filter */
+    { "voice", NULL, 0, cmd_voice },
+    { "note", NULL, 0, cmd_note },
+    { "pp", "poly-pressure", 0, cmd_pp },
+    { "cc", "control-change", 0, cmd_cc },
+    { "pc", "program-change", 0, cmd_pc },
+    { "cp", "channel-pressure", 0, cmd_cp },
+    { "pb", "pitch-bend", 0, cmd_pb },
+    { "sr", "system-realtime", 0, cmd_sr },
+    { "sc", "system-common", 0, cmd_sc },
+    { "syx", "system-exclusive", 0, cmd_syx },
+    /* misc */
+    { "file", NULL, 1, cmd_file },
+    { NULL, NULL, 0, NULL } /* terminator */
+};
+
+static char **handle_other(char **args)
+{
+    // try a file
+    if(handle_file(*args)==0) {
+        return args+1;
+    }
+    else {
+        return NULL;
+    }
+}
+
+static int handle_file(char *file_name)
+{
+    // does file exist?
+    BPTR lock = Lock(file_name, ACCESS_READ);
+    if(lock == NULL) {
+        Printf("File not found: %s\n", file_name);
+        return 1;
+    }
+    UnLock(lock);
+
+    if(verbose) {
+        Printf("Executing commands from: %s\n", file_name);
+    }
+
+    return cmd_exec_file(file_name, command_table, handle_other);
+}
+
+/* --- main --- */
+
+static void show_stats(void)
+{
+    Printf("received %ld messages\n", num_in_msgs);
+    for(int i=0;i<num_inputs;i++) {
+        struct port *in = &inputs[i];
+        for(struct route *r = in->routes; r != NULL; r = r->next) {
+            Printf("%s -> %s: %ld\n", in->name, r->out->name, r->num_msgs);
+        }
+    }
+    if(num_dropped_sysex > 0) {
+        Printf("dropped sysex: %ld\n", num_dropped_sysex);
+    }
+}
+
+static void close_links(void)
+{
+    /* inputs first: no more messages to route */
+    for(int i=0;i<num_inputs;i++) {
+        RemoveMidiLink(inputs[i].link);
+    }
+    for(int i=0;i<num_outputs;i++) {
+        RemoveMidiLink(outputs[i].link);
+    }
+    num_inputs = 0;
+    num_outputs = 0;
+}
+
+static int run(char **cmd_line)
+{
+    MidiMsg msg;
+    BOOL alive = TRUE;
+    ULONG sigmask;
+
+    /* one node for all links */
+    midi_setup.rx_name = NULL;
+    midi_setup.tx_name = NULL;
+    midi_setup.midi_name = "midi-route";
+    int res = midi_open(&midi_setup);
+    if(res != 0) {
+        midi_close(&midi_setup);
+        return res;
+    }
+
+    /* parse commands */
+    char **result = cmd_exec_cmd_line(cmd_line, command_table, handle_other);
+    if(result != NULL) {
+        Printf("Failed parsing cmd: %s\n", *result);
+        close_links();
+        midi_close(&midi_setup);
+        return RETURN_ERROR;
+    }
+
+    if(num_routes == 0) {
+        PutStr("ERROR: no routes given! use 'in' and 'out'\n");
+        close_links();
+        midi_close(&midi_setup);
+        return RETURN_ERROR;
+    }
+
+    compile_routes();
+
+    Printf("midi-route: %ld routes running. Press Ctrl+C to abort.\n",
+           num_routes);
+
+    /* main loop: all inputs share the queue of the node */
+    while(alive) {
+        sigmask = Wait(SIGBREAKF_CTRL_C | 1L<<midi_setup.rx_sig);
+        if(sigmask & SIGBREAKF_CTRL_C)
+            alive=FALSE;
+        while(GetMidi(midi_setup.node, &msg)) {
+            num_in_msgs++;
+            route_msg(&msg);
+        }
+
+        /* report lost messages of the node */
+        UBYTE err = midi_check_errors(&midi_setup);
+        if(err != 0) {
+            midi_show_errors(err);
+        }
+    }
+
+    if(verbose) {
+        show_stats();
+    }
+    if(midi_num_errors(&midi_setup) > 0) {
+        PutStr("CAMD node errors:\n");
+        midi_print_errors(&midi_setup);
+    }
+
+    close_links();
+    midi_close(&midi_setup);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+    int result = RETURN_ERROR;
+
+    DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
+    if(DOSBase != NULL) {
+        UtilityBase = (struct UtilityBase *)OpenLibrary("utility.library", 0);
+        if(UtilityBase != NULL) {
+
+            /* First parse args */
+            args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+            if(args == NULL) {
+                PrintFault(IoErr(), "Args Error");
+                return RETURN_ERROR;
+            }
+
+            /* check params */
+            char **cmds = params.cmds;
+            if((cmds == NULL) || cmds[0]==NULL) {
+                PutStr("No commands given!\n");
+            }
+            /* run tool */
+            else {
+                if(params.verbose != NULL) {
+                    verbose = 1;
+                }
+
+                /* max size for sysex */
+                midi_setup.sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
+                if(params.sysex_max_size != NULL) {
+                    midi_setup.sysex_max_size = *params.sysex_max_size;
+                }
+                /* depth of the node's message queue */
+                if(params.msg_queue != NULL) {
+                    midi_setup.msg_queue_size = *params.msg_queue;
+                }
+
+                result = run(cmds);
+            }
+
+            FreeArgs(args);
+            CloseLibrary((struct Library *)UtilityBase);
+        }
+    }
+    CloseLibrary((struct Library *)DOSBase);
+    return result;
+}
@@ -8,9 +8,12 @@
 #include <midi/camd.h>
 #include <midi/mididefs.h>
 #include <utility/tagitem.h>
+#include <string.h>
 
 #include "midi-setup.h"
 #include "midi-tools.h"
+#include "midi-capture.h"
+#include "midi-events.h"
 #include "cmd.h"
 
 static int handle_file(char *file_name);
@@ -18,10 +21,20 @@ static int handle_file(char *file_name);
 static const char *TEMPLATE = 
     "V=VERBOSE/S,"
     "SMS=SYSEXMAXSIZE/K/N,"
+    "MQ=MSGQUEUE/K/N,"
+    "MA=MAXARGS/K/N,"
+    "LBS=LINEBUFSIZE/K/N,"
+    "PP=PREPARSE/S,"
+    "C=COMPILE/S,"
     "CMDS/M";
 typedef struct {
     LONG *verbose;
     ULONG *sysex_max_size;
+    ULONG *msg_queue;
+    ULONG *max_args;
+    ULONG *line_buf_size;
+    LONG *preparse;
+    LONG *compile;
     char **cmds;
 } params_t;
 
@@ -39,19 +52,49 @@ static struct MidiSetup midi_setup;
 /* command state */
 static int midi_channel = 0; /* 0..15 */
 static LONG last_timestamp = 0;
+/* schedule: deadline of the current command */
+static BOOL sched_valid = FALSE;
+static struct timeval sched_time;
+/* preparse: collect events and play them after parsing */
+static BOOL preparse;
+static struct midi_events events;
+/* compile: cache the events of command files */
+static BOOL compile;
+#define COMPILED_EXT ".mev"
+/* nesting of compiled files. a file reading other files is not cached */
+static int compile_level;
+static BOOL compile_reads_files;
+
+static void note_file_read(void)
+{
+    if(compile_level > 0) {
+        compile_reads_files = TRUE;
+    }
+}
 
 /* send midi */
+static void midi_put(ULONG msg)
+{
+    if(tx == NULL) {
+        Printf("No device set!\n");
+    }
+    else if(preparse) {
+        if(midi_events_add_msg(&events, &sched_time, msg) != 0) {
+            PutStr("Out of memory!\n");
+        }
+    }
+    else {
+        PutMidi(tx, msg);
+    }
+}
+
 static void midi3(UBYTE status, UBYTE data1, UBYTE data2)
 {
     MidiCmd mc;
     mc.mm_Status = status;
     mc.mm_Data1 = data1;
     mc.mm_Data2 = data2;
-    if(tx != NULL) {
-        PutMidi(tx, mc.cmd);
-    } else {
-        Printf("No device set!\n");
-    }
+    midi_put(mc.cmd);
 }
 
 static void midi2(UBYTE status, UBYTE data1)
@@ -59,31 +102,29 @@ static void midi2(UBYTE status, UBYTE data1)
     MidiCmd mc;
     mc.mm_Status = status;
     mc.mm_Data1 = data1;
-    if(tx != NULL) {
-        PutMidi(tx, mc.cmd);
-    } else {
-        Printf("No device set!\n");
-    }
+    midi_put(mc.cmd);
 }
 
 static void midi1(UBYTE status)
 {
     MidiCmd mc;
     mc.mm_Status = status;
-    if(tx != NULL) {
-        PutMidi(tx, mc.cmd);
-    } else {
-        Printf("No device set!\n");
-    }
+    midi_put(mc.cmd);
 }
 
-static void midi_sysex(char *data)
+static void midi_sysex(UBYTE *data, ULONG size)
 {
-    if(tx != NULL) {
-        PutSysEx(tx, data);
-    } else {
+    if(tx == NULL) {
         Printf("No device set!\n");
     }
+    else if(preparse) {
+        if(midi_events_add_sysex(&events, &sched_time, data, size) != 0) {
+            PutStr("Out of memory!\n");
+        }
+    }
+    else {
+        PutSysEx(tx, data);
+    }
 }
 
 static void midi_cc(UBYTE ctl, UBYTE val)
@@ -388,7 +429,7 @@ static int cmd_syx(int num_args, char **args)
     }
 
     /* send sysex */
-    midi_sysex(data);
+    midi_sysex(data, buf_len);
 
     /* free buffer */
     FreeVec(data);
@@ -397,6 +438,8 @@ static int cmd_syx(int num_args, char **args)
 
 static int cmd_syf(int num_args, char **args)
 {
+    note_file_read();
+
     BPTR fh = Open((STRPTR)*args, MODE_OLDFILE);
     if(fh == NULL) {
         Printf("Error opening sysex file: %s\n", *args);
@@ -420,7 +463,7 @@ static int cmd_syf(int num_args, char **args)
 
         /* check if its a sysex file */
         if((data[0] == MS_SysEx) && (data[buf_len-1] == MS_EOX)) {
-            midi_sysex(data);
+            midi_sysex(data, buf_len);
             if(verbose) {
                 PutStr("sys ex: ");
                 for(int i=0;i<buf_len;i++) {
@@ -501,10 +544,99 @@ static int cmd_file(int num_args, char **args)
     return handle_file(*args);
 }
 
+static int cmd_play(int num_args, char **args)
+{
+    struct midi_capture capture;
+    struct midi_capture_record rec;
+    struct timeval start;
+    struct timeval first;
+    struct timeval deadline;
+    UBYTE *buf = midi_setup.sysex_buf;
+    ULONG buf_size = midi_setup.sysex_buf_size;
+
+    if(tx == NULL) {
+        Printf("No device set!\n");
+        return 1;
+    }
+
+    note_file_read();
+    if(midi_capture_open_read(&capture, *args) != MIDI_CAPTURE_OK) {
+        Printf("Error opening capture file: %s\n", *args);
+        return 1;
+    }
+    if(verbose)
+        Printf("play: %s\n", *args);
+
+    /* replay all records relative to the time stamp of the first one.
+       a running schedule continues at its deadline */
+    int ret_code = 0;
+    if(sched_valid) {
+        start = sched_time;
+    } else if(preparse) {
+        start.tv_secs = 0;
+        start.tv_micro = 0;
+    } else {
+        midi_tools_get_time(&start);
+    }
+    deadline = start;
+    while(1) {
+        int res = midi_capture_read(&capture, &rec, buf, buf_size);
+        if(res == MIDI_CAPTURE_EOF) {
+            break;
+        }
+        else if(res == MIDI_CAPTURE_ERROR_SIZE) {
+            Printf("sysex too large: %ld. skipping.\n", rec.size);
+            continue;
+        }
+        else if(res != MIDI_CAPTURE_OK) {
+            Printf("Error reading capture file: %s\n", *args);
+            ret_code = 2;
+            break;
+        }
+
+        if(capture.num_records == 1) {
+            first = rec.time_stamp;
+        }
+        deadline = rec.time_stamp;
+        SubTime(&deadline, &first);
+        AddTime(&deadline, &start);
+        sched_time = deadline;
+        if(!preparse) {
+            midi_tools_wait_until(&deadline);
+        }
+
+        if(rec.flags & MIDI_CAPTURE_FLAG_SYSEX) {
+            midi_sysex(buf, rec.size);
+        }
+        else if(rec.size == 3) {
+            midi3(buf[0], buf[1], buf[2]);
+        }
+        else if(rec.size == 2) {
+            midi2(buf[0], buf[1]);
+        }
+        else if(rec.size == 1) {
+            midi1(buf[0]);
+        }
+    }
+
+    /* following time stamps are relative to the last replayed message */
+    sched_time = deadline;
+    sched_valid = TRUE;
+
+    if(verbose)
+        Printf("played %ld messages\n", capture.num_records);
+    midi_capture_close(&capture);
+    return ret_code;
+}
+
 static int cmd_dev(int num_args, char **args)
 {
     /* close old? */
     if(tx != NULL) {
+        if(preparse) {
+            PutStr("Only a single device is allowed in preparse mode!\n");
+            return 1;
+        }
         if(verbose)
             PutStr("closing midi device");
         midi_close(&midi_setup);
@@ -559,10 +691,42 @@ static cmd_t command_table[] = {
     { "tun", "tune-request", 0, cmd_tun },
     /* misc */
     { "file", NULL, 1, cmd_file },
+    { "play", NULL, 1, cmd_play },
     { "dev", "device", 1, cmd_dev },
     { NULL, 0, NULL } /* terminator */
 };
 
+/* advance the schedule by the given millis and wait for the deadline */
+static void advance_schedule(LONG millis)
+{
+    /* first time stamp sets base */
+    if(!sched_valid) {
+        if(preparse) {
+            sched_time.tv_secs = 0;
+            sched_time.tv_micro = 0;
+        } else {
+            midi_tools_get_time(&sched_time);
+        }
+        sched_valid = TRUE;
+    }
+
+    /* accumulate on the deadline and not on the wake up time to avoid drift */
+    if(millis > 0) {
+        struct timeval delta;
+        delta.tv_secs = millis / 1000;
+        delta.tv_micro = (millis % 1000) * 1000;
+        AddTime(&sched_time, &delta);
+    }
+
+    if(verbose) {
+        Printf("schedule: %ld.%06ld\n", sched_time.tv_secs, sched_time.tv_micro);
+    }
+
+    if(!preparse) {
+        midi_tools_wait_until(&sched_time);
+    }
+}
+
 static int handle_timestamp(char *arg)
 {
     int rel = 0;
@@ -581,23 +745,16 @@ static int handle_timestamp(char *arg)
 
     // relative
     if(rel) {
-        LONG ticks = millis / 20; // 50 Hz
-        if(verbose) {
-            Printf("waiting ticks: %ld\n", ticks);
-        }
-        Delay(ticks);
+        advance_schedule(millis);
         last_timestamp += millis;
     }
     // absolute
     else {
         // calc delta to last time stamp
         if(last_timestamp > 0) {
-            LONG delta = millis - last_timestamp;
-            LONG ticks = delta / 20;
-            if(verbose) {
-                Printf("waiting ticks: %ld\n", ticks);
-            }
-            Delay(ticks);
+            advance_schedule(millis - last_timestamp);
+        } else {
+            advance_schedule(0);
         }
         last_timestamp = millis;
     }
@@ -619,8 +776,160 @@ static char **handle_other(char **args)
     }
 }
 
+static int get_file_date(char *file_name, struct DateStamp *ds)
+{
+    BPTR lock = Lock(file_name, ACCESS_READ);
+    if(lock == NULL) {
+        return 1;
+    }
+
+    int ret_code = 2;
+    struct FileInfoBlock *fib = AllocDosObject(DOS_FIB, NULL);
+    if(fib != NULL) {
+        if(Examine(lock, fib)) {
+            *ds = fib->fib_Date;
+            ret_code = 0;
+        }
+        FreeDosObject(DOS_FIB, fib);
+    }
+    UnLock(lock);
+    return ret_code;
+}
+
+static void get_state(struct midi_events_state *st)
+{
+    st->channel = midi_channel;
+    st->hex_mode = midi_tools_get_hex_mode();
+    st->octave_middle_c = midi_tools_get_octave_middle_c();
+    st->last_timestamp = last_timestamp;
+}
+
+static void set_state(struct midi_events_state *st)
+{
+    midi_channel = st->channel;
+    midi_tools_set_hex_mode(st->hex_mode);
+    midi_tools_set_octave_middle_c(st->octave_middle_c);
+    last_timestamp = st->last_timestamp;
+}
+
+/* compiled file exists and is not older than the script? */
+static BOOL is_compiled_valid(char *file_name, char *mev_name)
+{
+    struct DateStamp src_date;
+    struct DateStamp mev_date;
+
+    if(get_file_date(mev_name, &mev_date) != 0) {
+        return FALSE;
+    }
+    if(get_file_date(file_name, &src_date) != 0) {
+        return FALSE;
+    }
+    return CompareDates(&mev_date, &src_date) <= 0;
+}
+
+/* parse a command file into its own event list with a schedule starting at 0.
+   the last time stamp is kept: absolute stamps continue from the caller
+   and the last one of the file is carried back */
+static int compile_file(char *file_name, struct midi_events *file_events,
+                        struct timeval *end_time, BOOL *reads_files)
+{
+    struct midi_events outer_events = events;
+    struct timeval outer_time = sched_time;
+    BOOL outer_valid = sched_valid;
+    BOOL outer_reads_files = compile_reads_files;
+
+    midi_events_init(&events);
+    sched_time.tv_secs = 0;
+    sched_time.tv_micro = 0;
+    sched_valid = FALSE;
+    compile_reads_files = FALSE;
+
+    compile_level++;
+    int res = cmd_exec_file(file_name, command_table, handle_other);
+    compile_level--;
+
+    *file_events = events;
+    *end_time = sched_time;
+    *reads_files = compile_reads_files;
+
+    events = outer_events;
+    sched_time = outer_time;
+    sched_valid = outer_valid;
+    compile_reads_files = outer_reads_files;
+    return res;
+}
+
+static int handle_compiled_file(char *file_name)
+{
+    struct midi_events file_events;
+    struct timeval end_time;
+    struct midi_events_state enter;
+    struct midi_events_state leave;
+
+    /* the events are bound to the device so it has to be set before */
+    if(tx == NULL) {
+        Printf("No device set!\n");
+        return 1;
+    }
+
+    char *mev_name = AllocVec(strlen(file_name) + sizeof(COMPILED_EXT), 0);
+    if(mev_name == NULL) {
+        PutStr("Out of memory!\n");
+        return 1;
+    }
+    strcpy(mev_name, file_name);
+    strcat(mev_name, COMPILED_EXT);
+
+    /* the commands depend on the state when the file is entered */
+    int res = 1;
+    midi_events_init(&file_events);
+    get_state(&enter);
+    if(is_compiled_valid(file_name, mev_name) &&
+       (midi_events_load(&file_events, mev_name, &end_time, &enter, &leave) == MIDI_EVENTS_OK)) {
+        if(verbose) {
+            Printf("Using compiled commands from: %s\n", mev_name);
+        }
+        /* as if the commands had run */
+        set_state(&leave);
+        res = 0;
+    } else {
+        BOOL reads_files;
+        if(verbose) {
+            Printf("Compiling commands from: %s\n", file_name);
+        }
+        res = compile_file(file_name, &file_events, &end_time, &reads_files);
+        if(res == 0) {
+            /* the dates of the other files are not tracked */
+            if(reads_files) {
+                if(verbose) {
+                    Printf("Not caching %s: it reads other files\n", file_name);
+                }
+                DeleteFile((STRPTR)mev_name);
+            } else {
+                get_state(&leave);
+                if(midi_events_save(&file_events, mev_name, &end_time, &enter, &leave) != MIDI_EVENTS_OK) {
+                    Printf("Error writing compiled file: %s\n", mev_name);
+                }
+            }
+        }
+    }
+
+    /* add events of file after the current schedule */
+    if(res == 0) {
+        midi_events_append(&events, &file_events, &sched_time);
+        AddTime(&sched_time, &end_time);
+        sched_valid = TRUE;
+    }
+
+    midi_events_free(&file_events);
+    FreeVec(mev_name);
+    return res;
+}
+
 static int handle_file(char *file_name)
 {
+    note_file_read();
+
     // does file exist?
     BPTR lock = Lock(file_name, ACCESS_READ);
     if(lock == NULL) {
@@ -629,6 +938,10 @@ static int handle_file(char *file_name)
     }
     UnLock(lock);
 
+    if(compile) {
+        return handle_compiled_file(file_name);
+    }
+
     if(verbose) {
         Printf("Executing commands from: %s\n", file_name);
     }
@@ -636,11 +949,49 @@ static int handle_file(char *file_name)
     return cmd_exec_file(file_name, command_table, handle_other);
 }
 
+static void play_events(void)
+{
+    struct timeval start;
+    struct timeval deadline;
+
+    if(tx == NULL) {
+        return;
+    }
+    if(verbose)
+        Printf("playing %ld events\n", events.num_events);
+
+    midi_tools_get_time(&start);
+    struct midi_event_block *block = events.first;
+    while(block != NULL) {
+        struct midi_event *ev = block->events;
+        for(ULONG i=0;i<block->num;i++) {
+            deadline = ev->time;
+            AddTime(&deadline, &start);
+            midi_tools_wait_until(&deadline);
+
+            if(ev->sysex != NULL) {
+                PutSysEx(tx, ev->sysex);
+            } else {
+                PutMidi(tx, ev->msg);
+            }
+            ev++;
+        }
+        block = block->next;
+    }
+}
+
 static int run(char **cmd_line, ULONG sysex_max_size)
 {
     midi_setup.sysex_max_size = sysex_max_size;
     midi_setup.rx_name = NULL;
     tx = NULL;
+    midi_events_init(&events);
+
+    int rc = midi_tools_init_time();
+    if(rc != 0) {
+        Printf("ERROR: setting up timer! (%ld)\n", rc);
+        return RETURN_ERROR;
+    }
 
     /* parse commands */
     int retcode = 0;
@@ -649,11 +1000,18 @@ static int run(char **cmd_line, ULONG sysex_max_size)
         Printf("Failed parsing cmd: %s\n", *result);
         retcode = RETURN_ERROR;
     }
+    /* now play all parsed events */
+    else if(preparse) {
+        play_events();
+    }
+    midi_events_free(&events);
 
     if(tx != NULL) {
         midi_close(&midi_setup);
     }
 
+    midi_tools_exit_time();
+
     return 0;
 }
 
@@ -685,12 +1043,32 @@ int main(int argc, char **argv)
                 if(params.verbose != NULL) {
                     verbose = 1;
                 }
+                if(params.preparse != NULL) {
+                    preparse = TRUE;
+                }
+                /* compiled files are always played after parsing */
+                if(params.compile != NULL) {
+                    compile = TRUE;
+                    preparse = TRUE;
+                }
+
+                /* command file limits */
+                if(params.max_args != NULL) {
+                    cmd_set_max_args(*params.max_args);
+                }
+                if(params.line_buf_size != NULL) {
+                    cmd_set_line_buf_size(*params.line_buf_size);
+                }
 
                 /* max size for sysex */
-                ULONG sysex_max_size = 2048;
+                ULONG sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
                 if(params.sysex_max_size != NULL) {
                     sysex_max_size = *params.sysex_max_size;
                 }
+                /* depth of the node's message queue */
+                if(params.msg_queue != NULL) {
+                    midi_setup.msg_queue_size = *params.msg_queue;
+                }
 
                 result = run(cmds, sysex_max_size);
             }
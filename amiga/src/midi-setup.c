@@ -11,15 +11,39 @@
 
 struct Library *CamdBase;
 
+static char *error_names[MIDI_SETUP_NUM_ERRORS] = {
+    "msg error",
+    "buffer full",
+    "sysex full",
+    "parse memory",
+    "receive error",
+    "receive overflow",
+    "sysex too big"
+};
+
 int midi_open(struct MidiSetup *ms)
 {
     ms->rx_sig = -1;
     ms->node = NULL;
     ms->rx_link = NULL;
     ms->tx_link = NULL;
+    ms->hook_node = NULL;
+    ms->hook_link = NULL;
+    for(int i=0;i<MIDI_SETUP_NUM_ERRORS;i++) {
+        ms->err_count[i] = 0;
+    }
+
+    ULONG msg_queue_size = ms->msg_queue_size;
+    if(msg_queue_size == 0) {
+        msg_queue_size = MIDI_SETUP_DEFAULT_MSG_QUEUE;
+    }
 
     /* sysex buf */
-    ms->sysex_buf = AllocVec(ms->sysex_max_size, 0);
+    /* sysex buf may be smaller than the sysex queue of the node */
+    if(ms->sysex_buf_size == 0) {
+        ms->sysex_buf_size = ms->sysex_max_size;
+    }
+    ms->sysex_buf = AllocVec(ms->sysex_buf_size, 0);
     if(ms->sysex_buf == NULL) {
         PutStr("No memory for sysec buffer!\n");
         return 6;
@@ -39,9 +63,12 @@ int midi_open(struct MidiSetup *ms)
     }
 
     /* create midi node */
-    ms->node = CreateMidi(MIDI_MsgQueue, 2048L,
+    /* errors also raise the receive signal */
+    ms->node = CreateMidi(MIDI_MsgQueue, msg_queue_size,
                 MIDI_SysExSize, ms->sysex_max_size,
                 MIDI_RecvSignal, ms->rx_sig,
+                MIDI_ErrFilter, CMEF_All,
+                MIDI_RecvHook, ms->rx_hook,
                 MIDI_Name, ms->midi_name,
                 TAG_END);
     if(ms->node == NULL) {
@@ -60,10 +87,36 @@ int midi_open(struct MidiSetup *ms)
         }
     }
 
+    /* hook only: CAMD still queues each message of a node. so all but
+       sysex goes to a second node with a minimal queue and no signal that
+       only calls the hook. sysex data is bound to a queue and stays in the
+       main node, which also calls the hook to keep the order */
+    if(ms->rx_hook_only && (ms->rx_hook != NULL) && (ms->rx_link != NULL)) {
+        ms->hook_node = CreateMidi(MIDI_MsgQueue, MIDI_SETUP_HOOK_MSG_QUEUE,
+                    MIDI_ErrFilter, 0,
+                    MIDI_RecvHook, ms->rx_hook,
+                    MIDI_Name, ms->midi_name,
+                    TAG_END);
+        if(ms->hook_node == NULL) {
+            PutStr("Error creating midi hook node!\n");
+            return 3;
+        }
+        ms->hook_link = AddMidiLink(ms->hook_node, MLTYPE_Receiver,
+            MLINK_Location, ms->rx_name,
+            MLINK_EventMask, CMF_All & ~CMF_SysEx,
+            TAG_END);
+        if(ms->hook_link == NULL) {
+            Printf("Error creating rx link to '%s'\n", ms->rx_name);
+            return 4;
+        }
+        SetMidiLinkAttrs(ms->rx_link, MLINK_EventMask, CMF_SysEx, TAG_END);
+    }
+
     /* tx_link */
     if(ms->tx_name != NULL) {
         ms->tx_link = AddMidiLink(ms->node, MLTYPE_Sender,
             MLINK_Location, ms->tx_name,
+            MLINK_Parse, ms->tx_parse,
             TAG_END);
         if(ms->tx_link == NULL) {
             Printf("Error creating tx link to '%s'\n", ms->tx_name);
@@ -77,12 +130,19 @@ int midi_open(struct MidiSetup *ms)
 
 void midi_close(struct MidiSetup *ms)
 {
-    if(ms->tx_link != NULL) {
-        RemoveMidiLink(ms->tx_link);
+    /* rx first: a receive hook may still send on tx */
+    if(ms->hook_link != NULL) {
+        RemoveMidiLink(ms->hook_link);
     }
     if(ms->rx_link != NULL) {
         RemoveMidiLink(ms->rx_link);
     }
+    if(ms->tx_link != NULL) {
+        RemoveMidiLink(ms->tx_link);
+    }
+    if(ms->hook_node != NULL) {
+        DeleteMidi(ms->hook_node);
+    }
     if(ms->node != NULL) {
         DeleteMidi(ms->node);
     }
@@ -96,3 +156,63 @@ void midi_close(struct MidiSetup *ms)
         FreeVec(ms->sysex_buf);
     }
 }
+
+/* filter the input. with a hook node sysex stays on the rx link */
+void midi_set_rx_masks(struct MidiSetup *ms, ULONG event_mask, UWORD channel_mask)
+{
+    if(ms->hook_link != NULL) {
+        SetMidiLinkAttrs(ms->hook_link, MLINK_EventMask, event_mask & ~CMF_SysEx,
+                         MLINK_ChannelMask, channel_mask,
+                         TAG_END);
+        event_mask &= CMF_SysEx;
+    }
+    SetMidiLinkAttrs(ms->rx_link, MLINK_EventMask, event_mask,
+                     MLINK_ChannelMask, channel_mask,
+                     TAG_END);
+}
+
+/* fetch and count the errors of the node since the last call */
+UBYTE midi_check_errors(struct MidiSetup *ms)
+{
+    if(ms->node == NULL) {
+        return 0;
+    }
+
+    UBYTE err = GetMidiErr(ms->node);
+    if(err != 0) {
+        for(int i=0;i<MIDI_SETUP_NUM_ERRORS;i++) {
+            if(err & (1 << i)) {
+                ms->err_count[i]++;
+            }
+        }
+    }
+    return err;
+}
+
+ULONG midi_num_errors(struct MidiSetup *ms)
+{
+    ULONG sum = 0;
+    for(int i=0;i<MIDI_SETUP_NUM_ERRORS;i++) {
+        sum += ms->err_count[i];
+    }
+    return sum;
+}
+
+/* the errors of one midi_check_errors() result */
+void midi_show_errors(UBYTE err)
+{
+    for(int i=0;i<MIDI_SETUP_NUM_ERRORS;i++) {
+        if(err & (1 << i)) {
+            Printf("CAMD error: %s\n", error_names[i]);
+        }
+    }
+}
+
+void midi_print_errors(struct MidiSetup *ms)
+{
+    for(int i=0;i<MIDI_SETUP_NUM_ERRORS;i++) {
+        if(ms->err_count[i] > 0) {
+            Printf("%s: %ld\n", error_names[i], ms->err_count[i]);
+        }
+    }
+}
@@ -3,21 +3,46 @@
 
 extern struct Library *CamdBase;
 
+#define MIDI_SETUP_DEFAULT_MSG_QUEUE    2048
+#define MIDI_SETUP_DEFAULT_SYSEX_SIZE   2048
+
+/* queue of the hook node. it is never read: the hook sees all messages */
+#define MIDI_SETUP_HOOK_MSG_QUEUE       1
+
+/* number of CAMD error bits (CMEB_*) counted */
+#define MIDI_SETUP_NUM_ERRORS           7
+
 struct MidiSetup {
     /* input */
     char            *rx_name;
     char            *tx_name;
     char            *midi_name;
     ULONG            sysex_max_size;
+    ULONG            msg_queue_size;    /* 0 for default */
+    ULONG            sysex_buf_size;    /* 0 for sysex_max_size */
+    struct Hook     *rx_hook;   /* optional receive hook or NULL */
+    BOOL             rx_hook_only;  /* only sysex is queued and signalled */
+    BOOL             tx_parse;  /* allow ParseMidi() on tx link */
     /* state */
     struct MidiNode *node;
     struct MidiLink *rx_link;
     struct MidiLink *tx_link;
+    struct MidiNode *hook_node; /* rx_hook_only: gets all but sysex */
+    struct MidiLink *hook_link;
     UBYTE           *sysex_buf;
     BYTE             rx_sig;
+    /* how often each CAMD error bit was reported */
+    ULONG            err_count[MIDI_SETUP_NUM_ERRORS];
 };
 
 extern int midi_open(struct MidiSetup *ms);
 extern void midi_close(struct MidiSetup *ms);
 
+extern void midi_set_rx_masks(struct MidiSetup *ms, ULONG event_mask, UWORD channel_mask);
+
+extern UBYTE midi_check_errors(struct MidiSetup *ms);
+extern ULONG midi_num_errors(struct MidiSetup *ms);
+extern void midi_show_errors(UBYTE err);
+extern void midi_print_errors(struct MidiSetup *ms);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,481 @@
+#define USE_INLINE_STDARG
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/camd.h>
+
+#include <midi/camd.h>
+#include <midi/mididefs.h>
+#include <utility/tagitem.h>
+#include <utility/hooks.h>
+
+#include "drv/compiler.h"
+#include "drv/eclock.h"
+#include "midi-setup.h"
+#include "midi-tools.h"
+#include "midi-output.h"
+
+static const char *TEMPLATE =
+    "CLUSTERS/A/M,"
+    "I=INTERVAL/K/N,"
+    "SMS=SYSEXMAXSIZE/K/N,"
+    "MQ=MSGQUEUE/K/N,"
+    "S=SCROLL/S";
+typedef struct {
+    char **clusters;
+    ULONG *interval;
+    ULONG *sysex_max_size;
+    ULONG *msg_queue;
+    LONG *scroll;
+} params_t;
+static params_t params;
+
+struct DosLibrary *DOSBase;
+
+#define MAX_CLUSTERS        8
+
+/* message classes */
+#define CLASS_NOTE          0
+#define CLASS_POLY          1
+#define CLASS_CTRL          2
+#define CLASS_PROG          3
+#define CLASS_CHAN          4
+#define CLASS_BEND          5
+#define CLASS_SYSCOM        6
+#define CLASS_CLOCK         7
+#define CLASS_REALTIME      8
+#define CLASS_SYSEX         9
+#define NUM_CLASSES         10
+
+static const char *class_names[NUM_CLASSES] = {
+    "note", "poly", "ctrl", "prog", "chan", "bend",
+    "sys", "clock", "rt", "sysex"
+};
+
+/* clock intervals measured in the hook. 300 BPM give 120 clocks per
+   second: the ring holds two update intervals of them */
+#define MAX_CLOCKS_PER_SEC  120
+#define MIN_CLOCK_RING_SIZE 256
+#define MIN_INTERVAL_MS     100
+#define MAX_INTERVAL_MS     60000
+
+struct cluster_stat {
+    struct MidiSetup    setup;
+    struct Hook         hook;
+
+    /* written by the hook: only ever incremented */
+    volatile ULONG      msgs[NUM_CLASSES];
+    volatile ULONG      bytes;
+    ULONG               last_clock;
+    BOOL                have_clock;
+    ULONG              *clock_ring;
+    volatile UWORD      clock_put;
+    volatile ULONG      clock_overflows;
+
+    /* task side */
+    UWORD               clock_get;
+    ULONG               sysex_bytes;
+    ULONG               last_msgs[NUM_CLASSES];
+    ULONG               last_bytes;
+    ULONG               last_sysex_bytes;
+    ULONG               num_errors;
+    ULONG              *clock_us;
+};
+
+static struct cluster_stat clusters[MAX_CLUSTERS];
+static int num_clusters;
+static ULONG max_clock_ticks;
+static ULONG clock_ring_size;
+static UWORD clock_ring_mask;
+/* line end: clear the rest of the old line when redrawing in place */
+static char *eol = "\033[K\n";
+
+static ULONG isqrt(ULONG val)
+{
+    ULONG res = 0;
+    ULONG bit = 1UL << 30;
+    while(bit > val) {
+        bit >>= 2;
+    }
+    while(bit != 0) {
+        if(val >= res + bit) {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+static UBYTE get_class(UBYTE status)
+{
+    if(status < MS_System) {
+        switch(status & MS_StatBits) {
+            case MS_NoteOff:
+            case MS_NoteOn:
+                return CLASS_NOTE;
+            case MS_PolyPress:
+                return CLASS_POLY;
+            case MS_Ctrl:
+                return CLASS_CTRL;
+            case MS_Prog:
+                return CLASS_PROG;
+            case MS_ChanPress:
+                return CLASS_CHAN;
+            default:
+                return CLASS_BEND;
+        }
+    }
+    if(status == MS_SysEx) {
+        return CLASS_SYSEX;
+    }
+    if(status == MS_Clock) {
+        return CLASS_CLOCK;
+    }
+    if(status >= MS_RealTime) {
+        return CLASS_REALTIME;
+    }
+    return CLASS_SYSCOM;
+}
+
+static UBYTE get_size(UBYTE status)
+{
+    if(status < MS_System) {
+        UBYTE cmd = status & MS_StatBits;
+        return ((cmd == MS_Prog) || (cmd == MS_ChanPress)) ? 2 : 3;
+    }
+    switch(status) {
+        case MS_QtrFrame:
+        case MS_SongSelect:
+            return 2;
+        case MS_SongPos:
+            return 3;
+        case MS_SysEx:
+            /* counted when the task fetches the data */
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/* receive hook: count in the context of the sender. only clocks are
+   stamped */
+static SAVEDS ASM ULONG stat_hook_func(REG(a0, struct Hook *hook),
+                                       REG(a2, struct MidiLink *link),
+                                       REG(a1, MidiMsg *msg))
+{
+    struct cluster_stat *cs = (struct cluster_stat *)hook->h_Data;
+    UBYTE status = msg->mm_Status;
+
+    cs->msgs[get_class(status)]++;
+    cs->bytes += get_size(status);
+
+    if(status == MS_Clock) {
+        ULONG stamp = eclock_stamp();
+        if(cs->have_clock) {
+            ULONG ticks = stamp - cs->last_clock;
+            /* a pause is no jitter */
+            if(ticks < max_clock_ticks) {
+                UWORD put = cs->clock_put;
+                UWORD next = (put + 1) & clock_ring_mask;
+                if(next == cs->clock_get) {
+                    cs->clock_overflows++;
+                } else {
+                    cs->clock_ring[put] = ticks;
+                    cs->clock_put = next;
+                }
+            }
+        }
+        cs->last_clock = stamp;
+        cs->have_clock = TRUE;
+    }
+    /* the clock restarts */
+    else if((status == MS_Start) || (status == MS_Stop)) {
+        cs->have_clock = FALSE;
+    }
+    return 0;
+}
+
+/* only sysex is queued: the hook did the counting */
+static void drain_node(struct cluster_stat *cs)
+{
+    struct MidiNode *node = cs->setup.node;
+    MidiMsg msg;
+
+    while(GetMidi(node, &msg)) {
+        if(msg.mm_Status == MS_SysEx) {
+            cs->sysex_bytes += QuerySysEx(node);
+            SkipSysEx(node);
+        }
+    }
+
+    if(midi_check_errors(&cs->setup) != 0) {
+        cs->num_errors++;
+    }
+}
+
+static ULONG rate(ULONG num, ULONG elapsed_ms)
+{
+    if(elapsed_ms == 0) {
+        return 0;
+    }
+    return (num * 1000 + elapsed_ms / 2) / elapsed_ms;
+}
+
+static void show_clock(struct cluster_stat *cs)
+{
+    ULONG num = 0;
+    ULONG sum = 0;
+
+    while(cs->clock_get != cs->clock_put) {
+        ULONG us = eclock_to_us(cs->clock_ring[cs->clock_get]);
+        cs->clock_get = (cs->clock_get + 1) & clock_ring_mask;
+        cs->clock_us[num++] = us;
+        sum += us;
+    }
+    if(num == 0) {
+        return;
+    }
+
+    ULONG mean = sum / num;
+    ULONG var = 0;
+    ULONG max_dev = 0;
+    for(ULONG i=0;i<num;i++) {
+        ULONG dev = (cs->clock_us[i] > mean) ? cs->clock_us[i] - mean : mean - cs->clock_us[i];
+        if(dev > max_dev) {
+            max_dev = dev;
+        }
+        /* clamp to keep the sum in 32 bits */
+        if(dev > 0xffff) {
+            dev = 0xffff;
+        }
+        var += (dev * dev) / num;
+    }
+    ULONG stddev = isqrt(var);
+
+    /* 24 clocks per quarter note. in 1/10 BPM */
+    ULONG bpm10 = (mean > 0) ? (25000000 + mean / 2) / mean : 0;
+
+    midi_output_printf("  clock: tempo %3ld.%ld BPM  period %5ld us  stddev %4ld us  max dev %5ld us",
+        bpm10 / 10, bpm10 % 10, mean, stddev, max_dev);
+    if(cs->clock_overflows > 0) {
+        midi_output_printf("  (%ld lost)", cs->clock_overflows);
+    }
+    midi_output_str(eol);
+}
+
+static void show_stats(ULONG elapsed_ms, BOOL scroll)
+{
+    if(!scroll) {
+        /* redraw in place */
+        midi_output_str("\033[H");
+    }
+    midi_output_printf("midi-stat: %ld clusters, every %ld ms. Ctrl-C to quit.%s",
+        (LONG)num_clusters, elapsed_ms, eol);
+
+    for(int c=0;c<num_clusters;c++) {
+        struct cluster_stat *cs = &clusters[c];
+        ULONG total = 0;
+
+        midi_output_printf("%s:%s ", cs->setup.rx_name, eol);
+        for(int i=0;i<NUM_CLASSES;i++) {
+            ULONG num = cs->msgs[i];
+            ULONG delta = num - cs->last_msgs[i];
+            cs->last_msgs[i] = num;
+            total += delta;
+            if(delta > 0) {
+                midi_output_printf(" %s %ld/s", class_names[i], rate(delta, elapsed_ms));
+            }
+        }
+        if(total == 0) {
+            midi_output_str(" idle");
+        }
+        midi_output_str(eol);
+
+        ULONG bytes = cs->bytes;
+        ULONG sysex_bytes = cs->sysex_bytes;
+        midi_output_printf("  total %ld msgs/s  %ld bytes/s  sysex %ld bytes/s",
+            rate(total, elapsed_ms),
+            rate(bytes - cs->last_bytes + sysex_bytes - cs->last_sysex_bytes, elapsed_ms),
+            rate(sysex_bytes - cs->last_sysex_bytes, elapsed_ms));
+        if(cs->num_errors > 0) {
+            midi_output_printf("  errors %ld", cs->num_errors);
+        }
+        midi_output_str(eol);
+        cs->last_bytes = bytes;
+        cs->last_sysex_bytes = sysex_bytes;
+
+        show_clock(cs);
+    }
+
+    if(!scroll) {
+        midi_output_str("\033[J");
+    } else {
+        midi_output_str("\n");
+    }
+    midi_output_flush();
+}
+
+static void close_clusters(void)
+{
+    for(int i=0;i<num_clusters;i++) {
+        midi_close(&clusters[i].setup);
+        if(clusters[i].clock_ring != NULL) {
+            FreeVec(clusters[i].clock_ring);
+            clusters[i].clock_ring = NULL;
+        }
+    }
+    num_clusters = 0;
+}
+
+static int open_clusters(char **names, ULONG sysex_max_size, ULONG msg_queue)
+{
+    while((*names != NULL) && (num_clusters < MAX_CLUSTERS)) {
+        struct cluster_stat *cs = &clusters[num_clusters];
+
+        /* intervals and their conversion to us */
+        cs->clock_ring = AllocVec(clock_ring_size * sizeof(ULONG) * 2, MEMF_CLEAR);
+        if(cs->clock_ring == NULL) {
+            PutStr("ERROR: no memory for clock ring!\n");
+            return 1;
+        }
+        cs->clock_us = cs->clock_ring + clock_ring_size;
+
+        cs->hook.h_Entry = (HOOKFUNC)stat_hook_func;
+        cs->hook.h_Data = cs;
+
+        cs->setup.rx_name = *names;
+        cs->setup.tx_name = NULL;
+        cs->setup.midi_name = "midi-stat";
+        cs->setup.sysex_max_size = sysex_max_size;
+        cs->setup.msg_queue_size = msg_queue;
+        cs->setup.sysex_buf_size = 0;
+        cs->setup.rx_hook = &cs->hook;
+        cs->setup.rx_hook_only = TRUE;
+        cs->setup.tx_parse = FALSE;
+
+        num_clusters++;
+        int res = midi_open(&cs->setup);
+        if(res != 0) {
+            return res;
+        }
+        names++;
+    }
+    if(*names != NULL) {
+        Printf("Only %ld clusters are supported!\n", (LONG)MAX_CLUSTERS);
+    }
+    return 0;
+}
+
+static void run(ULONG interval_ms, BOOL scroll)
+{
+    ULONG rx_mask = 0;
+    BOOL alive = TRUE;
+
+    for(int i=0;i<num_clusters;i++) {
+        rx_mask |= 1L << clusters[i].setup.rx_sig;
+    }
+
+    ULONG tick_mask = midi_tools_start_tick(interval_ms * 1000);
+    if(tick_mask == 0) {
+        PutStr("ERROR: setting up tick timer!\n");
+        return;
+    }
+
+    if(scroll) {
+        eol = "\n";
+    } else {
+        PutStr("\033[H\033[J");
+    }
+
+    ULONG last_tick = eclock_stamp();
+
+    while(alive) {
+        ULONG sigmask = Wait(SIGBREAKF_CTRL_C | rx_mask | tick_mask);
+        if(sigmask & SIGBREAKF_CTRL_C) {
+            alive = FALSE;
+        }
+
+        for(int i=0;i<num_clusters;i++) {
+            drain_node(&clusters[i]);
+        }
+
+        if(midi_tools_check_tick()) {
+            ULONG now = eclock_stamp();
+            ULONG elapsed_ms = (eclock_to_us(now - last_tick) + 500) / 1000;
+            last_tick = now;
+            show_stats(elapsed_ms, scroll);
+        }
+    }
+
+    midi_tools_stop_tick();
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+    int result = RETURN_OK;
+
+    DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
+
+    /* First parse args */
+    args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+    if(args == NULL) {
+        PrintFault(IoErr(), "Args Error");
+        return RETURN_ERROR;
+    }
+
+    ULONG interval_ms = 1000;
+    if(params.interval != NULL) {
+        interval_ms = *params.interval;
+        if(interval_ms < MIN_INTERVAL_MS) {
+            interval_ms = MIN_INTERVAL_MS;
+        }
+        if(interval_ms > MAX_INTERVAL_MS) {
+            interval_ms = MAX_INTERVAL_MS;
+        }
+    }
+    ULONG clock_need = MAX_CLOCKS_PER_SEC * 2 * interval_ms / 1000;
+    clock_ring_size = MIN_CLOCK_RING_SIZE;
+    while(clock_ring_size < clock_need) {
+        clock_ring_size <<= 1;
+    }
+    clock_ring_mask = (UWORD)(clock_ring_size - 1);
+    ULONG sysex_max_size = MIDI_SETUP_DEFAULT_SYSEX_SIZE;
+    if(params.sysex_max_size != NULL) {
+        sysex_max_size = *params.sysex_max_size;
+    }
+    ULONG msg_queue = 0;
+    if(params.msg_queue != NULL) {
+        msg_queue = *params.msg_queue;
+    }
+
+    if(midi_output_init(MIDI_OUTPUT_DEFAULT_BUF_SIZE) != 0) {
+        PutStr("ERROR: no memory for output buffer!\n");
+        FreeArgs(args);
+        return RETURN_FAIL;
+    }
+
+    if(midi_tools_init_time() != 0) {
+        PutStr("ERROR: setting up timer!\n");
+        result = RETURN_FAIL;
+    } else {
+        /* longer than a clock at 5 BPM: a pause */
+        max_clock_ticks = eclock_freq / 2;
+
+        if(open_clusters(params.clusters, sysex_max_size, msg_queue) != 0) {
+            result = RETURN_ERROR;
+        } else {
+            run(interval_ms, params.scroll != NULL);
+        }
+        close_clusters();
+        midi_tools_exit_time();
+    }
+
+    midi_output_exit();
+    FreeArgs(args);
+    CloseLibrary((struct Library *)DOSBase);
+    return result;
+}
@@ -5,6 +5,7 @@
 #include <proto/dos.h>
 #include <devices/timer.h>
 
+#include "drv/eclock.h"
 #include "midi-tools.h"
 
 static int hex_mode = 0;
@@ -39,6 +40,11 @@ void midi_tools_set_octave_middle_c(int oct)
     octave_middle_c = oct;
 }
 
+int midi_tools_get_octave_middle_c(void)
+{
+    return octave_middle_c;
+}
+
 LONG midi_tools_parse_number(char *str)
 {
     return midi_tools_parse_number_n(str, 255);
@@ -240,7 +246,9 @@ void midi_tools_print_note(char *buf, UBYTE note, int use_sharps, int add_octave
 
 struct Library *TimerBase;
 static struct timerequest *ior_time;
-static struct timeval start_time;
+static struct timerequest *ior_tick;
+static ULONG tick_micros;
+static struct EClockVal start_time;
 
 int midi_tools_init_time(void)
 {
@@ -268,7 +276,15 @@ int midi_tools_init_time(void)
 
     TimerBase = (struct Library *)ior_time->tr_node.io_Device;
 
-    GetSysTime(&start_time);
+    if(eclock_init() != 0) {
+        CloseDevice((struct IORequest *)ior_time);
+        DeleteExtIO((struct IORequest *)ior_time);
+        DeletePort(port);
+        ior_time = NULL;
+        TimerBase = NULL;
+        return 4;
+    }
+    eclock_read(&start_time);
 
     return 0;
 }
@@ -281,6 +297,9 @@ void midi_tools_exit_time(void)
         return;
     }
 
+    midi_tools_stop_tick();
+    eclock_exit();
+
     port = ior_time->tr_node.io_Message.mn_ReplyPort;
 
     CloseDevice((struct IORequest *)ior_time);
@@ -296,21 +315,12 @@ void midi_tools_get_time(struct timeval *tv)
         return;
     }
 
-    GetSysTime(tv);
-    SubTime(tv, &start_time);
-}
-
-void midi_tools_print_time(struct timeval *tv)
-{
-    ULONG secs = tv->tv_secs;
-    ULONG mins = secs / 60;
-    secs -= mins * 60;
-    ULONG hours = mins / 60;
-    mins -= hours * 60;
-
-    ULONG us = tv->tv_micro;
-    ULONG ms = us / 1000;
-    Printf("%02ld:%02ld:%02ld.%03ld", hours, mins, secs, ms);
+    /* the E-clock: finer than the system time and never set back. the
+       time since init fits in 32 bits for hours: a few divisions only */
+    struct EClockVal now;
+    eclock_read(&now);
+    eclock_diff(&now, &now, &start_time);
+    eclock_to_timeval(&now, tv);
 }
 
 void midi_tools_wait_time(ULONG secs, ULONG micro)
@@ -321,3 +331,93 @@ void midi_tools_wait_time(ULONG secs, ULONG micro)
 
     DoIO((struct IORequest *)ior_time);
 }
+
+/* wait until the given time (relative to init) is reached */
+void midi_tools_wait_until(struct timeval *tv)
+{
+    struct timeval now;
+    midi_tools_get_time(&now);
+
+    /* deadline already passed? */
+    if(CmpTime(tv, &now) != -1) {
+        return;
+    }
+
+    struct timeval delta = *tv;
+    SubTime(&delta, &now);
+    midi_tools_wait_time(delta.tv_secs, delta.tv_micro);
+}
+
+/* periodic tick: an async timer request on its own port that is re-armed
+   whenever it was replied */
+static void send_tick(void)
+{
+    ior_tick->tr_node.io_Command = TR_ADDREQUEST;
+    ior_tick->tr_time.tv_secs = tick_micros / 1000000;
+    ior_tick->tr_time.tv_micro = tick_micros % 1000000;
+    SendIO((struct IORequest *)ior_tick);
+}
+
+ULONG midi_tools_start_tick(ULONG micros)
+{
+    struct MsgPort *port;
+
+    if((ior_time == NULL) || (ior_tick != NULL)) {
+        return 0;
+    }
+
+    port = CreatePort(NULL, 0);
+    if(port == NULL) {
+        return 0;
+    }
+
+    ior_tick = (struct timerequest *)CreateExtIO(port, sizeof(struct timerequest));
+    if(ior_tick == NULL) {
+        DeletePort(port);
+        return 0;
+    }
+
+    /* share the unit opened in init */
+    ior_tick->tr_node.io_Device = ior_time->tr_node.io_Device;
+    ior_tick->tr_node.io_Unit = ior_time->tr_node.io_Unit;
+
+    tick_micros = micros;
+    send_tick();
+
+    return 1L << port->mp_SigBit;
+}
+
+int midi_tools_check_tick(void)
+{
+    if(ior_tick == NULL) {
+        return 0;
+    }
+
+    struct MsgPort *port = ior_tick->tr_node.io_Message.mn_ReplyPort;
+    if(GetMsg(port) == NULL) {
+        return 0;
+    }
+
+    send_tick();
+    return 1;
+}
+
+void midi_tools_stop_tick(void)
+{
+    struct MsgPort *port;
+
+    if(ior_tick == NULL) {
+        return;
+    }
+
+    port = ior_tick->tr_node.io_Message.mn_ReplyPort;
+
+    if(!CheckIO((struct IORequest *)ior_tick)) {
+        AbortIO((struct IORequest *)ior_tick);
+    }
+    WaitIO((struct IORequest *)ior_tick);
+
+    DeleteExtIO((struct IORequest *)ior_tick);
+    DeletePort(port);
+    ior_tick = NULL;
+}
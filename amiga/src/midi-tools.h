@@ -8,6 +8,7 @@
 extern void midi_tools_set_hex_mode(int on);
 extern int  midi_tools_get_hex_mode(void);
 extern void midi_tools_set_octave_middle_c(int oct);
+extern int  midi_tools_get_octave_middle_c(void);
 
 /* parse tools */
 extern LONG midi_tools_parse_number(char *str);
@@ -21,8 +22,13 @@ extern void midi_tools_print_note(char *buf, UBYTE note, int use_sharps, int add
 
 extern int midi_tools_init_time(void);
 extern void midi_tools_get_time(struct timeval *tv);
-extern void midi_tools_print_time(struct timeval *tv);
 extern void midi_tools_exit_time(void);
 extern void midi_tools_wait_time(ULONG secs, ULONG micro);
+extern void midi_tools_wait_until(struct timeval *tv);
+
+/* periodic tick timer. start returns the signal mask or 0 on error */
+extern ULONG midi_tools_start_tick(ULONG micros);
+extern int midi_tools_check_tick(void);
+extern void midi_tools_stop_tick(void);
 
 #endif
@@ -0,0 +1,124 @@
+#include <proto/exec.h>
+#include <proto/dos.h>
+
+#include <string.h>
+
+#include "drv/eclock.h"
+#include "drv/trace.h"
+
+static const char *TEMPLATE =
+   "NAME/A,"
+   "FILE/K,"
+   "CLEAR/S";
+typedef struct {
+  char *drv_name;
+  char *file_name;
+  LONG clear;
+} params_t;
+static params_t params;
+
+struct DosLibrary *DOSBase;
+
+static const char *event_names[TRACE_NUM_EVENTS] = TRACE_EVENT_NAMES;
+
+static void print_recs(struct trace_rec *recs, ULONG num, ULONG freq)
+{
+    ULONG i;
+
+    PutStr("      time     delta  seq   event         arg1      arg2\n");
+    for(i=0;i<num;i++) {
+        struct trace_rec *rec = &recs[i];
+        ULONG time = eclock_ticks_to_us(rec->stamp - recs[0].stamp, freq);
+        ULONG delta = 0;
+        if(i > 0) {
+            delta = eclock_ticks_to_us(rec->stamp - recs[i-1].stamp, freq);
+        }
+        const char *name = "?";
+        if(rec->id < TRACE_NUM_EVENTS) {
+            name = event_names[rec->id];
+        }
+        Printf("%10lu %9lu  %04lx  %-12s  %08lx  %08lx\n",
+            time, delta, (ULONG)rec->seq, name, rec->arg1, rec->arg2);
+
+        if(SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C) {
+            PutStr("***Break\n");
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct RDArgs *args;
+    struct trace_port *port;
+    struct trace_rec *recs;
+    char port_name[48];
+    ULONG num = 0;
+    ULONG freq = 0;
+    int result = RETURN_OK;
+
+    DOSBase = (struct DosLibrary *)OpenLibrary("dos.library", 0L);
+
+    /* First parse args */
+    args = ReadArgs(TEMPLATE, (LONG *)&params, NULL);
+    if(args == NULL) {
+        PrintFault(IoErr(), "Args Error");
+        CloseLibrary((struct Library *)DOSBase);
+        return RETURN_ERROR;
+    }
+
+    recs = AllocVec(sizeof(struct trace_rec) * TRACE_RING_SIZE, MEMF_ANY);
+    if(recs == NULL) {
+        PutStr("No memory!\n");
+        FreeArgs(args);
+        CloseLibrary((struct Library *)DOSBase);
+        return RETURN_FAIL;
+    }
+
+    strncpy(port_name, params.drv_name, sizeof(port_name) - sizeof(TRACE_PORT_POSTFIX));
+    port_name[sizeof(port_name) - sizeof(TRACE_PORT_POSTFIX)] = '\0';
+    strcat(port_name, TRACE_PORT_POSTFIX);
+
+    /* the driver only removes the ring under Forbid() */
+    Forbid();
+    port = (struct trace_port *)FindPort(port_name);
+    if(port != NULL) {
+        struct trace_ring *ring = port->ring;
+        freq = ring->eclock_freq;
+        num = trace_snapshot(ring, recs, TRACE_RING_SIZE);
+        if(params.clear) {
+            memset(ring->recs, 0, sizeof(struct trace_rec) * ring->size);
+            ring->pos = 0;
+        }
+    }
+    Permit();
+
+    if(port == NULL) {
+        Printf("No trace port '%s'. Driver not running or built without KTRACE?\n", port_name);
+        result = RETURN_WARN;
+    }
+    else if(params.file_name != NULL) {
+        BPTR fh = Open(params.file_name, MODE_NEWFILE);
+        if(fh != 0) {
+            if(trace_save(fh, freq, recs, num) != 0) {
+                PrintFault(IoErr(), "Error writing trace");
+                result = RETURN_ERROR;
+            } else {
+                Printf("Saved %lu records to '%s'\n", num, params.file_name);
+            }
+            Close(fh);
+        } else {
+            PrintFault(IoErr(), "Error opening trace file");
+            result = RETURN_ERROR;
+        }
+    }
+    else if(num > 0) {
+        print_recs(recs, num, freq);
+    }
+
+    FreeVec(recs);
+    FreeArgs(args);
+
+    CloseLibrary((struct Library *)DOSBase);
+    return result;
+}
@@ -2,4 +2,4 @@
 
 __version__ = "1.0.0"
 
-__all__ = ["udpmidi", "portconf", "perf"]
+__all__ = ["udpmidi", "portconf", "perf", "workload", "trace"]
@@ -1,17 +1,30 @@
 import time
+import statistics
+
+
+def get_timestamp():
+    """return a time stamp in 1ms units"""
+    return time.perf_counter() * 1000.0
 
 
 class PerfSample:
-    """A midi cmd to be sent and a time stamp for transfer and receiption."""
-    def __init__(self, midi_cmd, delay=None):
+    """A midi cmd to be sent and a time stamp for transfer and receiption.
+
+       Either give a delay that is waited after sending the sample or an
+       offset in seconds relative to the start of the burst.
+    """
+    def __init__(self, midi_cmd, delay=None, offset=None, msg_class=None):
         self.midi_cmd = midi_cmd
         self.delay = delay
+        self.offset = offset
+        self.msg_class = msg_class
         self.tx_ts = None
         self.rx_ts = None
         self.latency = None
 
     def __repr__(self):
-        return "PerfSample(%r, %r)" % (self.midi_cmd, self.delay)
+        return "PerfSample(%r, %r, %r, %r)" % (self.midi_cmd, self.delay,
+                                               self.offset, self.msg_class)
 
     def send(self, midi_out, ts):
         midi_out.send_message(self.midi_cmd)
@@ -45,8 +58,8 @@ class PerfBurst:
         self._lost_samples = 0
 
     def _get_timestamp(self):
-        # return value in 1ms uni
-        return time.perf_counter() * 1000.0
+        # return value in 1ms unit
+        return get_timestamp()
 
     def add_sample(self, sample):
         self.samples.append(sample)
@@ -54,10 +67,16 @@ class PerfBurst:
     def add_sample_list(self, samples):
         self.samples += list(samples)
 
-    def send_samples(self, midi_out):
+    def prepare_send(self):
         self._expect_rx_pos = 0
         self._lost_samples = 0
+
+    def send_samples(self, midi_out):
+        self.prepare_send()
+        start = time.perf_counter()
         for sample in self.samples:
+            if sample.offset is not None:
+                wait_until(start + sample.offset)
             ts = self._get_timestamp()
             sample.send(midi_out, ts)
 
@@ -99,11 +118,27 @@ class PerfBurst:
                 result.append(latency)
         return result
 
+    def get_latencies_by_class(self):
+        """Return {msg_class: [latency, ...]} of all received samples."""
+        result = {}
+        for sample in self.samples:
+            latency = sample.get_latency()
+            if latency:
+                result.setdefault(sample.msg_class, []).append(latency)
+        return result
+
     def reset(self):
         for sample in self.samples:
             sample.reset()
 
 
+def wait_until(deadline):
+    """sleep until the perf_counter() deadline is reached"""
+    delta = deadline - time.perf_counter()
+    if delta > 0:
+        time.sleep(delta)
+
+
 def delay_step_generator(delay_step=10, delay=0.001):
     while True:
         if delay_step == 0:
@@ -134,3 +169,96 @@ class SampleGenerator:
             cmd = [0x80 | channel, note, velocity]
             result.append(PerfSample(cmd, ds.__next__()))
         return result
+
+
+class ClockPerf:
+    """Send a MIDI clock at a given tempo and record the arrival times.
+
+       Without an output port the clock of another source is recorded
+       passively. A pause of more than a second starts over.
+    """
+    CLOCK = [0xf8]
+
+    def __init__(self, num, bpm=None):
+        self.num = num
+        self.bpm = bpm
+        self.tx_ts = []
+        self.rx_ts = []
+        self.recording = False
+
+    def get_ideal_period(self):
+        """clock period in 1ms units at 24 PPQN or None if unknown"""
+        if self.bpm:
+            return 60000.0 / (self.bpm * 24)
+
+    def start(self):
+        self.tx_ts = []
+        self.rx_ts = []
+        self.recording = True
+
+    def stop(self):
+        self.recording = False
+
+    def send_clocks(self, midi_out):
+        """send with absolute deadlines so late clocks do not add up"""
+        self.start()
+        period = self.get_ideal_period() / 1000.0
+        start = time.perf_counter()
+        for i in range(self.num):
+            wait_until(start + i * period)
+            midi_out.send_message(self.CLOCK)
+            self.tx_ts.append(get_timestamp())
+
+    def incoming_message(self, midi_cmd):
+        if not self.recording or midi_cmd != self.CLOCK:
+            return False
+        ts = get_timestamp()
+        rx_ts = self.rx_ts
+        if len(rx_ts) >= self.num:
+            return False
+        if rx_ts and ts - rx_ts[-1] > 1000.0:
+            del rx_ts[:]
+        rx_ts.append(ts)
+        return True
+
+    def is_done(self):
+        return len(self.rx_ts) >= self.num
+
+    def wait_done(self, time_out=None, time_sleep=0.01):
+        start = time.perf_counter()
+        while not self.is_done():
+            if time_out is not None and \
+               time.perf_counter() - start >= time_out:
+                return False
+            time.sleep(time_sleep)
+        return True
+
+    def get_num_lost(self):
+        return max(len(self.tx_ts) - len(self.rx_ts), 0)
+
+    def analyse(self, stamps):
+        """Return a dict with the jitter of the given time stamps.
+
+           All values are in 1ms units. The drift is the total time minus
+           the ideal time of the clocks and needs a known tempo.
+        """
+        if len(stamps) < 2:
+            return None
+        deltas = [b - a for a, b in zip(stamps, stamps[1:])]
+        mean = statistics.mean(deltas)
+        result = {
+            "num": len(deltas),
+            "period": mean,
+            "tempo": 60000.0 / (mean * 24) if mean > 0 else 0.0,
+            "stdev": statistics.pstdev(deltas, mean),
+            "max_dev": max(abs(d - mean) for d in deltas),
+            "drift": None,
+            "drift_ppm": None
+        }
+        ideal = self.get_ideal_period()
+        if ideal:
+            ideal_total = ideal * len(deltas)
+            drift = (stamps[-1] - stamps[0]) - ideal_total
+            result["drift"] = drift
+            result["drift_ppm"] = drift * 1000000.0 / ideal_total
+        return result
@@ -0,0 +1,122 @@
+"""trace reads the binary trace dumps of the Amiga midi drivers."""
+
+
+import struct
+
+
+class TraceError(Exception):
+    """A trace dump could not be decoded"""
+    pass
+
+
+class TraceRecord:
+    """A single event of the trace ring"""
+
+    def __init__(self, stamp, event_id, seq, arg1, arg2, name):
+        self.stamp = stamp
+        self.event_id = event_id
+        self.seq = seq
+        self.arg1 = arg1
+        self.arg2 = arg2
+        self.name = name
+
+    def __repr__(self):
+        return "TraceRecord(%s, stamp=%d, seq=%04x, %08x, %08x)" % (
+            self.name, self.stamp, self.seq, self.arg1, self.arg2)
+
+
+class TraceFile:
+    """A trace dump written by midi-trace or a driver on the host.
+
+    The dump is stored in the byte order of the writer: the Amiga writes
+    big endian and the drivers on a Linux host little endian.
+    """
+
+    MAGIC = 0x4d545244
+    VERSION = 1
+    HEADER_FORMAT = "IHHII"
+    RECORD_FORMAT = "IHHII"
+
+    def __init__(self, eclock_freq, event_names, records):
+        self.eclock_freq = eclock_freq
+        self.event_names = event_names
+        self.records = records
+
+    @classmethod
+    def decode(cls, data):
+        # endianness from magic
+        for order in (">", "<"):
+            magic, = struct.unpack_from(order + "I", data, 0)
+            if magic == cls.MAGIC:
+                break
+        else:
+            raise TraceError("no trace dump: invalid magic")
+
+        hdr_fmt = order + cls.HEADER_FORMAT
+        _, version, num_events, eclock_freq, num_recs = struct.unpack_from(
+            hdr_fmt, data, 0)
+        if version != cls.VERSION:
+            raise TraceError("unsupported version: %d" % version)
+        if eclock_freq == 0:
+            raise TraceError("invalid E-clock frequency")
+        off = struct.calcsize(hdr_fmt)
+
+        # event names
+        event_names = []
+        for _ in range(num_events):
+            end = data.find(b"\0", off)
+            if end < 0:
+                raise TraceError("truncated event names")
+            event_names.append(data[off:end].decode("ascii"))
+            off = end + 1
+        off = (off + 3) & ~3
+
+        # records
+        rec_fmt = order + cls.RECORD_FORMAT
+        rec_size = struct.calcsize(rec_fmt)
+        if len(data) < off + num_recs * rec_size:
+            raise TraceError("truncated records")
+        records = []
+        for _ in range(num_recs):
+            stamp, event_id, seq, arg1, arg2 = struct.unpack_from(
+                rec_fmt, data, off)
+            if event_id < num_events:
+                name = event_names[event_id]
+            else:
+                name = "?%d" % event_id
+            records.append(TraceRecord(stamp, event_id, seq, arg1, arg2, name))
+            off += rec_size
+
+        return cls(eclock_freq, event_names, records)
+
+    @classmethod
+    def read(cls, file_name):
+        with open(file_name, "rb") as fh:
+            return cls.decode(fh.read())
+
+    def ticks_to_us(self, ticks):
+        return ticks * 1000000.0 / self.eclock_freq
+
+    def get_times(self):
+        """return (time, delta) in us for each record.
+
+        The E-clock stamps are the low 32 bits only and may wrap.
+        """
+        result = []
+        if not self.records:
+            return result
+        first = self.records[0].stamp
+        last = first
+        for rec in self.records:
+            time = self.ticks_to_us((rec.stamp - first) & 0xffffffff)
+            delta = self.ticks_to_us((rec.stamp - last) & 0xffffffff)
+            result.append((time, delta))
+            last = rec.stamp
+        return result
+
+    def get_lost(self):
+        """number of records missing between the first and the last one"""
+        lost = 0
+        for prev, cur in zip(self.records, self.records[1:]):
+            lost += ((cur.seq - prev.seq) & 0xffff) - 1
+        return lost
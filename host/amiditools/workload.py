@@ -0,0 +1,292 @@
+"""workload generates reproducible mixes of midi traffic for stress tests.
+
+A workload is a set of streams. Each stream produces a single class of
+midi messages (chords, clock, cc, ...) at a configurable rate. All streams
+are merged into a time ordered list of PerfSamples with offsets relative
+to the start of the burst.
+
+A stream is specified as a string:
+
+    name[:key=val[,key=val...]]
+
+e.g. "chord:rate=4,size=5" or "clock:bpm=140"
+"""
+
+import math
+import random
+import time
+
+from amiditools.perf import PerfBurst, PerfSample, get_timestamp, wait_until
+
+
+class WorkloadError(Exception):
+    """A workload spec could not be parsed"""
+    pass
+
+
+class Stream:
+    """base class for a stream of midi messages of a single class"""
+
+    name = None
+    defaults = {}
+
+    def __init__(self, rng, **params):
+        self.rng = rng
+        self.params = dict(self.defaults)
+        for key, val in params.items():
+            if key not in self.params:
+                raise WorkloadError("{}: invalid parameter: {}"
+                                    .format(self.name, key))
+            self.params[key] = val
+
+    def __repr__(self):
+        return "{}({})".format(self.__class__.__name__, self.params)
+
+    def _channel(self):
+        ch = int(self.params['ch'])
+        if ch < 1 or ch > 16:
+            raise WorkloadError("{}: invalid channel: {}"
+                                .format(self.name, ch))
+        return ch - 1
+
+    def _times(self, rate, duration):
+        """yield the offsets of events with the given rate in 1/s"""
+        if rate <= 0:
+            return
+        interval = 1.0 / rate
+        n = int(duration * rate)
+        for i in range(n):
+            yield i * interval
+
+    def generate(self, duration):
+        """return a list of (offset, midi_cmd) tuples for duration secs"""
+        raise NotImplementedError()
+
+
+class ChordStream(Stream):
+    """dense chords: size notes are switched on and off together"""
+
+    name = "chord"
+    defaults = {'rate': 4, 'size': 4, 'length': 0.1, 'velocity': 100,
+                'low': 36, 'high': 96, 'ch': 1}
+
+    def generate(self, duration):
+        ch = self._channel()
+        size = int(self.params['size'])
+        length = float(self.params['length'])
+        velocity = int(self.params['velocity'])
+        low = int(self.params['low'])
+        high = int(self.params['high'])
+        if size > high - low + 1:
+            raise WorkloadError("chord: size larger than note range")
+        result = []
+        for t in self._times(float(self.params['rate']), duration):
+            notes = self.rng.sample(range(low, high + 1), size)
+            for note in notes:
+                result.append((t, [0x90 | ch, note, velocity]))
+            for note in notes:
+                result.append((t + length, [0x80 | ch, note, 0]))
+        return result
+
+
+class ClockStream(Stream):
+    """midi clock with 24 PPQN at the given bpm"""
+
+    name = "clock"
+    defaults = {'bpm': 120}
+
+    def generate(self, duration):
+        rate = float(self.params['bpm']) * 24 / 60
+        return [(t, [0xf8]) for t in self._times(rate, duration)]
+
+
+class ControlStream(Stream):
+    """continuous controller sweeping up and down the value range"""
+
+    name = "cc"
+    defaults = {'rate': 50, 'ctrl': 1, 'ch': 1}
+
+    def generate(self, duration):
+        ch = self._channel()
+        ctrl = int(self.params['ctrl'])
+        result = []
+        val = self.rng.randint(0, 127)
+        step = 1
+        for t in self._times(float(self.params['rate']), duration):
+            result.append((t, [0xb0 | ch, ctrl, val]))
+            if val + step < 0 or val + step > 127:
+                step = -step
+            val += step
+        return result
+
+
+class PitchBendStream(Stream):
+    """pitch bend following a sine wave"""
+
+    name = "pb"
+    defaults = {'rate': 50, 'period': 1.0, 'ch': 1}
+
+    def generate(self, duration):
+        ch = self._channel()
+        period = float(self.params['period'])
+        phase = self.rng.random() * 2 * math.pi
+        result = []
+        for t in self._times(float(self.params['rate']), duration):
+            s = math.sin(phase + 2 * math.pi * t / period)
+            val = min(int((s + 1) * 0x2000), 0x3fff)
+            result.append((t, [0xe0 | ch, val & 0x7f, val >> 7]))
+        return result
+
+
+class AftertouchStream(Stream):
+    """channel pressure or poly pressure (poly=1) with random values"""
+
+    name = "at"
+    defaults = {'rate': 20, 'poly': 0, 'note': 60, 'ch': 1}
+
+    def generate(self, duration):
+        ch = self._channel()
+        poly = int(self.params['poly'])
+        note = int(self.params['note'])
+        result = []
+        for t in self._times(float(self.params['rate']), duration):
+            val = self.rng.randint(0, 127)
+            if poly:
+                result.append((t, [0xa0 | ch, note, val]))
+            else:
+                result.append((t, [0xd0 | ch, val]))
+        return result
+
+
+class SysExStream(Stream):
+    """sysex blocks with random payload of the given size"""
+
+    name = "sysex"
+    defaults = {'rate': 1, 'size': 64}
+
+    def generate(self, duration):
+        size = int(self.params['size'])
+        if size < 1:
+            raise WorkloadError("sysex: invalid size: {}".format(size))
+        result = []
+        for t in self._times(float(self.params['rate']), duration):
+            # use non-commercial manufacturer id
+            data = [self.rng.randint(0, 127) for i in range(size)]
+            result.append((t, [0xf0, 0x7d] + data + [0xf7]))
+        return result
+
+
+STREAM_CLASSES = {
+    cls.name: cls for cls in (ChordStream, ClockStream, ControlStream,
+                              PitchBendStream, AftertouchStream, SysExStream)
+}
+
+
+class Workload:
+    """a set of streams generating a deterministic mix of midi messages"""
+
+    def __init__(self, seed=0):
+        self.seed = seed
+        self.specs = []
+
+    def __repr__(self):
+        return "Workload(seed={}, specs={})".format(self.seed, self.specs)
+
+    def add_stream(self, name, **params):
+        if name not in STREAM_CLASSES:
+            raise WorkloadError("invalid stream: {}".format(name))
+        # check params early
+        STREAM_CLASSES[name](random.Random(), **params)
+        self.specs.append((name, params))
+
+    def parse_stream_from_str(self, string):
+        """parse stream from a string: name[:key=val[,key=val...]]"""
+        pos = string.find(':')
+        if pos == -1:
+            name = string
+            args = ""
+        else:
+            name = string[:pos]
+            args = string[pos+1:]
+        params = {}
+        for arg in args.split(','):
+            if len(arg) == 0:
+                continue
+            eq = arg.find('=')
+            if eq == -1:
+                raise WorkloadError("invalid stream param: {}".format(arg))
+            try:
+                params[arg[:eq]] = float(arg[eq+1:])
+            except ValueError:
+                raise WorkloadError("invalid stream value: {}".format(arg))
+        self.add_stream(name, **params)
+
+    def create_samples(self, duration, port_num=0):
+        """create a time ordered list of PerfSamples for the given port.
+
+           Each port derives its own random generator from the seed so
+           multiple ports get different but reproducible traffic.
+        """
+        rng = random.Random(self.seed * 1000 + port_num)
+        events = []
+        num = 0
+        for name, params in self.specs:
+            stream = STREAM_CLASSES[name](rng, **params)
+            for offset, midi_cmd in stream.generate(duration):
+                events.append((offset, num, name, midi_cmd))
+                num += 1
+        # stable sort by offset
+        events.sort(key=lambda e: (e[0], e[1]))
+        return [PerfSample(midi_cmd, offset=offset, msg_class=name)
+                for offset, num, name, midi_cmd in events]
+
+    def create_burst(self, duration, port_num=0):
+        burst = PerfBurst()
+        burst.add_sample_list(self.create_samples(duration, port_num))
+        return burst
+
+
+class WorkloadRunner:
+    """send the bursts of multiple ports interleaved with their timing"""
+
+    def __init__(self):
+        self.ports = []
+
+    def add_port(self, port_num, midi_out, burst):
+        self.ports.append((port_num, midi_out, burst))
+
+    def get_ports(self):
+        return self.ports
+
+    def send_samples(self):
+        schedule = []
+        for port_num, midi_out, burst in self.ports:
+            burst.prepare_send()
+            for sample in burst.samples:
+                schedule.append((sample.offset, port_num, sample, midi_out))
+        schedule.sort(key=lambda e: (e[0], e[1]))
+
+        start = time.perf_counter()
+        for offset, port_num, sample, midi_out in schedule:
+            wait_until(start + offset)
+            sample.send(midi_out, get_timestamp())
+
+    def is_done(self):
+        for port_num, midi_out, burst in self.ports:
+            if not burst.is_done():
+                return False
+        return True
+
+    def wait_done(self, time_out=5, time_sleep=0.1):
+        start = time.perf_counter()
+        delta = 0
+        while delta < time_out:
+            if self.is_done():
+                return True
+            time.sleep(time_sleep)
+            delta = time.perf_counter() - start
+        return False
+
+    def reset(self):
+        for port_num, midi_out, burst in self.ports:
+            burst.reset()